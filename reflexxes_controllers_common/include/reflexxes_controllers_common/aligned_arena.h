@@ -0,0 +1,131 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_ALIGNED_ARENA_H
+#define REFLEXXES_CONTROLLERS_COMMON_ALIGNED_ARENA_H
+
+/**
+  @class reflexxes_controllers_common::AlignedArena
+  @brief Contiguous storage for objects which are used together
+
+  The arena allocates one cache-line-aligned block in reserve() and
+  constructs objects one after the other in it, each starting on its own
+  cache line. Objects whose state is inline (e.g. in a JointVector of fixed
+  size) thus end up next to each other instead of scattered over the heap.
+  The objects are destroyed in reverse order by clear() or the destructor.
+
+  The arena is not thread safe, it is meant to be filled at init.
+*/
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <reflexxes_controllers_common/joint_vector.h>
+
+namespace reflexxes_controllers_common {
+
+class AlignedArena {
+
+public:
+    AlignedArena()
+        : data_(NULL),
+          capacity_(0),
+          used_(0)
+    {}
+
+    ~AlignedArena() {
+        clear();
+        std::free(data_);
+    }
+
+    //! Space taken by a T, rounded up to whole cache lines
+    template <class T>
+    static size_t footprint() {
+        return (sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    }
+
+    //! Destroy all objects and allocate capacity bytes
+    bool reserve(size_t capacity) {
+        clear();
+        std::free(data_);
+        data_ = NULL;
+        capacity_ = 0;
+
+        void *ptr = NULL;
+
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, capacity) != 0) {
+            return false;
+        }
+
+        data_ = static_cast<char *>(ptr);
+        capacity_ = capacity;
+        return true;
+    }
+
+    //! Default-construct a T in the arena, NULL if there is no space left
+    template <class T>
+    T *construct() {
+        if (used_ + footprint<T>() > capacity_) {
+            return NULL;
+        }
+
+        T *object = ::new (data_ + used_) T();
+        used_ += footprint<T>();
+        destructors_.push_back(std::make_pair(static_cast<void *>(object), &destroy<T>));
+        return object;
+    }
+
+    //! Destroy all objects, keeps the storage
+    void clear() {
+        while (!destructors_.empty()) {
+            destructors_.back().second(destructors_.back().first);
+            destructors_.pop_back();
+        }
+
+        used_ = 0;
+    }
+
+    size_t used() const {
+        return used_;
+    }
+
+private:
+    typedef void (*Destructor)(void *);
+
+    template <class T>
+    static void destroy(void *object) {
+        static_cast<T *>(object)->~T();
+    }
+
+    char *data_;
+    size_t capacity_;
+    size_t used_;
+    std::vector<std::pair<void *, Destructor> > destructors_;
+
+    // Non-copyable
+    AlignedArena(const AlignedArena &);
+    AlignedArena &operator=(const AlignedArena &);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,215 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_BLACK_BOX_RECORDER_H
+#define REFLEXXES_CONTROLLERS_COMMON_BLACK_BOX_RECORDER_H
+
+/**
+  @class reflexxes_controllers_common::BlackBoxRecorder
+  @brief Full-rate record of the realtime loop in a memory-mapped ring file
+
+  Every cycle, record() copies the measured joint state, the desired state,
+  the Reflexxes input and the Reflexxes result into the next slot of a ring
+  of fixed-size records. The ring lives in a file which is created, mapped,
+  touched and locked in memory at init, so recording is a plain memory copy
+  without system calls.
+
+  The recording is frozen, keeping the last duration seconds before it, when
+  a cycle reports a Reflexxes error or a tolerance violation (if
+  freeze_on_error is set) or when the freeze_black_box service is called.
+  The ring is then copied into a snapshot file next to the ring file and the
+  recording resumes. The service writes the snapshots it requested, a timer
+  those of automatic freezes. After an automatic freeze, the next one only
+  happens once the ring has been filled again.
+
+  The file starts with a BlackBoxFileHeader and the joint names, followed by
+  the records, see BlackBoxRecord. scripts/black_box_convert converts ring
+  and snapshot files to CSV or to a rosbag.
+
+  @section ROS ROS interface
+
+  @param black_box/enabled Record every cycle (default: false).
+  @param black_box/path Ring file (default: /tmp/NAMESPACE_black_box.bin, with the slashes of the namespace replaced).
+  @param black_box/duration Seconds of recording kept in the ring (default: 10).
+  @param black_box/freeze_on_error Freeze on Reflexxes errors and tolerance violations (default: true).
+  @param black_box/max_snapshots Largest number of snapshots written automatically (default: 10).
+
+  Provides:
+
+  - @b freeze_black_box (std_srvs::Trigger) :
+    Freeze the recording and write a snapshot, the message is its path.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/node_handle.h>
+#include <std_srvs/Trigger.h>
+
+#include <RMLPositionInputParameters.h>
+
+namespace reflexxes_controllers_common {
+
+//! Layout of the start of a black box file, all values are little endian
+struct BlackBoxFileHeader {
+    char magic[8];                     //* "RFXBBOX"
+    boost::uint32_t version;
+    boost::uint32_t n_joints;
+    boost::uint32_t values_per_joint;  //* BLACK_BOX_VALUES_PER_JOINT
+    boost::uint32_t record_size;       //* bytes per record
+    boost::uint64_t records_offset;    //* bytes from the start of the file to the first slot
+    boost::uint64_t capacity;          //* number of slots
+    boost::uint64_t count;             //* records written, the newest is in slot (count - 1) % capacity
+    boost::uint32_t frozen;            //* the recording was frozen when the file was written
+    boost::uint32_t reserved;
+    double nominal_period;             //* seconds between records
+};
+
+//! Joint names follow the header, each in a zero-padded field of this size
+const size_t BLACK_BOX_NAME_SIZE = 64;
+
+/**
+  Values of each joint in a record, in this order: measured position and
+  velocity, desired position, velocity and acceleration, Reflexxes current
+  position, velocity and acceleration, Reflexxes target position and
+  velocity.
+*/
+const size_t BLACK_BOX_VALUES_PER_JOINT = 10;
+
+//! Bits of BlackBoxRecord::events
+enum BlackBoxEvent {
+    BLACK_BOX_NEW_PLAN = 1,        //* RMLPosition() was called in the cycle
+    BLACK_BOX_TRACKING_ERROR = 2,  //* a joint left its position tolerance
+    BLACK_BOX_RML_ERROR = 4        //* Reflexxes returned an error
+};
+
+//! Start of a record, followed by BLACK_BOX_VALUES_PER_JOINT doubles per joint
+struct BlackBoxRecord {
+    boost::int64_t stamp_ns;  //* time of the cycle
+    boost::uint64_t cycle;    //* number of the cycle since the controller was loaded
+    boost::int32_t rml_result;
+    boost::uint32_t events;   //* BlackBoxEvent bits
+};
+
+class BlackBoxRecorder {
+
+public:
+    BlackBoxRecorder();
+    ~BlackBoxRecorder();
+
+    //! Read the parameters in the namespace of nh and create the ring file if enabled
+    bool init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names, double nominal_period);
+
+    bool enabled() const {
+        return records_ != NULL;
+    }
+
+    //! RT: record a cycle, freezes on errors if freeze_on_error is set
+    template <class JointHandles, class JointValues>
+    void record(const ros::Time &time, boost::uint64_t cycle, int rml_result, boost::uint32_t events,
+                const JointHandles &joints, const JointValues &positions, const JointValues &velocities,
+                const JointValues &accelerations, const RMLPositionInputParameters &rml_in) {
+        if (frozen_.load(boost::memory_order_acquire) != FREEZE_NONE) {
+            return;
+        }
+
+        BlackBoxRecord *record = reinterpret_cast<BlackBoxRecord *>(
+                                     records_ + (header_->count % header_->capacity) * header_->record_size);
+        record->stamp_ns = time.toNSec();
+        record->cycle = cycle;
+        record->rml_result = rml_result;
+        record->events = events;
+
+        double *values = reinterpret_cast<double *>(record + 1);
+
+        for (size_t i = 0; i < n_joints_; i++, values += BLACK_BOX_VALUES_PER_JOINT) {
+            values[0] = joints[i].getPosition();
+            values[1] = joints[i].getVelocity();
+            values[2] = positions[i];
+            values[3] = velocities[i];
+            values[4] = accelerations[i];
+            values[5] = rml_in.CurrentPositionVector->VecData[i];
+            values[6] = rml_in.CurrentVelocityVector->VecData[i];
+            values[7] = rml_in.CurrentAccelerationVector->VecData[i];
+            values[8] = rml_in.TargetPositionVector->VecData[i];
+            values[9] = rml_in.TargetVelocityVector->VecData[i];
+        }
+
+        header_->count++;
+        records_since_rearm_++;
+
+        // Freeze after the record which shows the cause
+        bool error = events & (BLACK_BOX_TRACKING_ERROR | BLACK_BOX_RML_ERROR);
+        bool armed = records_since_rearm_ >= header_->capacity &&
+                     snapshots_.load(boost::memory_order_relaxed) < max_snapshots_;
+
+        // Keep the cause, the service writes requested snapshots and the timer automatic ones
+        if (freeze_requested_.exchange(false, boost::memory_order_relaxed)) {
+            header_->frozen = 1;
+            frozen_.store(FREEZE_REQUESTED, boost::memory_order_release);
+        } else if (freeze_on_error_ && error && armed) {
+            header_->frozen = 1;
+            frozen_.store(FREEZE_AUTOMATIC, boost::memory_order_release);
+        }
+    }
+
+private:
+    //! Values of frozen_
+    enum FreezeCause {
+        FREEZE_NONE,
+        FREEZE_REQUESTED,  //* by the service
+        FREEZE_AUTOMATIC   //* by an error
+    };
+
+    std::string path_;
+    int fd_;
+    char *mapping_;
+    size_t mapping_size_;
+    BlackBoxFileHeader *header_;  //* in mapping_
+    char *records_;               //* in mapping_, NULL if not enabled
+    size_t n_joints_;
+
+    bool freeze_on_error_;
+    int max_snapshots_;
+    boost::uint64_t records_since_rearm_;  //* RT, reset by the snapshot side while frozen
+
+    boost::atomic<bool> freeze_requested_;  //* set by the service, consumed by the realtime loop
+    boost::atomic<int> frozen_;             //* FreezeCause, set by the realtime loop, cleared after the snapshot
+    boost::atomic<int> snapshots_;          //* snapshots written after automatic freezes
+
+    //! Snapshot side
+    boost::mutex snapshot_mutex_;
+    ros::Timer timer_;
+    ros::ServiceServer service_;
+
+    void close();
+    void update(const ros::TimerEvent &event);
+    bool freeze(std_srvs::Trigger::Request &request, std_srvs::Trigger::Response &response);
+
+    //! Copy the ring frozen by cause into a new file, resume the recording and return the path, empty on failure
+    std::string writeSnapshot(FreezeCause cause);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,93 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_CONTROLLER_STATE_PUBLISHER_H
+#define REFLEXXES_CONTROLLERS_COMMON_CONTROLLER_STATE_PUBLISHER_H
+
+/**
+  @class reflexxes_controllers_common::ControllerStatePublisher
+  @brief Publishes every control cycle's state in batches of decimation samples
+
+  The realtime loop records one sample per cycle, joint by joint, into a
+  preallocated batch. Once decimation samples are complete the batch is
+  swapped into a realtime_tools::RealtimePublisher if it can be locked, and
+  dropped otherwise. Nothing is allocated after init(), so the full-rate
+  state costs only one message every decimation cycles.
+
+  @section ROS ROS interface
+
+  Publishes:
+
+  - @b state (reflexxes_controllers_msgs::ControllerStateBatch) :
+  Setpoint, measured position and error of every joint, plus effort and PID
+  terms if enabled.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <realtime_tools/realtime_publisher.h>
+
+#include <reflexxes_controllers_msgs/ControllerStateBatch.h>
+
+namespace reflexxes_controllers_common {
+
+class ControllerStatePublisher {
+
+public:
+    ControllerStatePublisher();
+
+    /**
+      Advertise the state topic in the namespace of nh and allocate batches
+      of decimation samples. The effort fields are only allocated and
+      published if effort_terms is set.
+    */
+    void init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names, int decimation, bool effort_terms);
+
+    //! RT: discard the incomplete batch
+    void reset();
+
+    //! RT: start recording the sample of this cycle
+    void beginSample(const ros::Time &time);
+
+    //! RT: record the tracking state of joint j
+    void setJoint(size_t j, double set_point, double process_value, double error);
+
+    //! RT: record the effort command of joint j and its PID and feedforward terms, requires effort_terms
+    void setEffort(size_t j, double command, double p_term, double i_term, double d_term, double ff_term);
+
+    //! RT: finish the sample, publishing the batch if it is complete. Returns true every decimation samples.
+    bool endSample();
+
+private:
+    typedef reflexxes_controllers_msgs::ControllerStateBatch Batch;
+
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<Batch> > publisher_;
+    Batch batch_;
+    size_t n_joints_;
+    size_t decimation_;
+    size_t sample_;
+    size_t offset_;   //* index of the current sample in the per-joint arrays
+};
+
+} // namespace
+
+#endif
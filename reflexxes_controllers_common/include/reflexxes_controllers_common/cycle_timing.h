@@ -0,0 +1,151 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_CYCLE_TIMING_H
+#define REFLEXXES_CONTROLLERS_COMMON_CYCLE_TIMING_H
+
+/**
+  @class reflexxes_controllers_common::CycleTiming
+  @brief Execution time statistics of update() and its phases
+
+  The realtime loop brackets each update() with startCycle() / endCycle()
+  and each phase of interest with start() / stop(). Times are taken from the
+  monotonic clock and accumulated into preallocated min/max/mean and
+  histogram counters; the histogram buckets double in width from 1 us up.
+  Cycles whose period is off the nominal period by more than the tolerance
+  are counted as period deviations.
+
+  The statistics are handed to the service thread through a lock-free
+  mailbox at the end of every cycle, a reset requested by the service is
+  applied at the start of the next cycle.
+
+  @section ROS ROS interface
+
+  Advertises:
+
+  - @b get_timing (reflexxes_controllers_msgs::GetTimingStatistics) :
+  Statistics since the last reset, optionally resetting them.
+*/
+
+#include <time.h>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <ros/node_handle.h>
+
+#include <reflexxes_controllers_msgs/GetTimingStatistics.h>
+
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+namespace reflexxes_controllers_common {
+
+//! Phases of update() which are timed
+enum TimingPhase {
+    PHASE_UPDATE,           //* the whole cycle
+    PHASE_RML_POSITION,     //* RMLPosition()
+    PHASE_RML_SAMPLE,       //* RMLPositionAtAGivenSampleTime() and its interpolation, or precomputed profile lookup
+    PHASE_IK,               //* CartToJnt(), measured on the IK thread
+    PHASE_PID,              //* computeCommand() of all joint PIDs
+    PHASE_RML_VELOCITY,     //* RMLVelocity()
+    PHASE_FEEDFORWARD,      //* inverse dynamics of the desired state
+    PHASE_COUNT
+};
+
+//! Nanoseconds of the monotonic clock
+inline int64_t monotonicNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+//! Counters of one timed phase
+struct PhaseStatistics {
+    static const int N_BUCKETS = 18;  //* [0, 1us), [1us, 2us), ... [65.536ms, inf)
+
+    uint64_t count;
+    int64_t min_ns;
+    int64_t max_ns;
+    int64_t total_ns;
+    uint64_t histogram[N_BUCKETS];
+
+    void reset();
+    void add(int64_t ns);
+};
+
+//! Counters of all phases
+struct TimingStatistics {
+    uint64_t cycles;
+    uint64_t period_deviations;
+    PhaseStatistics phases[PHASE_COUNT];
+
+    void reset();
+};
+
+class CycleTiming {
+
+public:
+    CycleTiming();
+
+    //! Advertise the service in the namespace of nh, period deviations are relative to nominal_period
+    void init(ros::NodeHandle &nh, double nominal_period, double period_tolerance);
+
+    //! RT: start timing a cycle which was started period after the previous one
+    void startCycle(const ros::Duration &period);
+
+    //! RT: finish timing the cycle and hand the statistics to the service
+    void endCycle();
+
+    //! RT: start timing a phase
+    void start(TimingPhase phase) {
+        phase_start_ns_[phase] = monotonicNanoseconds();
+    }
+
+    //! RT: stop timing a phase started with start()
+    void stop(TimingPhase phase) {
+        statistics_.phases[phase].add(monotonicNanoseconds() - phase_start_ns_[phase]);
+    }
+
+    //! RT: record a phase timed elsewhere
+    void record(TimingPhase phase, int64_t ns) {
+        statistics_.phases[phase].add(ns);
+    }
+
+private:
+    double nominal_period_;
+    double period_tolerance_;
+    bool first_cycle_;  //* the period of the first cycle after a reset is meaningless
+
+    TimingStatistics statistics_;
+    int64_t phase_start_ns_[PHASE_COUNT];
+
+    RealtimeMailbox<TimingStatistics> mailbox_;
+    boost::atomic<bool> reset_requested_;
+
+    //! Service side
+    boost::mutex service_mutex_;
+    ros::ServiceServer service_;
+    bool getTiming(reflexxes_controllers_msgs::GetTimingStatistics::Request &request,
+                   reflexxes_controllers_msgs::GetTimingStatistics::Response &response);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,266 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_FIXED_TRAJECTORY_H
+#define REFLEXXES_CONTROLLERS_COMMON_FIXED_TRAJECTORY_H
+
+/**
+  @class reflexxes_controllers_common::FixedTrajectory
+  @brief Joint trajectory with preallocated, fixed capacity
+
+  Positions, velocities and accelerations are stored in three flat arrays
+  laid out point-major, so that the values of all joints of one point are
+  contiguous. Storage is only allocated by resize(); assigning a message that
+  fits, clear() and push_back() never allocate. Missing velocities and
+  accelerations in a message are stored as zeros.
+
+  An id can be attached to the trajectory when it is assigned, so that the
+  realtime loop can tell which command it follows (0 by default).
+
+  Joints can be marked as held, when the command did not include them (see
+  JointNameMap). Their values are placeholders and the follower keeps them
+  at the position they had when the trajectory started.
+*/
+
+#include <vector>
+#include <algorithm>
+
+#include <ros/console.h>
+#include <trajectory_msgs/JointTrajectory.h>
+
+namespace reflexxes_controllers_common {
+
+//! One flag per joint, in the order of the controller joints
+typedef std::vector<bool> JointMask;
+
+class FixedTrajectory {
+
+public:
+    FixedTrajectory()
+        : n_joints_(0),
+          capacity_(0),
+          n_points_(0),
+          id_(0)
+    {}
+
+    //! Allocate storage for max_points points of n_joints joints
+    void resize(size_t n_joints, size_t max_points) {
+        n_joints_ = n_joints;
+        capacity_ = max_points;
+        positions_.resize(n_joints * max_points);
+        velocities_.resize(n_joints * max_points);
+        accelerations_.resize(n_joints * max_points);
+        times_from_start_.resize(max_points);
+        held_.resize(n_joints);
+        clear();
+    }
+
+    void clear() {
+        n_points_ = 0;
+        stamp_ = ros::Time();
+        id_ = 0;
+        std::fill(held_.begin(), held_.end(), false);
+    }
+
+    //! Check whether msg fits into this trajectory, logging the reason if it does not
+    bool fits(const trajectory_msgs::JointTrajectory &msg) const {
+        if (msg.points.size() > capacity_) {
+            ROS_ERROR("Trajectory has %zu points, but at most %zu are supported (see max_trajectory_points).",
+                      msg.points.size(), capacity_);
+            return false;
+        }
+
+        for (size_t k = 0; k < msg.points.size(); k++) {
+            if (!fits(msg.points[k])) {
+                ROS_ERROR("Trajectory point %zu is invalid.", k);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool fits(const trajectory_msgs::JointTrajectoryPoint &point) const {
+        if (point.positions.size() != n_joints_ ||
+                (!point.velocities.empty() && point.velocities.size() != n_joints_) ||
+                (!point.accelerations.empty() && point.accelerations.size() != n_joints_)) {
+            ROS_ERROR("Trajectory point does not have %zu joints.", n_joints_);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool fits(const JointMask &held) const {
+        if (!held.empty() && held.size() != n_joints_) {
+            ROS_ERROR("Held joint mask does not have %zu joints.", n_joints_);
+            return false;
+        }
+
+        return true;
+    }
+
+    //! Copy msg into this trajectory, returns false (and keeps the old content) if it does not fit
+    bool assign(const trajectory_msgs::JointTrajectory &msg, uint32_t id = 0, const JointMask &held = JointMask()) {
+        if (!fits(msg) || !fits(held)) {
+            return false;
+        }
+
+        clear();
+        stamp_ = msg.header.stamp;
+        id_ = id;
+        std::copy(held.begin(), held.end(), held_.begin());
+
+        for (size_t k = 0; k < msg.points.size(); k++) {
+            append(msg.points[k]);
+        }
+
+        return true;
+    }
+
+    //! Copy a single point into this trajectory, which starts immediately
+    bool assign(const trajectory_msgs::JointTrajectoryPoint &point, uint32_t id = 0, const JointMask &held = JointMask()) {
+        if (capacity_ < 1 || !fits(point) || !fits(held)) {
+            return false;
+        }
+
+        clear();
+        id_ = id;
+        std::copy(held.begin(), held.end(), held_.begin());
+        append(point);
+        return true;
+    }
+
+    //! Append a point, returns false if the storage is full
+    bool push_back(const double *positions, const double *velocities, const double *accelerations,
+                   const ros::Duration &time_from_start) {
+        if (n_points_ >= capacity_) {
+            return false;
+        }
+
+        size_t offset = n_points_ * n_joints_;
+        std::copy(positions, positions + n_joints_, positions_.begin() + offset);
+        std::copy(velocities, velocities + n_joints_, velocities_.begin() + offset);
+        std::copy(accelerations, accelerations + n_joints_, accelerations_.begin() + offset);
+        times_from_start_[n_points_] = time_from_start;
+        n_points_++;
+        return true;
+    }
+
+    //! Joint positions of point k
+    const double *positions(size_t k) const {
+        return &positions_[k * n_joints_];
+    }
+
+    //! Joint velocities of point k
+    const double *velocities(size_t k) const {
+        return &velocities_[k * n_joints_];
+    }
+
+    //! Joint accelerations of point k
+    const double *accelerations(size_t k) const {
+        return &accelerations_[k * n_joints_];
+    }
+
+    const ros::Duration &timeFromStart(size_t k) const {
+        return times_from_start_[k];
+    }
+
+    void setTimeFromStart(size_t k, const ros::Duration &time_from_start) {
+        times_from_start_[k] = time_from_start;
+    }
+
+    const ros::Time &stamp() const {
+        return stamp_;
+    }
+
+    void setStamp(const ros::Time &stamp) {
+        stamp_ = stamp;
+    }
+
+    //! Id of the command this trajectory was assigned from
+    uint32_t id() const {
+        return id_;
+    }
+
+    void setId(uint32_t id) {
+        id_ = id;
+    }
+
+    //! Whether joint i was left out of the command and holds its position
+    bool held(size_t i) const {
+        return held_[i];
+    }
+
+    void setHeld(size_t i, bool held) {
+        held_[i] = held;
+    }
+
+    size_t size() const {
+        return n_points_;
+    }
+
+    bool empty() const {
+        return n_points_ == 0;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    size_t joints() const {
+        return n_joints_;
+    }
+
+private:
+    size_t n_joints_;
+    size_t capacity_;
+    size_t n_points_;
+    ros::Time stamp_;
+    uint32_t id_;
+
+    std::vector<double> positions_;
+    std::vector<double> velocities_;
+    std::vector<double> accelerations_;
+    std::vector<ros::Duration> times_from_start_;
+    JointMask held_;
+
+    void append(const trajectory_msgs::JointTrajectoryPoint &point) {
+        size_t offset = n_points_ * n_joints_;
+        std::copy(point.positions.begin(), point.positions.end(), positions_.begin() + offset);
+
+        if (point.velocities.empty()) {
+            std::fill(velocities_.begin() + offset, velocities_.begin() + offset + n_joints_, 0.0);
+        } else {
+            std::copy(point.velocities.begin(), point.velocities.end(), velocities_.begin() + offset);
+        }
+
+        if (point.accelerations.empty()) {
+            std::fill(accelerations_.begin() + offset, accelerations_.begin() + offset + n_joints_, 0.0);
+        } else {
+            std::copy(point.accelerations.begin(), point.accelerations.end(), accelerations_.begin() + offset);
+        }
+
+        times_from_start_[n_points_] = point.time_from_start;
+        n_points_++;
+    }
+};
+
+} // namespace
+
+#endif
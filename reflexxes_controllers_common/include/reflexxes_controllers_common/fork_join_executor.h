@@ -0,0 +1,108 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_FORK_JOIN_EXECUTOR_H
+#define REFLEXXES_CONTROLLERS_COMMON_FORK_JOIN_EXECUTOR_H
+
+/**
+  @class reflexxes_controllers_common::ForkJoinExecutor
+  @brief Runs independent jobs of a realtime cycle on pinned worker threads
+
+  The executor starts one worker per configured core, pinned to that core
+  and running at SCHED_FIFO priority. run() publishes a batch of jobs, the
+  workers and the calling thread take jobs from a shared counter until none
+  is left, and run() returns once every job is done and every worker has
+  left the batch. Handing out jobs only touches atomics, nothing blocks or
+  allocates, so run() is realtime safe.
+
+  Between batches the workers spin, so their cores should be isolated from
+  the rest of the system (e.g. isolcpus). pause() puts them to sleep until
+  resume(), e.g. while the controller is stopped. With no cores, while
+  paused, or if any worker could not be pinned or made realtime at init,
+  run() executes all jobs on the calling thread.
+*/
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace reflexxes_controllers_common {
+
+class ForkJoinExecutor {
+
+public:
+    //! Job of a batch, called once for every index of the batch
+    typedef void (*Job)(void *context, size_t index);
+
+    ForkJoinExecutor();
+    ~ForkJoinExecutor();
+
+    //! Start one worker per entry of cores at the given SCHED_FIFO priority, the workers start paused
+    bool init(const std::vector<int> &cores, int priority);
+
+    //! Stop the workers
+    void stop();
+
+    //! RT: let the workers sleep instead of spinning between batches
+    void pause();
+
+    //! RT: wake the workers up for the next batches, only takes a short lock
+    void resume();
+
+    //! RT: run job for every index below n_jobs, returns when all of them are done
+    void run(Job job, void *context, size_t n_jobs);
+
+    size_t workers() const {
+        return cores_.size();
+    }
+
+private:
+    std::vector<int> cores_;
+    int priority_;
+    std::vector<boost::shared_ptr<boost::thread> > threads_;
+
+    //! Current batch, written by run() before generation_ is incremented
+    Job job_;
+    void *context_;
+    size_t n_jobs_;
+
+    boost::atomic<unsigned> generation_;      //* incremented for every batch
+    boost::atomic<size_t> next_job_;          //* next index to take
+    boost::atomic<size_t> done_jobs_;         //* finished jobs of the batch
+    boost::atomic<size_t> finished_workers_;  //* workers which left the batch
+    boost::atomic<size_t> started_workers_;   //* workers which completed their setup
+    boost::atomic<size_t> failed_workers_;    //* workers which could not be pinned or made realtime
+    boost::atomic<bool> paused_;
+    boost::atomic<bool> shutdown_;
+
+    //! Wakes paused workers
+    boost::mutex mutex_;
+    boost::condition_variable condition_;
+
+    void worker(int core, unsigned generation);
+    void runJobs();
+};
+
+} // namespace
+
+#endif
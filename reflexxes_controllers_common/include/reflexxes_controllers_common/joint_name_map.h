@@ -0,0 +1,95 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_JOINT_NAME_MAP_H
+#define REFLEXXES_CONTROLLERS_COMMON_JOINT_NAME_MAP_H
+
+/**
+  @class reflexxes_controllers_common::JointNameMap
+  @brief Resolves the joint names of commands to the controller joints
+
+  The names of the controller joints are sorted once into a flat table, so
+  that each name of a command is looked up by binary search. A command is
+  permuted into the order of the controller joints on the non-realtime side,
+  and the realtime loop only sees densely packed values without names.
+
+  Commands may include a subset of the joints, the others are marked as
+  held. A command without joint names is taken to be in the order of the
+  controller joints. Commands which are already in that order can be used
+  as they are, see inOrder().
+*/
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+class JointNameMap {
+
+public:
+    JointNameMap()
+        : n_joints_(0)
+    {}
+
+    //! Build the lookup table of the controller joints
+    void init(const std::vector<std::string> &joint_names);
+
+    //! Index of the controller joint called name, -1 if there is none
+    int index(const std::string &name) const;
+
+    /**
+      For every controller joint, find the column of names commanding it, -1
+      if none. Returns false, logging the reason, if a name is unknown or
+      repeated.
+    */
+    bool resolve(const std::vector<std::string> &names, std::vector<int> &permutation) const;
+
+    /**
+      Reorder msg into the controller joints. Joints left out of msg get
+      placeholder values and are flagged in held. Returns false, logging the
+      reason, if the names or the sizes of the points are invalid.
+    */
+    bool permute(const trajectory_msgs::JointTrajectory &msg, trajectory_msgs::JointTrajectory &out,
+                 JointMask &held) const;
+
+    /**
+      Whether msg commands all controller joints in their order, with every
+      point sized accordingly, so that it does not need to be permuted.
+    */
+    bool inOrder(const trajectory_msgs::JointTrajectory &msg) const;
+
+    size_t size() const {
+        return n_joints_;
+    }
+
+private:
+    typedef std::pair<std::string, int> Entry;
+
+    size_t n_joints_;
+    std::vector<std::string> names_;  //* in controller order
+    std::vector<Entry> table_;  //* sorted by name
+};
+
+} // namespace
+
+#endif
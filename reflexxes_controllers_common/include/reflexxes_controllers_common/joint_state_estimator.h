@@ -0,0 +1,158 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_JOINT_STATE_ESTIMATOR_H
+#define REFLEXXES_CONTROLLERS_COMMON_JOINT_STATE_ESTIMATOR_H
+
+/**
+  @class reflexxes_controllers_common::JointStateEstimator
+  @brief Position, velocity and acceleration estimates of all joints
+
+  Estimates the state Reflexxes plans from when it starts from the measured
+  state. The estimate is updated once per cycle from the joint handles by
+  one of the following types:
+
+  - "measured" : The position and velocity of the handles, zero acceleration.
+
+  - "finite_difference" : Velocity and acceleration are backward differences
+    of the measured positions, unfiltered.
+
+  - "alpha_beta_gamma" : A constant-acceleration alpha-beta-gamma filter on
+    the measured positions with the gains alpha, beta and gamma.
+
+  - "savitzky_golay" : A quadratic least-squares fit over the last window
+    positions, evaluated at the latest one. The fit assumes samples spaced
+    by the nominal period.
+
+  All state is kept as arrays over all joints, which are allocated in
+  init(), so that reset() and update() are realtime safe and run as flat
+  loops over the joints.
+
+  If seed_from_setpoint is set, the controllers start replans from the
+  previous setpoint instead while every joint tracks it within its position
+  tolerance, so that the noise of the estimate does not enter the plan.
+
+  @section ROS ROS interface
+
+  @param state_estimation/type "measured", "finite_difference", "alpha_beta_gamma" or "savitzky_golay"
+  (default: depends on the controller).
+  @param state_estimation/alpha Position gain of alpha_beta_gamma (default: 0.5).
+  @param state_estimation/beta Velocity gain of alpha_beta_gamma (default: 0.1).
+  @param state_estimation/gamma Acceleration gain of alpha_beta_gamma (default: 0.01).
+  @param state_estimation/window Number of samples of savitzky_golay, at least 3 (default: 9).
+  @param state_estimation/seed_from_setpoint Replan from the setpoint while tracking is within
+  the position tolerances (default: false).
+*/
+
+#include <string>
+#include <vector>
+
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+namespace reflexxes_controllers_common {
+
+class JointStateEstimator {
+
+public:
+    enum Type {
+        MEASURED,
+        FINITE_DIFFERENCE,
+        ALPHA_BETA_GAMMA,
+        SAVITZKY_GOLAY
+    };
+
+    JointStateEstimator();
+
+    //! Read the parameters and allocate the state of n_joints joints
+    bool init(ros::NodeHandle &nh, size_t n_joints, double nominal_period, Type default_type = MEASURED);
+
+    //! Parse a Type from its parameter name
+    static bool parseType(const std::string &name, Type &type);
+
+    //! RT: restart the estimate at the measured state with zero acceleration
+    template <class JointHandles>
+    void reset(const JointHandles &joints) {
+        read(joints);
+        restart();
+    }
+
+    //! RT: update the estimate with the measurements of this cycle
+    template <class JointHandles>
+    void update(const JointHandles &joints, const ros::Duration &period) {
+        read(joints);
+        estimate(period.toSec());
+    }
+
+    double position(size_t i) const {
+        return positions_[i];
+    }
+
+    double velocity(size_t i) const {
+        return velocities_[i];
+    }
+
+    double acceleration(size_t i) const {
+        return accelerations_[i];
+    }
+
+    //! Whether replans start from the setpoint while tracking is within the tolerances
+    bool seedFromSetpoint() const {
+        return seed_from_setpoint_;
+    }
+
+private:
+    template <class JointHandles>
+    void read(const JointHandles &joints) {
+        for (size_t i = 0; i < n_joints_; i++) {
+            measured_positions_[i] = joints[i].getPosition();
+            measured_velocities_[i] = joints[i].getVelocity();
+        }
+    }
+
+    void restart();
+    void estimate(double dt);
+
+    Type type_;
+    size_t n_joints_;
+    bool seed_from_setpoint_;
+
+    //! Measurements of the current cycle
+    std::vector<double> measured_positions_;
+    std::vector<double> measured_velocities_;
+
+    //! Estimate
+    std::vector<double> positions_;
+    std::vector<double> velocities_;
+    std::vector<double> accelerations_;
+
+    //! alpha_beta_gamma gains
+    double alpha_, beta_, gamma_;
+
+    //! savitzky_golay weights by sample age, scaled by the nominal period, and position history
+    size_t window_;
+    std::vector<double> position_weights_;
+    std::vector<double> velocity_weights_;
+    std::vector<double> acceleration_weights_;
+    std::vector<double> history_;  //* window_ rows of n_joints_ positions, a ring
+    size_t newest_;                //* row of the latest positions
+};
+
+} // namespace
+
+#endif
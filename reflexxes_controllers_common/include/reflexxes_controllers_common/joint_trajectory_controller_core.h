@@ -0,0 +1,687 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_JOINT_TRAJECTORY_CONTROLLER_CORE_H
+#define REFLEXXES_CONTROLLERS_COMMON_JOINT_TRAJECTORY_CONTROLLER_CORE_H
+
+/**
+  @class reflexxes_controllers_common::JointTrajectoryControllerCore
+  @brief Joint trajectory target source of ReflexxesControllerCore
+
+  The points of the commanded trajectory are reached one after the other,
+  each at its time_from_start. If precompute_trajectory is set, each
+  commanded trajectory is planned and sampled as a whole on a non-realtime
+  thread, and the realtime loop only interpolates the samples. Reflexxes is
+  run online again only if tracking leaves the position tolerances, or if
+  the setpoint moved by more than precompute_start_tolerance while the
+  profile was planned.
+
+  Commands are matched to the controller joints by their joint names, which
+  may list a subset of the joints in any order. Joints left out keep the
+  position they had when the trajectory started.
+
+  Commands are checked by a TrajectoryFeasibilityChecker when they arrive,
+  trajectories leaving the joint limits are rejected before the realtime
+  loop sees them. segment_timing decides about segments which are too short
+  for the limits.
+
+  Planners in the same process can command trajectories through the
+  TrajectoryCommandPort of the controller, found by its namespace. Commands
+  are handed to the realtime loop by pointer, trajectories filled in place
+  in the pool of the port are not copied at all. Trajectories filled in
+  place are taken as they are (no lookahead via velocities) and can not be
+  precomputed.
+
+  The PlanPreviewPublisher of the core receives the nominal times of the
+  points after the active one with each online plan. Precomputed
+  trajectories are not previewed.
+
+  @section ROS ROS interface
+
+  @param max_trajectory_points Largest number of points accepted in a command (default: 2048).
+  @param precompute_trajectory Plan whole trajectories off the realtime thread (default: false).
+  @param precompute_max_duration Longest trajectory that can be precomputed in seconds (default: 30).
+  @param precompute_start_tolerance Largest distance of a precomputed profile start from the setpoint the
+  profile is switched to, planned online otherwise (default: 0.01).
+  @param segment_timing Segments too short for the limits are kept ("keep"), rejected ("reject")
+  or stretched ("scale") (default: "keep").
+  @param trajectory_pool_size Number of trajectories in-process planners can fill at once, see
+  TrajectoryCommandPort (default: 2).
+
+  Subscribes to:
+
+  - @b trajectory_command (trajectory_msgs::JointTrajectory) : The trajectory to follow.
+
+  Provides:
+
+  - @b follow_joint_trajectory (control_msgs::FollowJointTrajectory) :
+    The trajectory to follow, see TrajectoryActionServer. A topic command
+    cancels the active goal.
+*/
+
+#include <algorithm>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <reflexxes_controllers_common/reflexxes_controller_core.h>
+#include <reflexxes_controllers_common/joint_name_map.h>
+#include <reflexxes_controllers_common/trajectory_command_buffer.h>
+#include <reflexxes_controllers_common/trajectory_command_port.h>
+#include <reflexxes_controllers_common/trajectory_cursor.h>
+#include <reflexxes_controllers_common/trajectory_action_server.h>
+#include <reflexxes_controllers_common/trajectory_feasibility_checker.h>
+#include <reflexxes_controllers_common/trajectory_precomputer.h>
+#include <reflexxes_controllers_common/via_velocities.h>
+
+namespace reflexxes_controllers_common {
+
+template <class HardwareInterface, class CommandOutput, size_t DOF = DYNAMIC_DOF>
+class JointTrajectoryControllerCore: public ReflexxesControllerCore<HardwareInterface, CommandOutput, DOF> {
+
+    typedef ReflexxesControllerCore<HardwareInterface, CommandOutput, DOF> Core;
+
+public:
+    explicit JointTrajectoryControllerCore(const std::string &controller_name)
+        : Core(controller_name),
+          max_trajectory_points_(2048),
+          trajectory_pool_size_(2),
+          lookahead_points_(0),
+          splice_trajectories_(true),
+          new_reference_(false),
+          splice_from_setpoint_(false),
+          precompute_trajectory_(false),
+          precompute_max_duration_(30.0),
+          precompute_start_tolerance_(0.01),
+          precomputed_reference_(false),
+          precomputed_active_(false),
+          rt_resets_(0),
+          last_command_resets_(0)
+    {}
+
+    virtual ~JointTrajectoryControllerCore() {
+        if (command_port_) {
+            command_port_->shutdown();
+        }
+
+        trajectory_command_sub_.shutdown();
+        precomputer_.stop();
+    }
+
+protected:
+    using Core::nh_;
+    using Core::n_joints_;
+    using Core::joints_;
+    using Core::desired_positions_;
+    using Core::desired_velocities_;
+    using Core::desired_accelerations_;
+    using Core::logger_;
+    using Core::timing_;
+    using Core::rml_in_;
+    using Core::rml_flags_;
+    using Core::traj_start_time_;
+    using Core::sampling_resolution_;
+    using Core::recompute_trajectory_;
+    using Core::decimation_;
+
+    bool initTarget() {
+        // Get trajectory capacity
+        nh_.param("max_trajectory_points", max_trajectory_points_, 2048);
+
+        if (max_trajectory_points_ < 1) {
+            ROS_ERROR("The 'max_trajectory_points' parameter must be positive (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get the number of trajectories in-process planners fill in place
+        nh_.param("trajectory_pool_size", trajectory_pool_size_, 2);
+
+        if (trajectory_pool_size_ < 0) {
+            ROS_ERROR("The 'trajectory_pool_size' parameter must not be negative (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get the number of points looked ahead to pass through points without stopping
+        nh_.param("lookahead_points", lookahead_points_, 0);
+
+        if (lookahead_points_ < 0) {
+            ROS_ERROR("The 'lookahead_points' parameter must not be negative (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get trajectory replacement behavior
+        nh_.param("splice_trajectories", splice_trajectories_, true);
+
+        // Get the handling of segments which are too short for the limits
+        std::string segment_timing;
+        TrajectoryFeasibilityChecker::SegmentTiming timing;
+        nh_.param("segment_timing", segment_timing, std::string("keep"));
+
+        if (!TrajectoryFeasibilityChecker::parseSegmentTiming(segment_timing, timing)) {
+            ROS_ERROR("The 'segment_timing' parameter must be 'keep', 'reject' or 'scale' (namespace '%s')",
+                      nh_.getNamespace().c_str());
+            return false;
+        }
+
+        feasibility_checker_.init(this->joint_names_, this->urdf_joints_, timing);
+
+        // Get trajectory precomputation parameters
+        nh_.param("precompute_trajectory", precompute_trajectory_, false);
+        nh_.param("precompute_max_duration", precompute_max_duration_, 30.0);
+        nh_.param("precompute_start_tolerance", precompute_start_tolerance_, 0.01);
+
+        if (precompute_start_tolerance_ < 0.0) {
+            ROS_ERROR("The 'precompute_start_tolerance' parameter must not be negative (namespace '%s')",
+                      nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Hold fixed at final point once trajectory is complete
+        rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = RMLPositionFlags::RECOMPUTE_TRAJECTORY;
+        rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
+
+        // Start the trajectory precomputation worker
+        if (precompute_trajectory_) {
+            ROS_INFO("Precomputing commanded trajectories (namespace: %s).", nh_.getNamespace().c_str());
+
+            if (!precomputer_.init(*rml_in_, sampling_resolution_, precompute_max_duration_, max_trajectory_points_)) {
+                return false;
+            }
+        }
+
+        // Preallocate the command buffer, with the pool of the command port
+        trajectory_command_buffer_.init(n_joints_, max_trajectory_points_, trajectory_pool_size_);
+        hold_positions_.resize(n_joints_);
+
+        // Look up commanded joints by name
+        joint_name_map_.init(this->joint_names_);
+
+        // Create command subscriber
+        trajectory_command_sub_ = nh_.template subscribe<trajectory_msgs::JointTrajectory>(
+                                      "trajectory_command", 1, &JointTrajectoryControllerCore::trajectoryCommandCB, this);
+
+        // Start the action server, reporting at the rate of the state messages
+        action_server_.init(nh_, this->joint_names_, this->urdf_joints_, this->max_velocities_,
+                            ros::Duration(decimation_ * sampling_resolution_),
+                            boost::bind(&JointTrajectoryControllerCore::commandTrajectory, this, _1, _2, _3),
+                            boost::bind(&JointTrajectoryControllerCore::holdPosition, this));
+
+        // Accept commands of planners in the same process
+        command_port_ = TrajectoryCommandPort::advertise(
+                            nh_.getNamespace(), this->joint_names_, trajectory_command_buffer_,
+                            boost::bind(&JointTrajectoryControllerCore::replaceTrajectory, this, _1),
+                            boost::bind(&JointTrajectoryControllerCore::replaceWithFilledTrajectory, this, _1));
+
+        return true;
+    }
+
+    void startTarget(const ros::Time &time) {
+        // Define an initial command point from the current position
+        FixedTrajectory &initial_command = trajectory_command_buffer_.initRT();
+        initial_command.clear();
+        initial_command.push_back(&desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0],
+                                  ros::Duration(1.0));
+
+        // Discard trajectories precomputed while the controller was stopped
+        if (precompute_trajectory_) {
+            precomputer_.fetch();
+        }
+
+        precomputed_reference_ = false;
+        precomputed_active_ = false;
+
+        // Set new reference flag for initial command point
+        new_reference_ = true;
+        splice_from_setpoint_ = false;
+
+        // The last command is no longer followed, a resend must not count as a repeat
+        rt_resets_.fetch_add(1, boost::memory_order_release);
+    }
+
+    int updateTarget(const ros::Time &time, const ros::Duration &period) {
+        // Fall back to online planning towards the active point if tracking left the precomputed profile
+        if (precomputed_active_ && recompute_trajectory_ && !commandedTrajectory().empty()) {
+            logger_.log(EVENT_LEAVING_PRECOMPUTED, time);
+            precomputed_active_ = false;
+            cursor_.setPointIndex(std::min(cursor_.pointIndex(), commandedTrajectory().size() - 1));
+        }
+
+        // Check for a new commanded trajectory
+        if (precompute_trajectory_ && precomputer_.fetch()) {
+            precomputed_reference_ = true;
+            precomputed_active_ = precomputer_.trajectory().valid();
+            new_reference_ = true;
+
+            // Plan online if the setpoint moved on while the profile was computed
+            if (precomputed_active_ && !startsAtSetpoint(precomputer_.trajectory())) {
+                logger_.log(EVENT_LEAVING_PRECOMPUTED, time);
+                precomputed_active_ = false;
+            }
+        } else if (trajectory_command_buffer_.readFromRT()) {
+            precomputed_reference_ = false;
+            new_reference_ = true;
+        }
+
+        // Get the latest commanded trajectory
+        const FixedTrajectory &commanded_trajectory = commandedTrajectory();
+
+        // Check for a new reference
+        if (new_reference_) {
+            // Start trajectory immediately if stamp is zero, precomputed ones when their start state was reported
+            cursor_.start(commanded_trajectory, precomputed_reference_ ? precomputer_.trajectory().start_time : time);
+
+            if (splice_trajectories_) {
+                // Skip the points whose time has already passed, but the last one
+                cursor_.skipPassed(commanded_trajectory, time);
+
+                // Continue from the setpoint instead of the measured state
+                splice_from_setpoint_ = true;
+            }
+
+            // Joints left out of the command stay where they are
+            for (size_t i = 0; i < this->nJoints(); i++) {
+                hold_positions_[i] = desired_positions_[i];
+            }
+
+            // Reset new reference flag
+            new_reference_ = false;
+            // Set flag to recompute trajectory
+            recompute_trajectory_ = true;
+
+            logger_.log(EVENT_NEW_REFERENCE, time);
+        }
+
+        // Initialize RML result
+        int rml_result = 0;
+
+        bool trajectory_running = cursor_.started(time, period);
+        bool trajectory_incomplete = !cursor_.complete(commanded_trajectory);
+
+        if (precomputed_active_) {
+            // Look up the precomputed trajectory
+            const SampledTrajectory &profile = precomputer_.trajectory();
+            timing_.start(PHASE_RML_SAMPLE);
+            size_t sample_index = profile.sample(
+                                      (time - profile.start_time).toSec(),
+                                      &desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0]);
+            timing_.stop(PHASE_RML_SAMPLE);
+
+            cursor_.setPointIndex(sample_index + 1 < profile.size() ? profile.pointIndex(sample_index) :
+                                  commanded_trajectory.size());
+            recompute_trajectory_ = false;
+            rml_result = ReflexxesAPI::RML_WORKING;
+        } else {
+            if (recompute_trajectory_ && trajectory_running && trajectory_incomplete) {
+                // Compute RML traj after the start time and if there are still points in the queue
+                const double *target_positions = commanded_trajectory.positions(cursor_.pointIndex());
+                const double *target_velocities = commanded_trajectory.velocities(cursor_.pointIndex());
+
+                // Update RML input parameters, a spliced trajectory starts from the last setpoint
+                this->setCurrentState(splice_from_setpoint_);
+
+                for (size_t i = 0; i < this->nJoints(); i++) {
+                    if (commanded_trajectory.held(i)) {
+                        rml_in_->TargetPositionVector->VecData[i] = hold_positions_[i];
+                        rml_in_->TargetVelocityVector->VecData[i] = 0.0;
+                    } else {
+                        rml_in_->TargetPositionVector->VecData[i] = target_positions[i];
+                        rml_in_->TargetVelocityVector->VecData[i] = target_velocities[i];
+                    }
+                }
+
+                splice_from_setpoint_ = false;
+
+                // Reach the point at its time from start (definitely > 0)
+                rml_result = this->computeTrajectory(time, cursor_.timeToPoint(commanded_trajectory, time));
+            } else {
+                // Sample the already computed trajectory
+                rml_result = this->sampleTrajectory((time - traj_start_time_).toSec());
+            }
+
+            this->readRMLOutput();
+        }
+
+        return rml_result;
+    }
+
+    void finalStateReached(const ros::Time &time) {
+        // Pop the active point off the trajectory
+        cursor_.advance(commandedTrajectory());
+
+        recompute_trajectory_ = true;
+    }
+
+    void cycleCompleted(const ros::Time &time, bool valid, bool batch_complete) {
+        const FixedTrajectory &commanded_trajectory = commandedTrajectory();
+        uint32_t id = commanded_trajectory.id();
+
+        // Report the setpoint as start state for the next precomputed trajectory, after any synchronization
+        if (precompute_trajectory_) {
+            precomputer_.setStartState(time, &desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0]);
+        }
+
+        // Report the goal status to the action server
+        action_server_.setActive(id);
+
+        if (!valid) {
+            action_server_.setAborted(id);
+            rt_resets_.fetch_add(1, boost::memory_order_release);
+        } else if (!commanded_trajectory.empty() && cursor_.complete(commanded_trajectory)) {
+            action_server_.setFinished(id);
+        }
+
+        if (!batch_complete || id == 0) {
+            return;
+        }
+
+        control_msgs::FollowJointTrajectoryFeedback &feedback = action_server_.feedback();
+        feedback.header.stamp = time;
+
+        for (size_t i = 0; i < this->nJoints(); i++) {
+            feedback.desired.positions[i] = desired_positions_[i];
+            feedback.desired.velocities[i] = desired_velocities_[i];
+            feedback.desired.accelerations[i] = desired_accelerations_[i];
+            feedback.actual.positions[i] = joints_[i].getPosition();
+            feedback.actual.velocities[i] = joints_[i].getVelocity();
+            feedback.error.positions[i] = feedback.desired.positions[i] - feedback.actual.positions[i];
+            feedback.error.velocities[i] = feedback.desired.velocities[i] - feedback.actual.velocities[i];
+        }
+
+        action_server_.publishFeedback();
+    }
+
+    void stopTarget(const ros::Time &time) {
+        action_server_.setActive(0);
+    }
+
+    size_t upcomingWaypoints(const ros::Time &time, double *times, size_t max_waypoints) {
+        return cursor_.upcomingWaypoints(commandedTrajectory(), time, times, max_waypoints);
+    }
+
+    void limitsChanged(const KinematicLimits &limits) {
+        boost::lock_guard<boost::mutex> lock(command_mutex_);
+        Core::limitsChanged(limits);
+
+        if (precompute_trajectory_) {
+            precomputer_.setLimits(limits);
+        }
+
+        action_server_.setMaxVelocities(this->max_velocities_);
+    }
+
+    //! RT: the trajectory being followed
+    const FixedTrajectory &commandedTrajectory() {
+        return precomputed_reference_ ? precomputer_.trajectory().trajectory : trajectory_command_buffer_.trajectory();
+    }
+
+    //! RT: whether the first sample of profile is the current setpoint
+    bool startsAtSetpoint(const SampledTrajectory &profile) {
+        if (profile.size() == 0) {
+            return false;
+        }
+
+        const double *start_positions = profile.positions(0);
+
+        for (size_t i = 0; i < this->nJoints(); i++) {
+            if (std::fabs(start_positions[i] - desired_positions_[i]) > precompute_start_tolerance_) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**< Last commanded trajectory. */
+    TrajectoryCommandBuffer trajectory_command_buffer_;
+
+    TrajectoryCursor cursor_;  //* progress along the commanded trajectory
+
+    //! Trajectory parameters
+    int max_trajectory_points_;
+    int trajectory_pool_size_;
+    int lookahead_points_;
+    bool splice_trajectories_;
+    bool new_reference_;
+    bool splice_from_setpoint_;  //* plan the next recompute from the setpoint, not the measured state
+    typename Core::JointValues hold_positions_;  //* targets of the joints held by the commanded trajectory
+
+    //! Trajectory precomputation
+    bool precompute_trajectory_;
+    double precompute_max_duration_;
+    double precompute_start_tolerance_;  //* largest distance of a profile start from the setpoint
+    bool precomputed_reference_;  //* the commanded trajectory was delivered by the precomputer
+    bool precomputed_active_;     //* setpoints are looked up in the precomputed profile
+    TrajectoryPrecomputer precomputer_;
+
+    // Command subscriber
+    ros::Subscriber trajectory_command_sub_;
+    boost::mutex command_mutex_;
+    JointNameMap joint_name_map_;
+    trajectory_msgs::JointTrajectoryConstPtr last_command_;  //* guarded by command_mutex_, in controller joint order
+    JointMask last_held_;                                    //* guarded by command_mutex_
+    boost::atomic<unsigned> rt_resets_;                      //* incremented when the realtime loop stops following a command
+    unsigned last_command_resets_;                           //* guarded by command_mutex_, rt_resets_ before last_command_ was sent
+    TrajectoryFeasibilityChecker feasibility_checker_;       //* guarded by command_mutex_
+
+    //! In-process interface
+    TrajectoryCommandPortPtr command_port_;
+
+    //! Action interface
+    TrajectoryActionServer action_server_;
+
+    //! Non-RT: check whether msg only repeats the points of the last command which are still ahead
+    bool repeatsLastCommand(const trajectory_msgs::JointTrajectory &msg, const JointMask &held) const {
+        if (!last_command_ || last_command_resets_ != rt_resets_.load(boost::memory_order_acquire) ||
+                msg.header.stamp.isZero() || last_command_->header.stamp.isZero() || held != last_held_) {
+            return false;
+        }
+
+        const trajectory_msgs::JointTrajectory &last_command = *last_command_;
+
+        ros::Time now = ros::Time::now();
+        size_t first = 0;
+        size_t last_first = 0;
+
+        while (first < msg.points.size() && msg.header.stamp + msg.points[first].time_from_start <= now) {
+            first++;
+        }
+
+        while (last_first < last_command.points.size() &&
+                last_command.header.stamp + last_command.points[last_first].time_from_start <= now) {
+            last_first++;
+        }
+
+        if (msg.points.size() - first != last_command.points.size() - last_first) {
+            return false;
+        }
+
+        for (size_t k = 0; first + k < msg.points.size(); k++) {
+            const trajectory_msgs::JointTrajectoryPoint &point = msg.points[first + k];
+            const trajectory_msgs::JointTrajectoryPoint &last_point = last_command.points[last_first + k];
+
+            if (msg.header.stamp + point.time_from_start != last_command.header.stamp + last_point.time_from_start ||
+                    point.positions != last_point.positions || point.velocities != last_point.velocities ||
+                    point.accelerations != last_point.accelerations) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void trajectoryCommandCB(const trajectory_msgs::JointTrajectoryConstPtr &msg) {
+        ROS_DEBUG("Received new command");
+        replaceTrajectory(msg);
+    }
+
+    //! Non-RT: command a trajectory without a goal, replacing the trajectory of the active goal
+    bool replaceTrajectory(const trajectory_msgs::JointTrajectoryConstPtr &msg) {
+        if (!commandTrajectory(msg, 0)) {
+            return false;
+        }
+
+        action_server_.preempt();
+        return true;
+    }
+
+    //! Non-RT: command a trajectory filled in place in the command buffer, like replaceTrajectory()
+    bool replaceWithFilledTrajectory(FixedTrajectory *trajectory) {
+        if (!commandFilledTrajectory(trajectory)) {
+            return false;
+        }
+
+        action_server_.preempt();
+        return true;
+    }
+
+    //! Non-RT: check and publish a trajectory acquired from the command buffer, which is released if it is rejected
+    bool commandFilledTrajectory(FixedTrajectory *trajectory) {
+        boost::lock_guard<boost::mutex> lock(command_mutex_);
+
+        if (precompute_trajectory_) {
+            ROS_ERROR("Trajectories filled in place can not be precomputed, command a message instead (namespace: %s).",
+                      nh_.getNamespace().c_str());
+            trajectory_command_buffer_.release(trajectory);
+            return false;
+        }
+
+        std::string error;
+
+        if (!feasibility_checker_.check(*trajectory, this->max_velocities_, this->max_accelerations_,
+                                        this->max_jerks_, error)) {
+            ROS_ERROR("Rejected trajectory command: %s (namespace: %s).", error.c_str(), nh_.getNamespace().c_str());
+            trajectory_command_buffer_.release(trajectory);
+            return false;
+        }
+
+        if (feasibility_checker_.stretched()) {
+            feasibility_checker_.stretch(*trajectory);
+        }
+
+        trajectory->setId(0);
+        trajectory_command_buffer_.publish(trajectory);
+
+        // The next command is not compared to a trajectory without message
+        last_command_.reset();
+        last_held_.clear();
+        return true;
+    }
+
+    //! Non-RT: hold the current position, e.g. when a goal is canceled
+    void holdPosition() {
+        trajectory_msgs::JointTrajectoryPtr hold(new trajectory_msgs::JointTrajectory);
+        hold->points.resize(1);
+        hold->points[0].time_from_start = ros::Duration(0.0);
+
+        for (size_t i = 0; i < this->nJoints(); i++) {
+            hold->points[0].positions.push_back(joints_[i].getPosition());
+        }
+
+        if (!commandTrajectory(hold, 0)) {
+            ROS_ERROR("Could not hold the current position (namespace: %s).", nh_.getNamespace().c_str());
+        }
+    }
+
+    //! Non-RT: send a trajectory with the id of its goal (0 if none) to the realtime loop, reports its duration.
+    //! Repeats of the current trajectory are accepted without being sent.
+    bool commandTrajectory(const trajectory_msgs::JointTrajectoryConstPtr &msg, uint32_t id,
+                           ros::Duration *duration = NULL) {
+        boost::lock_guard<boost::mutex> lock(command_mutex_);
+
+        // Commands in controller joint order are used as they are, others are reordered
+        trajectory_msgs::JointTrajectoryConstPtr command = msg;
+        trajectory_msgs::JointTrajectoryPtr rewritten;
+        JointMask held(this->nJoints(), false);
+
+        if (lookahead_points_ > 0 || !joint_name_map_.inOrder(*msg)) {
+            rewritten.reset(new trajectory_msgs::JointTrajectory);
+
+            if (!joint_name_map_.permute(*msg, *rewritten, held)) {
+                ROS_ERROR("Rejected trajectory command (namespace: %s).", nh_.getNamespace().c_str());
+                return false;
+            }
+
+            // Fill in via velocities for points commanded without
+            if (lookahead_points_ > 0) {
+                computeViaVelocities(*rewritten, lookahead_points_, this->max_velocities_, this->max_accelerations_);
+            }
+
+            command = rewritten;
+        }
+
+        // Check the points and segments against the limits in effect
+        std::string error;
+
+        if (!feasibility_checker_.check(*command, held, this->max_velocities_, this->max_accelerations_,
+                                        this->max_jerks_, error)) {
+            ROS_ERROR("Rejected trajectory command: %s (namespace: %s).", error.c_str(), nh_.getNamespace().c_str());
+            return false;
+        }
+
+        if (feasibility_checker_.stretched()) {
+            if (!rewritten) {
+                rewritten.reset(new trajectory_msgs::JointTrajectory(*command));
+                command = rewritten;
+            }
+
+            feasibility_checker_.stretch(*rewritten);
+        }
+
+        // Keep following the current trajectory if nothing changes, goals always get their own id
+        if (id == 0 && splice_trajectories_ && repeatsLastCommand(*command, held)) {
+            ROS_DEBUG("Trajectory command repeats the current trajectory, ignored.");
+        } else {
+            // A restart or an abort while sending invalidates the command for repeat checks
+            unsigned resets = rt_resets_.load(boost::memory_order_acquire);
+
+            // The precomputer delivers the trajectory along with its profile
+            bool accepted = precompute_trajectory_ ?
+                            precomputer_.request(command, id, held) : trajectory_command_buffer_.writeFromNonRT(*command, id, held);
+
+            if (!accepted) {
+                ROS_ERROR("Rejected trajectory command (namespace: %s).", nh_.getNamespace().c_str());
+                return false;
+            }
+
+            // Only topic commands are compared to the next one
+            if (id == 0) {
+                last_command_ = command;
+                last_held_ = held;
+                last_command_resets_ = resets;
+            } else {
+                last_command_.reset();
+                last_held_.clear();
+            }
+        }
+
+        if (duration) {
+            *duration = command->points.empty() ? ros::Duration(0.0) : command->points.back().time_from_start;
+        }
+
+        return true;
+    }
+};
+
+} // namespace
+
+#endif
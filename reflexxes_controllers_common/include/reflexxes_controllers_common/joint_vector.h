@@ -0,0 +1,103 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_JOINT_VECTOR_H
+#define REFLEXXES_CONTROLLERS_COMMON_JOINT_VECTOR_H
+
+/**
+  @class reflexxes_controllers_common::JointVector
+  @brief Per-joint storage sized at compile time
+
+  For a fixed number of joints the values are kept in a cache-line-aligned
+  std::array, so loops over the joints have a constant trip count and can be
+  unrolled and vectorized. DYNAMIC_DOF falls back to a std::vector sized at
+  init. Both provide the part of the std::vector interface the controllers
+  use, resize() of a fixed vector only checks the size.
+*/
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace reflexxes_controllers_common {
+
+//! Number of joints which is only known at runtime
+const size_t DYNAMIC_DOF = 0;
+
+const size_t CACHE_LINE_SIZE = 64;
+
+template <class T, size_t DOF>
+class JointVector {
+
+public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    void resize(size_t n) {
+        assert(n == DOF);
+    }
+
+    static constexpr size_t size() {
+        return DOF;
+    }
+
+    T &operator[](size_t i) {
+        return data_[i];
+    }
+
+    const T &operator[](size_t i) const {
+        return data_[i];
+    }
+
+    T *data() {
+        return data_.data();
+    }
+
+    const T *data() const {
+        return data_.data();
+    }
+
+    iterator begin() {
+        return data_.data();
+    }
+
+    iterator end() {
+        return data_.data() + DOF;
+    }
+
+    const_iterator begin() const {
+        return data_.data();
+    }
+
+    const_iterator end() const {
+        return data_.data() + DOF;
+    }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::array<T, DOF> data_;
+};
+
+template <class T>
+class JointVector<T, DYNAMIC_DOF>: public std::vector<T> {
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,73 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_KINEMATIC_LIMITS_H
+#define REFLEXXES_CONTROLLERS_COMMON_KINEMATIC_LIMITS_H
+
+#include <vector>
+
+#include <RMLPositionInputParameters.h>
+
+namespace reflexxes_controllers_common {
+
+//! Unscaled limits of all joints with the speed scaling
+struct KinematicLimits {
+    std::vector<double> max_velocities;
+    std::vector<double> max_accelerations;
+    std::vector<double> max_jerks;
+    std::vector<double> position_tolerances;
+    double speed_scaling;
+    double command_update_tolerance;
+
+    KinematicLimits()
+        : speed_scaling(1.0),
+          command_update_tolerance(0.0)
+    {}
+
+    void resize(size_t n_joints) {
+        max_velocities.resize(n_joints);
+        max_accelerations.resize(n_joints);
+        max_jerks.resize(n_joints);
+        position_tolerances.resize(n_joints);
+    }
+
+    double scaledVelocity(size_t i) const {
+        return speed_scaling * max_velocities[i];
+    }
+
+    double scaledAcceleration(size_t i) const {
+        return speed_scaling * speed_scaling * max_accelerations[i];
+    }
+
+    double scaledJerk(size_t i) const {
+        return speed_scaling * speed_scaling * speed_scaling * max_jerks[i];
+    }
+
+    //! Write the scaled limits into the Reflexxes input
+    void apply(RMLPositionInputParameters &rml_in) const {
+        for (size_t i = 0; i < max_velocities.size(); i++) {
+            rml_in.MaxVelocityVector->VecData[i] = scaledVelocity(i);
+            rml_in.MaxAccelerationVector->VecData[i] = scaledAcceleration(i);
+            rml_in.MaxJerkVector->VecData[i] = scaledJerk(i);
+        }
+    }
+};
+
+} // namespace
+
+#endif
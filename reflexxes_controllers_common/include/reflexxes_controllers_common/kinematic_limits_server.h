@@ -0,0 +1,104 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_KINEMATIC_LIMITS_SERVER_H
+#define REFLEXXES_CONTROLLERS_COMMON_KINEMATIC_LIMITS_SERVER_H
+
+/**
+  @class reflexxes_controllers_common::KinematicLimitsServer
+  @brief Changes the limits of a running controller
+
+  New limits are requested through a service. They are checked on the
+  service thread, including RMLPositionInputParameters::CheckForValidity()
+  on a private copy of the Reflexxes input, and handed to the realtime loop
+  through a lock-free mailbox. The realtime loop applies them to its
+  Reflexxes input when it fetches them, so trajectories which are already
+  planned are finished unchanged and the next plan uses the new limits.
+
+  The speed scaling s scales velocities by s, accelerations by s^2 and
+  jerks by s^3, which slows down a motion by 1/s without changing its path.
+
+  @section ROS ROS interface
+
+  Advertises:
+
+  - @b set_limits (reflexxes_controllers_msgs::SetLimits) :
+  Change the velocity, acceleration and jerk limits, the position
+  tolerances and the speed scaling.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <ros/node_handle.h>
+
+#include <RMLPositionInputParameters.h>
+
+#include <reflexxes_controllers_msgs/SetLimits.h>
+
+#include <reflexxes_controllers_common/joint_name_map.h>
+#include <reflexxes_controllers_common/kinematic_limits.h>
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+namespace reflexxes_controllers_common {
+
+class KinematicLimitsServer {
+
+public:
+    //! Non-RT: notify the controller of new limits, which are published to the realtime loop afterwards
+    typedef boost::function<void(const KinematicLimits &)> UpdateFunction;
+
+    /**
+      Start the service in the namespace of nh. rml_in is copied to check new
+      limits and must already be valid with limits.
+    */
+    void init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names, const KinematicLimits &limits,
+              const RMLPositionInputParameters &rml_in, const UpdateFunction &update);
+
+    //! RT: fetch new limits, returns false if there are none
+    bool fetch() {
+        return mailbox_.fetch();
+    }
+
+    //! RT: last fetched limits
+    const KinematicLimits &limits() {
+        return mailbox_.readBuffer();
+    }
+
+private:
+    JointNameMap joint_name_map_;
+    UpdateFunction update_;
+
+    boost::mutex mutex_;
+    KinematicLimits current_;                             //* guarded by mutex_
+    boost::scoped_ptr<RMLPositionInputParameters> check_;  //* guarded by mutex_
+    RealtimeMailbox<KinematicLimits> mailbox_;           //* written under mutex_
+
+    ros::ServiceServer service_;
+    bool setLimits(reflexxes_controllers_msgs::SetLimits::Request &request,
+                   reflexxes_controllers_msgs::SetLimits::Response &response);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,144 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_PLAN_PREVIEW_PUBLISHER_H
+#define REFLEXXES_CONTROLLERS_COMMON_PLAN_PREVIEW_PUBLISHER_H
+
+/**
+  @class reflexxes_controllers_common::PlanPreviewPublisher
+  @brief Publishes when the planned motion ends, computed off the realtime thread
+
+  After every successful replan, planned() copies the Reflexxes input of
+  the plan and the nominal times of the waypoints following its target into
+  a lock-free mailbox. The realtime loop never samples the plan for the
+  preview. A timer fetches the latest plan, computes it again with its own
+  Reflexxes instance and publishes a reflexxes_controllers_msgs::PlanPreview
+  with the duration of the motion, samples of the planned positions and the
+  estimated time of each remaining waypoint. Nothing is published between
+  replans, and plans replaced before the timer ran are skipped.
+
+  The target of the plan is reached at the synchronization time. Each later
+  waypoint is assumed to be reached at its nominal time, or at the time of
+  the waypoint before it if that one is late, so the estimate assumes that
+  the limits allow the remaining segments.
+
+  @section ROS ROS interface
+
+  @param preview/enabled Publish a preview after each replan (default: false).
+  @param preview/rate Largest number of previews published per second (default: 20).
+  @param preview/samples Number of samples of the planned positions, including both ends (default: 20).
+  @param preview/max_waypoints Largest number of waypoints after the target of the plan (default: 64).
+
+  Publishes:
+
+  - @b plan_preview (reflexxes_controllers_msgs::PlanPreview) :
+    Duration, sampled positions and waypoint times of the latest plan.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <reflexxes_controllers_msgs/PlanPreview.h>
+
+#include <ReflexxesAPI.h>
+#include <RMLPositionFlags.h>
+#include <RMLPositionInputParameters.h>
+#include <RMLPositionOutputParameters.h>
+
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+namespace reflexxes_controllers_common {
+
+//! Input of a plan as copied by the realtime loop
+struct PlannedMotion {
+    ros::Time start;
+    double minimum_synchronization_time;
+    unsigned char synchronization_behavior;
+    std::vector<double> current_positions;
+    std::vector<double> current_velocities;
+    std::vector<double> current_accelerations;
+    std::vector<double> target_positions;
+    std::vector<double> target_velocities;
+    std::vector<double> max_velocities;
+    std::vector<double> max_accelerations;
+    std::vector<double> max_jerks;
+    std::vector<char> selection;
+
+    std::vector<double> waypoint_times;  //* nominal, relative to start, capacity max_waypoints
+    size_t n_waypoints;
+
+    void resize(size_t n_joints, size_t max_waypoints);
+};
+
+class PlanPreviewPublisher {
+
+public:
+    PlanPreviewPublisher();
+
+    //! Read the parameters in the namespace of nh and start the timer if enabled
+    bool init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names, double sampling_resolution);
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    //! Largest number of waypoint times accepted by planned()
+    size_t maxWaypoints() const {
+        return max_waypoints_;
+    }
+
+    //! RT: storage for the nominal waypoint times of the next planned() call
+    double *waypointTimes() {
+        return &motion_mailbox_.writeBuffer().waypoint_times[0];
+    }
+
+    /**
+      RT: a plan starting at start was computed from rml_in. The first
+      n_waypoints values of waypointTimes() must hold the nominal times of
+      the waypoints after its target, relative to start.
+    */
+    void planned(const ros::Time &start, const RMLPositionInputParameters &rml_in, const RMLPositionFlags &flags,
+                 size_t n_waypoints);
+
+private:
+    bool enabled_;
+    size_t n_joints_;
+    size_t n_samples_;
+    size_t max_waypoints_;
+
+    RealtimeMailbox<PlannedMotion> motion_mailbox_;  //* RT -> timer
+
+    //! Trajectory Generator, only used by the timer
+    boost::scoped_ptr<ReflexxesAPI> rml_;
+    boost::scoped_ptr<RMLPositionInputParameters> rml_in_;
+    boost::scoped_ptr<RMLPositionOutputParameters> rml_out_;
+    RMLPositionFlags rml_flags_;
+
+    reflexxes_controllers_msgs::PlanPreview preview_;
+    ros::Publisher publisher_;
+    ros::Timer timer_;
+
+    void update(const ros::TimerEvent &event);
+};
+
+} // namespace
+
+#endif
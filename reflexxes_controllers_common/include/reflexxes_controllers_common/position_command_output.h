@@ -0,0 +1,76 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_POSITION_COMMAND_OUTPUT_H
+#define REFLEXXES_CONTROLLERS_COMMON_POSITION_COMMAND_OUTPUT_H
+
+/**
+  @class reflexxes_controllers_common::PositionCommandOutput
+  @brief CommandOutput of ReflexxesControllerCore writing position commands
+
+  The desired positions are commanded directly, the measured positions are
+  held if Reflexxes failed.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <urdf/model.h>
+#include <hardware_interface/joint_command_interface.h>
+
+#include <reflexxes_controllers_common/controller_state_publisher.h>
+#include <reflexxes_controllers_common/cycle_timing.h>
+#include <reflexxes_controllers_common/robot_model_cache.h>
+
+namespace reflexxes_controllers_common {
+
+class PositionCommandOutput {
+
+public:
+    bool init(ros::NodeHandle &, const RobotModel &, const std::vector<std::string> &,
+              const std::vector<boost::shared_ptr<const urdf::Joint> > &) {
+        return true;
+    }
+
+    bool effortTerms() const {
+        return false;
+    }
+
+    void starting() { }
+
+    //! RT: command the desired positions
+    template <class JointHandles, class JointValues>
+    void write(JointHandles &joints, const JointValues &positions, const JointValues &,
+               const JointValues &, bool valid, const ros::Duration &,
+               ControllerStatePublisher &state, CycleTiming &) {
+        for (size_t i = 0; i < joints.size(); i++) {
+            double position = joints[i].getPosition();
+
+            // Setting position commands to measured position if Reflexxes failed
+            joints[i].setCommand(valid ? positions[i] : position);
+            state.setJoint(i, positions[i], position, positions[i] - position);
+        }
+    }
+};
+
+} // namespace
+
+#endif
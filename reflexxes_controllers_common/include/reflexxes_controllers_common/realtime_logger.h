@@ -0,0 +1,132 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_REALTIME_LOGGER_H
+#define REFLEXXES_CONTROLLERS_COMMON_REALTIME_LOGGER_H
+
+/**
+  @class reflexxes_controllers_common::RealtimeLogger
+  @brief Diagnostic logging from the realtime loop without touching rosconsole
+
+  The realtime loop only records fixed-size RealtimeEvent values into a
+  RealtimeRing. A worker thread drains the ring every few milliseconds,
+  formats the events and prints them through rosconsole. Repeated events
+  with the same code and joint are throttled: at most one of them is printed
+  per throttle period, and the next printed one reports how many were
+  suppressed. Events which find the ring full are dropped and reported as
+  such.
+
+  Every method but init() and stop() may be called from the realtime loop.
+*/
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <ros/time.h>
+#include <ros/console.h>
+
+#include <RMLPositionInputParameters.h>
+
+#include <reflexxes_controllers_common/realtime_ring.h>
+
+namespace reflexxes_controllers_common {
+
+//! Diagnostic event codes, the meaning of the values is given for each code
+enum RealtimeEventCode {
+    EVENT_NEW_REFERENCE,            //* no values
+    EVENT_RML_RECOMPUTE,            //* minimum synchronization time
+    EVENT_RML_FINAL_STATE_REACHED,  //* no values
+    EVENT_RML_ERROR,                //* Reflexxes result code
+    EVENT_TRACKING_ERROR,           //* tracking error, tolerance
+    EVENT_LEAVING_PRECOMPUTED,      //* no values
+    EVENT_LIMITS_CHANGED,           //* speed scaling
+    EVENT_RML_INPUT,                //* number of DOFs, minimum synchronization time
+    EVENT_RML_INPUT_CURRENT,        //* selection, position, velocity, acceleration
+    EVENT_RML_INPUT_TARGET,         //* position, velocity, alternative velocity
+    EVENT_RML_INPUT_LIMITS,         //* velocity, acceleration, jerk
+    EVENT_CODE_COUNT
+};
+
+//! Plain data record of a single diagnostic event
+struct RealtimeEvent {
+    static const int MAX_VALUES = 4;
+
+    int code;           //* RealtimeEventCode
+    int level;          //* ros::console::levels::Level
+    int joint;          //* joint index, -1 if the event concerns all joints
+    double values[MAX_VALUES];
+    ros::Time stamp;    //* controller time of the event
+};
+
+class RealtimeLogger {
+
+public:
+    RealtimeLogger();
+    ~RealtimeLogger();
+
+    /**
+      Allocate the ring and start the drain thread. Messages are prefixed
+      with name, events repeating within throttle_period seconds are
+      suppressed.
+    */
+    void init(const std::string &name, size_t capacity = 1024, double throttle_period = 1.0);
+
+    //! Stop the drain thread after printing all pending events
+    void stop();
+
+    //! Record an event with the default level of its code
+    void log(RealtimeEventCode code, const ros::Time &stamp, int joint = -1,
+             double v0 = 0.0, double v1 = 0.0, double v2 = 0.0, double v3 = 0.0);
+
+    //! Record an event with an explicit level
+    void log(ros::console::levels::Level level, RealtimeEventCode code, const ros::Time &stamp, int joint = -1,
+             double v0 = 0.0, double v1 = 0.0, double v2 = 0.0, double v3 = 0.0);
+
+    //! Record the complete Reflexxes input parameters, one event per joint and kind of value
+    void logRMLInput(ros::console::levels::Level level, const RMLPositionInputParameters &rml_in,
+                     const ros::Time &stamp);
+
+private:
+    std::string name_;
+    ros::Duration throttle_period_;
+    RealtimeRing<RealtimeEvent> ring_;
+
+    //! Throttling state, only used by the drain thread
+    struct Throttle {
+        Throttle() : printed(false), suppressed(0) {}
+        bool printed;
+        ros::Time last_printed;
+        unsigned int suppressed;
+    };
+    std::map<std::pair<int, int>, Throttle> throttles_;
+
+    boost::thread thread_;
+    boost::atomic<bool> shutdown_;
+
+    void worker();
+    void drain();
+    void print(const RealtimeEvent &event);
+};
+
+} // namespace
+
+#endif
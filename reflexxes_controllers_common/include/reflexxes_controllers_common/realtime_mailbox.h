@@ -0,0 +1,105 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_REALTIME_MAILBOX_H
+#define REFLEXXES_CONTROLLERS_COMMON_REALTIME_MAILBOX_H
+
+/**
+  @class reflexxes_controllers_common::RealtimeMailbox
+  @brief Lock-free single-slot mailbox between one writer and one reader
+
+  The mailbox is a triple buffer: the writer fills its private buffer and
+  publishes it by swapping it with the shared slot, the reader swaps the
+  shared slot with its own private buffer when a fresh value is available.
+  Neither side ever blocks, copies or allocates, so either side may be the
+  realtime thread. Only the most recent value is delivered; values which are
+  overwritten before the reader fetches them are dropped.
+
+  All three buffers are initialized with init(), which is where any dynamic
+  storage (e.g. KDL::JntArray) has to be sized. Since the writer gets back an
+  old buffer after every publish(), it has to overwrite writeBuffer()
+  completely before publishing it again.
+*/
+
+#include <boost/atomic.hpp>
+
+namespace reflexxes_controllers_common {
+
+template <class T>
+class RealtimeMailbox {
+
+public:
+    RealtimeMailbox()
+        : write_index_(0),
+          shared_index_(1),
+          read_index_(2)
+    {}
+
+    //! Initialize all buffers, must not be called concurrently with any other method
+    void init(const T &value) {
+        for (int i = 0; i < 3; i++) {
+            buffers_[i] = value;
+        }
+
+        write_index_ = 0;
+        shared_index_.store(1);
+        read_index_ = 2;
+    }
+
+    //! Writer: buffer to be filled before calling publish()
+    T &writeBuffer() {
+        return buffers_[write_index_];
+    }
+
+    //! Writer: hand the write buffer over to the reader
+    void publish() {
+        write_index_ = shared_index_.exchange(write_index_ | FRESH_FLAG, boost::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    //! Reader: fetch the latest published buffer. Returns false if nothing new was published.
+    bool fetch() {
+        if (!(shared_index_.load(boost::memory_order_relaxed) & FRESH_FLAG)) {
+            return false;
+        }
+
+        read_index_ = shared_index_.exchange(read_index_, boost::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    //! Reader: last fetched buffer
+    T &readBuffer() {
+        return buffers_[read_index_];
+    }
+
+private:
+    static const int INDEX_MASK = 0x3;
+    static const int FRESH_FLAG = 0x4;
+
+    T buffers_[3];
+    int write_index_;
+    boost::atomic<int> shared_index_;
+    int read_index_;
+
+    // Non-copyable
+    RealtimeMailbox(const RealtimeMailbox &);
+    RealtimeMailbox &operator=(const RealtimeMailbox &);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,105 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_REALTIME_RING_H
+#define REFLEXXES_CONTROLLERS_COMMON_REALTIME_RING_H
+
+/**
+  @class reflexxes_controllers_common::RealtimeRing
+  @brief Lock-free fixed-size FIFO between one producer and one consumer
+
+  Unlike RealtimeMailbox, every element is delivered in order. The storage
+  is allocated once by init(); push() fails instead of blocking or
+  allocating when the ring is full and counts the element as dropped, so the
+  producer may be the realtime thread. T should be a plain data type since
+  elements are copied by assignment.
+*/
+
+#include <vector>
+#include <boost/atomic.hpp>
+
+namespace reflexxes_controllers_common {
+
+template <class T>
+class RealtimeRing {
+
+public:
+    RealtimeRing()
+        : head_(0),
+          tail_(0),
+          dropped_(0)
+    {}
+
+    //! Allocate room for capacity elements, must not be called concurrently with any other method
+    void init(size_t capacity) {
+        // One slot stays empty to tell a full ring from an empty one
+        buffer_.resize(capacity + 1);
+        head_.store(0);
+        tail_.store(0);
+        dropped_.store(0);
+    }
+
+    //! Producer: append an element, returns false if the ring is full
+    bool push(const T &value) {
+        size_t tail = tail_.load(boost::memory_order_relaxed);
+        size_t next = tail + 1 == buffer_.size() ? 0 : tail + 1;
+
+        if (next == head_.load(boost::memory_order_acquire)) {
+            dropped_.fetch_add(1, boost::memory_order_relaxed);
+            return false;
+        }
+
+        buffer_[tail] = value;
+        tail_.store(next, boost::memory_order_release);
+        return true;
+    }
+
+    //! Consumer: remove the oldest element, returns false if the ring is empty
+    bool pop(T &value) {
+        size_t head = head_.load(boost::memory_order_relaxed);
+
+        if (head == tail_.load(boost::memory_order_acquire)) {
+            return false;
+        }
+
+        value = buffer_[head];
+        head_.store(head + 1 == buffer_.size() ? 0 : head + 1, boost::memory_order_release);
+        return true;
+    }
+
+    //! Consumer: number of elements dropped since the last call
+    size_t takeDropped() {
+        return dropped_.exchange(0, boost::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return buffer_.empty() ? 0 : buffer_.size() - 1; }
+
+private:
+    std::vector<T> buffer_;
+    boost::atomic<size_t> head_;
+    boost::atomic<size_t> tail_;
+    boost::atomic<size_t> dropped_;
+
+    // Non-copyable
+    RealtimeRing(const RealtimeRing &);
+    RealtimeRing &operator=(const RealtimeRing &);
+};
+
+} // namespace
+
+#endif
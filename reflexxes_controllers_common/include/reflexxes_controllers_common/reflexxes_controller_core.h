@@ -0,0 +1,789 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_REFLEXXES_CONTROLLER_CORE_H
+#define REFLEXXES_CONTROLLERS_COMMON_REFLEXXES_CONTROLLER_CORE_H
+
+/**
+  @class reflexxes_controllers_common::ReflexxesControllerCore
+  @brief Realtime loop shared by the Reflexxes controllers
+
+  The core parses the joint configuration, owns the Reflexxes trajectory
+  generator and runs update(). Each controller only supplies its target
+  source through initTarget(), startTarget() and updateTarget(), which
+  plan or sample the trajectory into the desired state. The core then
+  checks the tracking tolerances, handles the Reflexxes result and hands
+  the desired state to the CommandOutput policy, which writes the commands
+  of the HardwareInterface.
+
+  A CommandOutput provides:
+
+  - bool init(ros::NodeHandle &nh, const RobotModel &model, const std::vector<std::string> &joint_names,
+              const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints)
+  - bool effortTerms() const : publish effort and PID terms in the state
+  - void starting()
+  - template <class JointHandles, class JointValues>
+    void write(JointHandles &joints, const JointValues &positions, const JointValues &velocities,
+               const JointValues &accelerations, bool valid, const ros::Duration &period,
+               ControllerStatePublisher &state, CycleTiming &timing) :
+    RT, command the desired state or, if it is not valid, a safe fallback
+
+  @section ROS ROS interface
+
+  @param joint_names Names of the joints to control.
+  @param sampling_resolution Cycle time of the trajectory generator in seconds (default: 0.001).
+  @param decimation Number of control cycles batched into each state message (default: 10).
+  @param nominal_period Expected period of update() in seconds (default: sampling_resolution).
+  @param period_tolerance Period deviation counted as jitter in seconds (default: 10% of nominal_period).
+  @param rml_rate_divisor Number of servo cycles per sample of the trajectory generator (default: 1).
+  @param log_rml_input Log the Reflexxes input of every replan at debug level (default: false).
+  @param speed_scaling Initial speed scaling of the limits, in (0, 1] (default: 1).
+  @param black_box/enabled Record every cycle in a memory-mapped ring file, see BlackBoxRecorder (default: false).
+  @param preview/enabled Publish the duration and waypoint times of each plan on plan_preview, see
+  PlanPreviewPublisher (default: false).
+  @param state_estimation/type Estimate of the measured state replans start from, see JointStateEstimator
+  (default: "measured", "finite_difference" for the JointPositionController).
+  @param state_estimation/seed_from_setpoint Replan from the setpoint while tracking is within the
+  position tolerances (default: false).
+  @param joints/NAME/position_tolerance Tracking error triggering a replan (default: 0.1).
+  @param joints/NAME/max_velocity Velocity limit (default: the URDF limit).
+  @param joints/NAME/max_acceleration Acceleration limit (default: 1.0).
+  @param joints/NAME/max_jerk Jerk limit (default: 1000.0).
+
+  The URDF is read from the first robot_description parameter found
+  upwards from the controller namespace, and parsed through the
+  RobotModelCache shared by all controllers of the process.
+
+  update() runs planCycle() and commandCycle(). A controller running several
+  cores in one update() can call synchronizeTrajectory() in between, so that
+  the plans started in the same cycle all take the same time. commandCycle()
+  logs and previews the plan of the cycle once, after any synchronization.
+
+  The limits and position tolerances can be changed while the controller is
+  running through the set_limits service of a KinematicLimitsServer. The
+  members max_velocities_, max_accelerations_ and max_jerks_ always hold the
+  scaled limits in effect.
+
+  If rml_rate_divisor is larger than 1, sampleTrajectory() only samples
+  Reflexxes every rml_rate_divisor * nominal_period seconds, and the
+  setpoints in between are interpolated by a SetpointInterpolator. The
+  tolerance checks still run every cycle, and a new plan always starts a
+  new segment.
+
+  If DOF is not DYNAMIC_DOF, the controller only accepts that many joints
+  and keeps the per-joint state of the realtime loop in aligned fixed-size
+  storage, see JointVector. The write() of the CommandOutput then receives
+  the joint handles and the desired state as JointVector<T, DOF>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <urdf/model.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <controller_interface/controller.h>
+
+#include <ReflexxesAPI.h>
+#include <RMLPositionFlags.h>
+#include <RMLPositionInputParameters.h>
+#include <RMLPositionOutputParameters.h>
+
+#include <reflexxes_controllers_common/black_box_recorder.h>
+#include <reflexxes_controllers_common/controller_state_publisher.h>
+#include <reflexxes_controllers_common/cycle_timing.h>
+#include <reflexxes_controllers_common/joint_state_estimator.h>
+#include <reflexxes_controllers_common/joint_vector.h>
+#include <reflexxes_controllers_common/kinematic_limits_server.h>
+#include <reflexxes_controllers_common/plan_preview_publisher.h>
+#include <reflexxes_controllers_common/realtime_logger.h>
+#include <reflexxes_controllers_common/robot_model_cache.h>
+#include <reflexxes_controllers_common/setpoint_interpolator.h>
+
+namespace reflexxes_controllers_common {
+
+template <class HardwareInterface, class CommandOutput, size_t DOF = DYNAMIC_DOF>
+class ReflexxesControllerCore: public controller_interface::Controller<HardwareInterface> {
+
+public:
+    typedef JointVector<double, DOF> JointValues;
+    typedef JointVector<hardware_interface::JointHandle, DOF> JointHandles;
+
+    explicit ReflexxesControllerCore(const std::string &controller_name)
+        : controller_name_(controller_name),
+          loop_count_(0),
+          decimation_(10),
+          n_joints_(0),
+          sampling_resolution_(0.001),
+          rml_rate_divisor_(1),
+          interpolation_period_(0.001),
+          interpolation_segment_(-1),
+          interpolation_result_(0),
+          interpolation_start_result_(0),
+          command_update_tolerance_(0.0),
+          log_rml_input_(false),
+          default_state_estimation_(JointStateEstimator::MEASURED),
+          within_tolerances_(false),
+          recompute_trajectory_(false)
+    {}
+
+    virtual ~ReflexxesControllerCore() {}
+
+    //! Controllers are allocated by pluginlib, keep the joint state aligned
+    static void *operator new(std::size_t size) {
+        void *ptr = NULL;
+
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) {
+            throw std::bad_alloc();
+        }
+
+        return ptr;
+    }
+
+    static void operator delete(void *ptr) {
+        std::free(ptr);
+    }
+
+    bool init(HardwareInterface *robot, ros::NodeHandle &n) {
+        // Store nodehandle
+        nh_ = n;
+
+        // Start realtime diagnostics
+        logger_.init(nh_.getNamespace());
+
+        // Get joint names
+        XmlRpc::XmlRpcValue xml_array;
+
+        if (!nh_.getParam("joint_names", xml_array)) {
+            ROS_ERROR("No 'joint_names' parameter in controller (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Make sure it's an array type
+        if (xml_array.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+            ROS_ERROR("The 'joint_names' parameter is not an array (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get number of joints
+        n_joints_ = xml_array.size();
+
+        ROS_INFO_STREAM("Initializing " << controller_name_ << " with " << n_joints_ << " joints.");
+
+        if (DOF != DYNAMIC_DOF && n_joints_ != DOF) {
+            ROS_ERROR("%s has been built for %zu joints, the 'joint_names' parameter lists %zu (namespace '%s')",
+                      controller_name_.c_str(), DOF, n_joints_, nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get state publishing decimation
+        nh_.param("decimation", decimation_, 10);
+
+        if (decimation_ < 1) {
+            ROS_ERROR("The 'decimation' parameter must be positive (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Get trajectory sampling resolution
+        if (!nh_.hasParam("sampling_resolution")) {
+            ROS_INFO("No sampling_resolution specified (namespace: %s), using default.", nh_.getNamespace().c_str());
+        }
+
+        nh_.param("sampling_resolution", sampling_resolution_, 0.001);
+
+        // Get the initial speed scaling
+        double speed_scaling;
+        nh_.param("speed_scaling", speed_scaling, 1.0);
+
+        if (!(speed_scaling > 0.0 && speed_scaling <= 1.0)) {
+            ROS_ERROR("The 'speed_scaling' parameter must be in (0, 1] (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        // Create trajectory generator
+        rml_.reset(new ReflexxesAPI(n_joints_, sampling_resolution_));
+        rml_in_.reset(new RMLPositionInputParameters(n_joints_));
+        rml_out_.reset(new RMLPositionOutputParameters(n_joints_));
+
+        // Get urdf, parsed once for all controllers using the same description
+        std::string urdf_str;
+
+        if (!nh_.searchParam("robot_description", robot_description_param_)) {
+            robot_description_param_ = "/robot_description";
+        }
+
+        nh_.getParam(robot_description_param_, urdf_str);
+        robot_model_ = RobotModelCache::get(urdf_str);
+
+        if (!robot_model_) {
+            ROS_ERROR("Failed to parse urdf from '%s' parameter (namespace: %s)",
+                      robot_description_param_.c_str(), nh_.getNamespace().c_str());
+            return false;
+        }
+
+        const urdf::Model &urdf = robot_model_->urdf();
+
+        // Get individual joint properties from urdf and parameter server
+        joint_names_.resize(n_joints_);
+        joints_.resize(n_joints_);
+        urdf_joints_.resize(n_joints_);
+        position_tolerances_.resize(n_joints_);
+        max_velocities_.resize(n_joints_);
+        max_accelerations_.resize(n_joints_);
+        max_jerks_.resize(n_joints_);
+        desired_positions_.resize(n_joints_);
+        desired_velocities_.resize(n_joints_);
+        desired_accelerations_.resize(n_joints_);
+        segment_start_positions_.resize(n_joints_);
+        segment_start_velocities_.resize(n_joints_);
+        segment_start_accelerations_.resize(n_joints_);
+
+        for (size_t i = 0; i < n_joints_; i++) {
+            // Get joint name
+            if (xml_array[i].getType() != XmlRpc::XmlRpcValue::TypeString) {
+                ROS_ERROR("The 'joint_names' parameter contains a non-string element (namespace '%s')", nh_.getNamespace().c_str());
+                return false;
+            }
+
+            joint_names_[i] = static_cast<std::string>(xml_array[i]);
+
+            // Get ros_control joint handle
+            joints_[i] = robot->getHandle(joint_names_[i]);
+
+            // Get urdf joint
+            urdf_joints_[i] = urdf.getJoint(joint_names_[i]);
+
+            if (!urdf_joints_[i]) {
+                ROS_ERROR("Could not find joint '%s' in urdf", joint_names_[i].c_str());
+                return false;
+            }
+
+            // Get the joint-namespace nodehandle
+            ros::NodeHandle joint_nh(nh_, "joints/" + joint_names_[i]);
+            ROS_INFO("Loading joint information for joint '%s' (namespace: %s)",
+                     joint_names_[i].c_str(), joint_nh.getNamespace().c_str());
+
+            // Get position tolerance, tracking_position_tolerance is the name used by older configurations
+            if (!joint_nh.hasParam("position_tolerance") && joint_nh.hasParam("tracking_position_tolerance")) {
+                joint_nh.getParam("tracking_position_tolerance", position_tolerances_[i]);
+            } else {
+                if (!joint_nh.hasParam("position_tolerance")) {
+                    ROS_INFO("No position_tolerance specified (namespace: %s), using default.",
+                             joint_nh.getNamespace().c_str());
+                }
+
+                joint_nh.param("position_tolerance", position_tolerances_[i], 0.1);
+            }
+
+            // Get maximum velocity
+            joint_nh.param("max_velocity", max_velocities_[i], urdf_joints_[i]->limits->velocity);
+
+            // Get maximum acceleration
+            if (!joint_nh.hasParam("max_acceleration")) {
+                ROS_INFO("No max_acceleration specified (namespace: %s), using default.",
+                         joint_nh.getNamespace().c_str());
+            }
+
+            joint_nh.param("max_acceleration", max_accelerations_[i], 1.0);
+
+            // Get maximum jerk
+            if (!joint_nh.hasParam("max_jerk")) {
+                ROS_INFO("No max_jerk specified (namespace: %s), using default.",
+                         joint_nh.getNamespace().c_str());
+            }
+
+            joint_nh.param("max_jerk", max_jerks_[i], 1000.0);
+
+            rml_in_->SelectionVector->VecData[i] = true;
+        }
+
+        // Set RML parameters
+        KinematicLimits limits;
+        limits.max_velocities = max_velocities_;
+        limits.max_accelerations = max_accelerations_;
+        limits.max_jerks = max_jerks_;
+        limits.position_tolerances.assign(position_tolerances_.begin(), position_tolerances_.end());
+        limits.speed_scaling = speed_scaling;
+        limits.apply(*rml_in_);
+        ReflexxesControllerCore::limitsChanged(limits);
+
+        if (rml_in_->CheckForValidity()) {
+            ROS_INFO_STREAM("RML INPUT Configuration Valid.");
+            this->rml_debug(ros::console::levels::Debug);
+        } else {
+            ROS_ERROR_STREAM("RML INPUT Configuration Invalid!");
+            this->rml_debug(ros::console::levels::Warn);
+            return false;
+        }
+
+        // Set up the command output
+        if (!output_.init(nh_, *robot_model_, joint_names_, urdf_joints_)) {
+            return false;
+        }
+
+        // Start timing instrumentation
+        double nominal_period, period_tolerance;
+        nh_.param("nominal_period", nominal_period, sampling_resolution_);
+        nh_.param("period_tolerance", period_tolerance, 0.1 * nominal_period);
+        timing_.init(nh_, nominal_period, period_tolerance);
+
+        // Get the number of servo cycles per trajectory generator sample
+        nh_.param("rml_rate_divisor", rml_rate_divisor_, 1);
+
+        if (rml_rate_divisor_ < 1) {
+            ROS_ERROR("The 'rml_rate_divisor' parameter must be positive (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        interpolation_period_ = rml_rate_divisor_ * nominal_period;
+
+        // Dumping the input of every replan takes 1 + 3 * DOF log events
+        nh_.param("log_rml_input", log_rml_input_, false);
+
+        // Start the optional full-rate recording
+        if (!black_box_.init(nh_, joint_names_, nominal_period)) {
+            return false;
+        }
+
+        // Start the optional preview of each plan
+        if (!preview_.init(nh_, joint_names_, sampling_resolution_)) {
+            return false;
+        }
+
+        // Estimate the state replans start from, updated at the servo rate
+        if (!state_estimator_.init(nh_, n_joints_, nominal_period, default_state_estimation_)) {
+            return false;
+        }
+
+        interpolator_.resize(n_joints_);
+
+        // Create state publisher
+        controller_state_publisher_.init(nh_, joint_names_, decimation_, output_.effortTerms());
+
+        // Set up the target source, which starts accepting commands
+        if (!initTarget()) {
+            return false;
+        }
+
+        // Accept new limits
+        limits.command_update_tolerance = command_update_tolerance_;
+        limits_server_.init(nh_, joint_names_, limits, *rml_in_,
+                            boost::bind(&ReflexxesControllerCore::limitsChanged, this, _1));
+
+        return true;
+    }
+
+    void starting(const ros::Time &time) {
+        // Start from the current state
+        for (size_t i = 0; i < nJoints(); i++) {
+            desired_positions_[i] = joints_[i].getPosition();
+            desired_velocities_[i] = joints_[i].getVelocity();
+            desired_accelerations_[i] = 0.0;
+        }
+
+        // Restart the estimate, the first plan starts from the measured state
+        state_estimator_.reset(joints_);
+        within_tolerances_ = false;
+
+        // Set flag to compute the trajectory towards the initial target
+        recompute_trajectory_ = true;
+
+        output_.starting();
+        startTarget(time);
+
+        // Start a new state batch
+        controller_state_publisher_.reset();
+    }
+
+    void stopping(const ros::Time &time) {
+        stopTarget(time);
+    }
+
+    void update(const ros::Time &time, const ros::Duration &period) {
+        int rml_result = planCycle(time, period);
+        commandCycle(time, period, rml_result);
+    }
+
+    //! RT: first half of update(), plans or samples the desired state and returns the Reflexxes result
+    int planCycle(const ros::Time &time, const ros::Duration &period) {
+        timing_.startCycle(period);
+        state_estimator_.update(joints_, period);
+
+        // Switch to new limits, the next plan uses them
+        if (limits_server_.fetch()) {
+            const KinematicLimits &limits = limits_server_.limits();
+            limits.apply(*rml_in_);
+
+            for (size_t i = 0; i < nJoints(); i++) {
+                position_tolerances_[i] = limits.position_tolerances[i];
+            }
+
+            command_update_tolerance_ = limits.command_update_tolerance;
+            logger_.log(EVENT_LIMITS_CHANGED, time, -1, limits.speed_scaling);
+        }
+
+        // Plan or sample the trajectory towards the target
+        return updateTarget(time, period);
+    }
+
+    //! RT: synchronization time of the plan computed in the cycle at time, 0 if the cycle only sampled
+    double plannedSynchronizationTime(const ros::Time &time, int rml_result) const {
+        if (traj_start_time_ != time || rml_result < 0) {
+            return 0.0;
+        }
+
+        return rml_out_->GetSynchronizationTime();
+    }
+
+    //! RT: stretch the plan computed in the cycle at time to synchronization_time, updates rml_result
+    void synchronizeTrajectory(const ros::Time &time, double synchronization_time, int &rml_result) {
+        if (traj_start_time_ != time || rml_result < 0 ||
+                rml_out_->GetSynchronizationTime() >= synchronization_time) {
+            return;
+        }
+
+        // The input of the plan is still in rml_in_
+        rml_result = computeTrajectory(time, synchronization_time);
+        readRMLOutput();
+    }
+
+    //! RT: second half of update(), checks the tolerances and commands the desired state
+    void commandCycle(const ros::Time &time, const ros::Duration &period, int rml_result) {
+        // Report the plan of the cycle once, after any synchronization
+        bool new_plan = traj_start_time_ == time;
+
+        if (new_plan) {
+            logger_.log(EVENT_RML_RECOMPUTE, time, -1, rml_in_->GetMinimumSynchronizationTime());
+
+            if (log_rml_input_) {
+                logger_.logRMLInput(ros::console::levels::Debug, *rml_in_, time);
+            }
+
+            // Hand the input of the plan to the preview
+            if (preview_.enabled() && rml_result >= 0) {
+                size_t n_waypoints = upcomingWaypoints(time, preview_.waypointTimes(), preview_.maxWaypoints());
+                preview_.planned(time, *rml_in_, rml_flags_, n_waypoints);
+            }
+        }
+
+        // Determine if any of the joint tolerances have been violated
+        boost::uint32_t black_box_events = new_plan ? BLACK_BOX_NEW_PLAN : 0;
+        within_tolerances_ = true;
+
+        for (size_t i = 0; i < nJoints(); i++) {
+            double tracking_error = std::abs(desired_positions_[i] - joints_[i].getPosition());
+
+            if (tracking_error > position_tolerances_[i]) {
+                recompute_trajectory_ = true;
+                within_tolerances_ = false;
+                black_box_events |= BLACK_BOX_TRACKING_ERROR;
+                logger_.log(EVENT_TRACKING_ERROR, time, i, tracking_error, position_tolerances_[i]);
+            }
+        }
+
+        // Only command the desired state if Reflexxes succeeded
+        bool valid = true;
+
+        switch (rml_result) {
+        case ReflexxesAPI::RML_WORKING:
+            // S'all good.
+            break;
+
+        case ReflexxesAPI::RML_FINAL_STATE_REACHED:
+            logger_.log(EVENT_RML_FINAL_STATE_REACHED, time);
+            finalStateReached(time);
+            break;
+
+        default:
+            logger_.log(EVENT_RML_ERROR, time, -1, rml_result);
+            black_box_events |= BLACK_BOX_RML_ERROR;
+            valid = false;
+            break;
+        };
+
+        if (black_box_.enabled()) {
+            black_box_.record(time, loop_count_, rml_result, black_box_events, joints_,
+                              desired_positions_, desired_velocities_, desired_accelerations_, *rml_in_);
+        }
+
+        // Set the lower-level commands and publish state
+        controller_state_publisher_.beginSample(time);
+        output_.write(joints_, desired_positions_, desired_velocities_, desired_accelerations_,
+                      valid, period, controller_state_publisher_, timing_);
+        bool batch_complete = controller_state_publisher_.endSample();
+
+        cycleCompleted(time, valid, batch_complete);
+
+        timing_.endCycle();
+
+        // Increment the loop count
+        loop_count_++;
+    }
+
+protected:
+    //! Read the parameters of the target source and start accepting commands
+    virtual bool initTarget() = 0;
+
+    //! RT: reset the target to the current state, which is in the desired state
+    virtual void startTarget(const ros::Time &time) = 0;
+
+    //! RT: update the desired state, returns the Reflexxes result
+    virtual int updateTarget(const ros::Time &time, const ros::Duration &period) = 0;
+
+    //! RT: the desired state has reached the target
+    virtual void finalStateReached(const ros::Time &time) { }
+
+    //! RT: the controller is stopped
+    virtual void stopTarget(const ros::Time &time) { }
+
+    //! RT: the commands of the cycle were written, valid is false if Reflexxes failed
+    virtual void cycleCompleted(const ros::Time &time, bool valid, bool batch_complete) { }
+
+    /**
+      RT: write the nominal times of up to max_waypoints waypoints following
+      the target of the plan started at time into times, relative to time.
+      Returns their number.
+    */
+    virtual size_t upcomingWaypoints(const ros::Time &time, double *times, size_t max_waypoints) {
+        return 0;
+    }
+
+    //! Non-RT: new limits were accepted, sets the scaled limits members
+    virtual void limitsChanged(const KinematicLimits &limits) {
+        for (size_t i = 0; i < max_velocities_.size(); i++) {
+            max_velocities_[i] = limits.scaledVelocity(i);
+            max_accelerations_[i] = limits.scaledAcceleration(i);
+            max_jerks_[i] = limits.scaledJerk(i);
+        }
+    }
+
+    //! RT: plan from the current and target state in rml_in_, starting at time
+    int computeTrajectory(const ros::Time &time, double minimum_synchronization_time) {
+        // Store the traj start time
+        traj_start_time_ = time;
+
+        // Set desired execution time for this trajectory (definitely > 0)
+        rml_in_->SetMinimumSynchronizationTime(minimum_synchronization_time);
+
+        // Compute trajectory
+        timing_.start(PHASE_RML_POSITION);
+        int rml_result = rml_->RMLPosition(*rml_in_, rml_out_.get(), rml_flags_);
+        timing_.stop(PHASE_RML_POSITION);
+
+        // Disable recompute flag
+        recompute_trajectory_ = false;
+
+        // Interpolate the new plan from its start
+        interpolation_segment_ = -1;
+
+        return rml_result;
+    }
+
+    //! RT: sample the planned trajectory at the given time from its start
+    int sampleTrajectory(double time_from_start) {
+        timing_.start(PHASE_RML_SAMPLE);
+        int rml_result = rml_rate_divisor_ > 1 ? interpolateTrajectory(time_from_start) :
+                         rml_->RMLPositionAtAGivenSampleTime(time_from_start, rml_out_.get());
+        timing_.stop(PHASE_RML_SAMPLE);
+
+        return rml_result;
+    }
+
+    //! RT: sample the planned trajectory on the interpolation grid and interpolate in between
+    int interpolateTrajectory(double time_from_start) {
+        long segment = static_cast<long>(std::floor(std::max(0.0, time_from_start) / interpolation_period_));
+        double segment_start = segment * interpolation_period_;
+
+        if (segment != interpolation_segment_) {
+            int start_result;
+
+            if (interpolation_segment_ >= 0 && segment == interpolation_segment_ + 1) {
+                // Continue from the end of the previous segment
+                std::copy(interpolator_.endPositions(), interpolator_.endPositions() + nJoints(),
+                          &segment_start_positions_[0]);
+                std::copy(interpolator_.endVelocities(), interpolator_.endVelocities() + nJoints(),
+                          &segment_start_velocities_[0]);
+                std::copy(interpolator_.endAccelerations(), interpolator_.endAccelerations() + nJoints(),
+                          &segment_start_accelerations_[0]);
+                start_result = interpolation_result_;
+            } else {
+                start_result = rml_->RMLPositionAtAGivenSampleTime(segment_start, rml_out_.get());
+
+                if (start_result < 0) {
+                    interpolation_segment_ = -1;
+                    return start_result;
+                }
+
+                for (size_t i = 0; i < nJoints(); i++) {
+                    segment_start_positions_[i] = rml_out_->NewPositionVector->VecData[i];
+                    segment_start_velocities_[i] = rml_out_->NewVelocityVector->VecData[i];
+                    segment_start_accelerations_[i] = rml_out_->NewAccelerationVector->VecData[i];
+                }
+            }
+
+            int end_result = rml_->RMLPositionAtAGivenSampleTime(segment_start + interpolation_period_, rml_out_.get());
+
+            if (end_result < 0) {
+                interpolation_segment_ = -1;
+                return end_result;
+            }
+
+            interpolator_.set(interpolation_period_,
+                              &segment_start_positions_[0], &segment_start_velocities_[0],
+                              &segment_start_accelerations_[0],
+                              rml_out_->NewPositionVector->VecData, rml_out_->NewVelocityVector->VecData,
+                              rml_out_->NewAccelerationVector->VecData);
+
+            interpolation_segment_ = segment;
+            interpolation_result_ = end_result;
+            interpolation_start_result_ = start_result;
+        }
+
+        // The final state is reached within this segment, look up exactly when
+        if (interpolation_result_ == ReflexxesAPI::RML_FINAL_STATE_REACHED &&
+                interpolation_start_result_ != ReflexxesAPI::RML_FINAL_STATE_REACHED) {
+            return rml_->RMLPositionAtAGivenSampleTime(time_from_start, rml_out_.get());
+        }
+
+        interpolator_.sample(time_from_start - segment_start,
+                             rml_out_->NewPositionVector->VecData, rml_out_->NewVelocityVector->VecData,
+                             rml_out_->NewAccelerationVector->VecData);
+
+        return interpolation_result_;
+    }
+
+    /**
+      RT: set the current state of the next plan to the estimated state, or
+      to the last setpoint if from_setpoint is set or seed_from_setpoint
+      allows it because every joint tracked within its tolerance.
+    */
+    void setCurrentState(bool from_setpoint = false) {
+        if (from_setpoint || (state_estimator_.seedFromSetpoint() && within_tolerances_)) {
+            for (size_t i = 0; i < nJoints(); i++) {
+                rml_in_->CurrentPositionVector->VecData[i] = desired_positions_[i];
+                rml_in_->CurrentVelocityVector->VecData[i] = desired_velocities_[i];
+                rml_in_->CurrentAccelerationVector->VecData[i] = desired_accelerations_[i];
+            }
+        } else {
+            for (size_t i = 0; i < nJoints(); i++) {
+                rml_in_->CurrentPositionVector->VecData[i] = state_estimator_.position(i);
+                rml_in_->CurrentVelocityVector->VecData[i] = state_estimator_.velocity(i);
+                rml_in_->CurrentAccelerationVector->VecData[i] = state_estimator_.acceleration(i);
+            }
+        }
+    }
+
+    //! RT: copy the latest Reflexxes output into the desired state
+    void readRMLOutput() {
+        for (size_t i = 0; i < nJoints(); i++) {
+            desired_positions_[i] = rml_out_->NewPositionVector->VecData[i];
+            desired_velocities_[i] = rml_out_->NewVelocityVector->VecData[i];
+            desired_accelerations_[i] = rml_out_->NewAccelerationVector->VecData[i];
+        }
+    }
+
+    //! Number of joints, a compile-time constant unless DOF is DYNAMIC_DOF
+    size_t nJoints() const {
+        return DOF == DYNAMIC_DOF ? n_joints_ : DOF;
+    }
+
+    void rml_debug(const ros::console::levels::Level level) {
+        logger_.logRMLInput(level, *rml_in_, ros::Time::now());
+    }
+
+    std::string controller_name_;
+    ros::NodeHandle nh_;
+    std::string robot_description_param_;  //* resolved name of the robot_description parameter
+    RobotModelConstPtr robot_model_;       //* parsed robot_description, shared with other controllers
+    int loop_count_;
+    int decimation_;
+
+    size_t n_joints_;
+    std::vector<std::string> joint_names_;
+    std::vector<double> max_velocities_;
+    std::vector<double> max_accelerations_;
+    std::vector<double> max_jerks_;
+    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
+
+    //! Per-joint state used by the realtime loop
+    JointHandles joints_;
+    JointValues position_tolerances_;
+
+    //! Multi-rate sampling of the trajectory generator
+    int rml_rate_divisor_;
+    double interpolation_period_;
+    long interpolation_segment_;      //* index of the interpolated segment, -1 before the first
+    int interpolation_result_;        //* Reflexxes result at the end of the segment
+    int interpolation_start_result_;  //* Reflexxes result at the start of the segment
+    SetpointInterpolator interpolator_;
+    JointValues segment_start_positions_;
+    JointValues segment_start_velocities_;
+    JointValues segment_start_accelerations_;
+
+    //! Limits changed while running
+    KinematicLimitsServer limits_server_;
+    double command_update_tolerance_;  //* used by targets which filter repeated commands
+
+    //! Desired state, filled by the target source
+    JointValues desired_positions_;
+    JointValues desired_velocities_;
+    JointValues desired_accelerations_;
+
+    //! Diagnostics from the realtime loop
+    RealtimeLogger logger_;
+    bool log_rml_input_;  //* dump the input of every replan
+
+    //! Execution time statistics of update()
+    CycleTiming timing_;
+
+    //! Full-rate record of the loop for post-mortems
+    BlackBoxRecorder black_box_;
+
+    //! Duration and waypoint times of each plan for downstream schedulers
+    PlanPreviewPublisher preview_;
+
+    //! Estimate of the measured state
+    JointStateEstimator state_estimator_;
+    JointStateEstimator::Type default_state_estimation_;  //* set by the controller before init()
+    bool within_tolerances_;                               //* all joints tracked within tolerance in the last cycle
+
+    //! Trajectory Generator
+    boost::shared_ptr<ReflexxesAPI> rml_;
+    boost::shared_ptr<RMLPositionInputParameters> rml_in_;
+    boost::shared_ptr<RMLPositionOutputParameters> rml_out_;
+    RMLPositionFlags rml_flags_;  //* set by the target source
+    ros::Time traj_start_time_;
+
+    //! Trajectory parameters
+    double sampling_resolution_;
+    bool recompute_trajectory_;
+
+    CommandOutput output_;
+    ControllerStatePublisher controller_state_publisher_;
+};
+
+} // namespace
+
+#endif
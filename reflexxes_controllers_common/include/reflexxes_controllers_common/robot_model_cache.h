@@ -0,0 +1,108 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_ROBOT_MODEL_CACHE_H
+#define REFLEXXES_CONTROLLERS_COMMON_ROBOT_MODEL_CACHE_H
+
+/**
+  @class reflexxes_controllers_common::RobotModelCache
+  @brief Process-wide cache of parsed robot descriptions
+
+  Controllers loaded into the same controller manager mostly read the same
+  robot_description. The cache parses each distinct description once into
+  an urdf::Model and a KDL::Tree and hands out shared, immutable
+  RobotModels, looked up by the hash of the description string. The chains
+  between two links are extracted once per model as well, with the joint
+  limits used by trac_ik, so that IK solvers can be constructed without
+  parsing the URDF again.
+
+  Models stay cached when the controllers using them are unloaded, so that
+  reloading a controller does not parse the description again. All methods
+  are thread safe and none is realtime safe.
+*/
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <urdf/model.h>
+#include <kdl/tree.hpp>
+#include <kdl/chain.hpp>
+#include <kdl/jntarray.hpp>
+
+namespace reflexxes_controllers_common {
+
+//! Kinematic chain between two links with the limits of its joints
+struct KinematicChain {
+    KDL::Chain chain;
+    KDL::JntArray lower_limits;
+    KDL::JntArray upper_limits;
+};
+
+typedef boost::shared_ptr<const KinematicChain> KinematicChainConstPtr;
+
+//! A parsed robot description
+class RobotModel {
+
+public:
+    //! Parse description, returns false if it is not a valid URDF
+    bool init(const std::string &description);
+
+    const urdf::Model &urdf() const {
+        return urdf_;
+    }
+
+    const KDL::Tree &tree() const {
+        return tree_;
+    }
+
+    //! The chain from root to tip, NULL if there is none
+    KinematicChainConstPtr chain(const std::string &root, const std::string &tip) const;
+
+private:
+    std::string description_;
+    urdf::Model urdf_;
+    KDL::Tree tree_;
+
+    //! Chains extracted so far
+    mutable boost::mutex chains_mutex_;
+    mutable std::map<std::pair<std::string, std::string>, KinematicChainConstPtr> chains_;  //* guarded by chains_mutex_
+
+    friend class RobotModelCache;
+};
+
+typedef boost::shared_ptr<const RobotModel> RobotModelConstPtr;
+
+class RobotModelCache {
+
+public:
+    //! The model of description, parsing it if it is not cached yet. NULL if it is invalid.
+    static RobotModelConstPtr get(const std::string &description);
+
+private:
+    static boost::mutex mutex_;
+    static std::multimap<size_t, RobotModelConstPtr> models_;  //* by description hash, guarded by mutex_
+};
+
+} // namespace
+
+#endif
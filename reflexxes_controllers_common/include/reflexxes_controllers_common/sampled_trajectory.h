@@ -0,0 +1,203 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_SAMPLED_TRAJECTORY_H
+#define REFLEXXES_CONTROLLERS_COMMON_SAMPLED_TRAJECTORY_H
+
+/**
+  @class reflexxes_controllers_common::SampledTrajectory
+  @brief Trajectory profile sampled at a fixed period
+
+  Positions, velocities and accelerations are stored in three flat,
+  preallocated arrays (structure-of-arrays), each laid out sample-major:
+  element (k, i) of an array is the value of joint i at time k*sample_period.
+  For every sample the index of the trajectory point it is heading to is
+  stored as well, so that a controller can resume online planning from the
+  right point.
+
+  Storage is only allocated by resize(); clear(), push_back() and sample()
+  never allocate.
+*/
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <ros/time.h>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+class SampledTrajectory {
+
+public:
+    SampledTrajectory()
+        : n_joints_(0),
+          capacity_(0),
+          n_samples_(0),
+          sample_period_(0.001),
+          valid_(false)
+    {}
+
+    //! Allocate storage for capacity samples of n_joints joints
+    void resize(size_t n_joints, size_t capacity) {
+        n_joints_ = n_joints;
+        capacity_ = capacity;
+        positions_.resize(n_joints * capacity);
+        velocities_.resize(n_joints * capacity);
+        accelerations_.resize(n_joints * capacity);
+        point_indices_.resize(capacity);
+        clear();
+    }
+
+    void clear() {
+        n_samples_ = 0;
+        valid_ = false;
+    }
+
+    //! Append a sample, returns false if the storage is full
+    bool push_back(const double *positions, const double *velocities, const double *accelerations, size_t point_index) {
+        if (n_samples_ >= capacity_) {
+            return false;
+        }
+
+        size_t offset = n_samples_ * n_joints_;
+        std::copy(positions, positions + n_joints_, positions_.begin() + offset);
+        std::copy(velocities, velocities + n_joints_, velocities_.begin() + offset);
+        std::copy(accelerations, accelerations + n_joints_, accelerations_.begin() + offset);
+        point_indices_[n_samples_] = point_index;
+        n_samples_++;
+        return true;
+    }
+
+    /**
+      Interpolate the profile at time t (seconds from the first sample).
+      Positions are interpolated with a cubic Hermite spline on the sampled
+      velocities, velocities and accelerations linearly. Times outside of the
+      profile are clamped to its ends. Returns the index of the sample
+      preceding t.
+    */
+    size_t sample(double t, double *positions, double *velocities, double *accelerations) const {
+        if (n_samples_ == 0) {
+            return 0;
+        }
+
+        double s = std::max(0.0, t / sample_period_);
+        size_t k = static_cast<size_t>(s);
+
+        if (k + 1 >= n_samples_) {
+            k = n_samples_ - 1;
+            size_t offset = k * n_joints_;
+            std::copy(&positions_[offset], &positions_[offset] + n_joints_, positions);
+            std::copy(&velocities_[offset], &velocities_[offset] + n_joints_, velocities);
+            std::copy(&accelerations_[offset], &accelerations_[offset] + n_joints_, accelerations);
+            return k;
+        }
+
+        // Hermite basis functions
+        double u = s - k;
+        double u2 = u * u;
+        double u3 = u2 * u;
+        double h00 = 2 * u3 - 3 * u2 + 1;
+        double h10 = (u3 - 2 * u2 + u) * sample_period_;
+        double h01 = -2 * u3 + 3 * u2;
+        double h11 = (u3 - u2) * sample_period_;
+
+        const double *p0 = &positions_[k * n_joints_];
+        const double *v0 = &velocities_[k * n_joints_];
+        const double *a0 = &accelerations_[k * n_joints_];
+        const double *p1 = p0 + n_joints_;
+        const double *v1 = v0 + n_joints_;
+        const double *a1 = a0 + n_joints_;
+
+        for (size_t i = 0; i < n_joints_; i++) {
+            positions[i] = h00 * p0[i] + h10 * v0[i] + h01 * p1[i] + h11 * v1[i];
+            velocities[i] = v0[i] + u * (v1[i] - v0[i]);
+            accelerations[i] = a0[i] + u * (a1[i] - a0[i]);
+        }
+
+        return k;
+    }
+
+    //! Positions of all joints at sample k
+    const double *positions(size_t k) const {
+        return &positions_[k * n_joints_];
+    }
+
+    //! Index of the trajectory point sample k is heading to
+    size_t pointIndex(size_t k) const {
+        return point_indices_[k];
+    }
+
+    size_t size() const {
+        return n_samples_;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    size_t joints() const {
+        return n_joints_;
+    }
+
+    //! Duration of the profile, i.e. time of the last sample
+    double duration() const {
+        return n_samples_ > 0 ? (n_samples_ - 1) * sample_period_ : 0.0;
+    }
+
+    double samplePeriod() const {
+        return sample_period_;
+    }
+
+    void setSamplePeriod(double sample_period) {
+        sample_period_ = sample_period;
+    }
+
+    //! Whether the profile covers the whole trajectory
+    bool valid() const {
+        return valid_;
+    }
+
+    void setValid(bool valid) {
+        valid_ = valid;
+    }
+
+    //! The trajectory the profile was computed from
+    FixedTrajectory trajectory;
+
+    //! Time of the first sample
+    ros::Time start_time;
+
+private:
+    size_t n_joints_;
+    size_t capacity_;
+    size_t n_samples_;
+    double sample_period_;
+    bool valid_;
+
+    std::vector<double> positions_;
+    std::vector<double> velocities_;
+    std::vector<double> accelerations_;
+    std::vector<size_t> point_indices_;
+};
+
+} // namespace
+
+#endif
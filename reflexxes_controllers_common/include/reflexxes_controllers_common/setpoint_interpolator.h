@@ -0,0 +1,121 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_SETPOINT_INTERPOLATOR_H
+#define REFLEXXES_CONTROLLERS_COMMON_SETPOINT_INTERPOLATOR_H
+
+/**
+  @class reflexxes_controllers_common::SetpointInterpolator
+  @brief Quintic interpolation between two sampled states
+
+  Fits one quintic polynomial per joint to the positions, velocities and
+  accelerations at the start and at the end of a segment, so that the
+  interpolated setpoints are continuous in acceleration across segments.
+  Used to fill the servo cycles between two samples of the trajectory
+  generator. Storage is only allocated by resize().
+*/
+
+#include <vector>
+#include <algorithm>
+
+namespace reflexxes_controllers_common {
+
+class SetpointInterpolator {
+
+public:
+    SetpointInterpolator()
+        : n_joints_(0),
+          duration_(0.0)
+    {}
+
+    //! Allocate storage for n_joints joints
+    void resize(size_t n_joints) {
+        n_joints_ = n_joints;
+        coefficients_.resize(6 * n_joints);
+        end_positions_.resize(n_joints);
+        end_velocities_.resize(n_joints);
+        end_accelerations_.resize(n_joints);
+    }
+
+    //! Fit the segment from state 0 to state 1, which is reached after duration seconds
+    void set(double duration,
+             const double *p0, const double *v0, const double *a0,
+             const double *p1, const double *v1, const double *a1) {
+        duration_ = duration;
+
+        double T = duration;
+        double T2 = T * T;
+        double T3 = T2 * T;
+        double T4 = T3 * T;
+        double T5 = T4 * T;
+
+        for (size_t i = 0; i < n_joints_; i++) {
+            double h = p1[i] - p0[i];
+            double *c = &coefficients_[6 * i];
+
+            c[0] = p0[i];
+            c[1] = v0[i];
+            c[2] = 0.5 * a0[i];
+            c[3] = (20 * h - (8 * v1[i] + 12 * v0[i]) * T - (3 * a0[i] - a1[i]) * T2) / (2 * T3);
+            c[4] = (-30 * h + (14 * v1[i] + 16 * v0[i]) * T + (3 * a0[i] - 2 * a1[i]) * T2) / (2 * T4);
+            c[5] = (12 * h - 6 * (v1[i] + v0[i]) * T + (a1[i] - a0[i]) * T2) / (2 * T5);
+        }
+
+        std::copy(p1, p1 + n_joints_, end_positions_.begin());
+        std::copy(v1, v1 + n_joints_, end_velocities_.begin());
+        std::copy(a1, a1 + n_joints_, end_accelerations_.begin());
+    }
+
+    //! Evaluate the segment at time t from its start, clamped to the segment
+    void sample(double t, double *positions, double *velocities, double *accelerations) const {
+        t = std::max(0.0, std::min(t, duration_));
+
+        for (size_t i = 0; i < n_joints_; i++) {
+            const double *c = &coefficients_[6 * i];
+
+            positions[i] = c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+            velocities[i] = c[1] + t * (2 * c[2] + t * (3 * c[3] + t * (4 * c[4] + t * 5 * c[5])));
+            accelerations[i] = 2 * c[2] + t * (6 * c[3] + t * (12 * c[4] + t * 20 * c[5]));
+        }
+    }
+
+    //! State at the end of the segment, to chain the next one
+    const double *endPositions() const {
+        return &end_positions_[0];
+    }
+
+    const double *endVelocities() const {
+        return &end_velocities_[0];
+    }
+
+    const double *endAccelerations() const {
+        return &end_accelerations_[0];
+    }
+
+private:
+    size_t n_joints_;
+    double duration_;
+    std::vector<double> coefficients_;  //* six per joint, in increasing order
+    std::vector<double> end_positions_;
+    std::vector<double> end_velocities_;
+    std::vector<double> end_accelerations_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,165 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_ACTION_SERVER_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_ACTION_SERVER_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryActionServer
+  @brief FollowJointTrajectory action server of a trajectory controller
+
+  Goals are validated on the non-realtime side: the joints are mapped to the
+  controller's joint order, positions are checked against the URDF limits
+  and velocities against the max_velocity of each joint. Goals may command
+  a subset of the joints, like topic commands, the controller holds the
+  joints left out at their position. Accepted goals are
+  handed to the controller with an id which travels along with the
+  trajectory (see FixedTrajectory::id()).
+
+  The realtime loop only stores the id of the trajectory it follows, and of
+  the trajectory it finished or aborted, in atomic flags, and fills a
+  preallocated feedback message through a RealtimeMailbox every decimation
+  cycles. A timer on the non-realtime side turns these into goal status
+  changes and feedback. A goal is canceled when another goal or a topic
+  command replaces it, and aborted if it is not finished within its
+  goal_time_tolerance after the end of the trajectory.
+
+  @section ROS ROS interface
+
+  Provides:
+
+  - @b follow_joint_trajectory (control_msgs::FollowJointTrajectory) :
+    The trajectory to follow.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <ros/node_handle.h>
+#include <urdf/model.h>
+#include <actionlib/server/action_server.h>
+#include <control_msgs/FollowJointTrajectoryAction.h>
+
+#include <reflexxes_controllers_common/joint_name_map.h>
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+namespace reflexxes_controllers_common {
+
+class TrajectoryActionServer {
+
+public:
+    //! Non-RT: hand a validated trajectory with its id to the controller, which reports the duration it will take. Returns false if it was rejected.
+    typedef boost::function<bool(const trajectory_msgs::JointTrajectoryConstPtr &, uint32_t, ros::Duration *)> CommandFunction;
+
+    //! Non-RT: stop the controller at its current position
+    typedef boost::function<void()> HoldFunction;
+
+    TrajectoryActionServer();
+
+    /**
+      Start the action server in the namespace of nh. Goal status and feedback
+      are updated every feedback_period.
+    */
+    void init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names,
+              const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints,
+              const std::vector<double> &max_velocities, const ros::Duration &feedback_period,
+              const CommandFunction &command, const HoldFunction &hold);
+
+    //! Non-RT: cancel the active goal, which has been replaced by another command
+    void preempt();
+
+    //! Non-RT: check the velocities of new goals against max_velocities
+    void setMaxVelocities(const std::vector<double> &max_velocities) {
+        boost::lock_guard<boost::mutex> lock(limits_mutex_);
+        max_velocities_ = max_velocities;
+    }
+
+    //! RT: report the trajectory being followed, 0 if it was not commanded by a goal
+    void setActive(uint32_t id) {
+        active_id_.store(id, boost::memory_order_relaxed);
+    }
+
+    //! RT: report that trajectory id reached its last point
+    void setFinished(uint32_t id) {
+        finished_id_.store(id, boost::memory_order_relaxed);
+    }
+
+    //! RT: report that trajectory id could not be followed
+    void setAborted(uint32_t id) {
+        aborted_id_.store(id, boost::memory_order_relaxed);
+    }
+
+    //! RT: feedback to fill in completely before publishFeedback()
+    control_msgs::FollowJointTrajectoryFeedback &feedback() {
+        return feedback_mailbox_.writeBuffer();
+    }
+
+    //! RT: hand the feedback over to the non-realtime side
+    void publishFeedback() {
+        feedback_mailbox_.publish();
+    }
+
+private:
+    typedef actionlib::ActionServer<control_msgs::FollowJointTrajectoryAction> ActionServer;
+    typedef ActionServer::GoalHandle GoalHandle;
+
+    std::vector<std::string> joint_names_;
+    JointNameMap joint_name_map_;
+    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
+    mutable boost::mutex limits_mutex_;
+    std::vector<double> max_velocities_;  //* guarded by limits_mutex_
+    CommandFunction command_;
+    HoldFunction hold_;
+
+    boost::scoped_ptr<ActionServer> action_server_;
+    ros::Timer timer_;
+
+    //! Goal being executed, guarded by mutex_
+    boost::mutex mutex_;
+    GoalHandle goal_;
+    bool has_goal_;
+    bool goal_started_;  //* the realtime loop picked up the trajectory of the goal
+    uint32_t goal_id_;
+    ros::Time goal_deadline_;  //* zero if the goal has no goal_time_tolerance
+    uint32_t next_goal_id_;
+
+    //! Realtime loop -> timer
+    boost::atomic<uint32_t> active_id_;
+    boost::atomic<uint32_t> finished_id_;
+    boost::atomic<uint32_t> aborted_id_;
+    RealtimeMailbox<control_msgs::FollowJointTrajectoryFeedback> feedback_mailbox_;
+
+    void goalCB(GoalHandle gh);
+    void cancelCB(GoalHandle gh);
+    void update(const ros::TimerEvent &event);
+
+    //! Map the goal to the controller's joints and check it, fills in result on failure
+    bool validate(const control_msgs::FollowJointTrajectoryGoal &goal, trajectory_msgs::JointTrajectory &trajectory,
+                  control_msgs::FollowJointTrajectoryResult &result) const;
+};
+
+} // namespace
+
+#endif
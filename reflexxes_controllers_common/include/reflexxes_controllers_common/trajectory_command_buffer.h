@@ -0,0 +1,195 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_COMMAND_BUFFER_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_COMMAND_BUFFER_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryCommandBuffer
+  @brief Allocation-free replacement for RealtimeBuffer<JointTrajectory>
+
+  Commands are validated and copied into a preallocated FixedTrajectory on
+  the non-realtime side, then handed to the realtime loop by swapping a
+  pointer. Commands which do not fit are rejected with an error before the
+  realtime loop sees them. Any number of non-realtime threads may write,
+  there must be a single realtime reader.
+
+  The trajectories live in a pool of slots allocated by init(). A writer
+  acquires a free slot, fills it in place and publishes it, replacing any
+  slot published before which the realtime loop has not fetched yet. The
+  realtime loop frees the slot it followed when it fetches the next one,
+  so slots never move and nothing is copied between the threads. Besides
+  the slots of the realtime loop and of writeFromNonRT(), n_spare slots can
+  be held by writers filling trajectories in place (see acquire()).
+*/
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+class TrajectoryCommandBuffer {
+
+public:
+    TrajectoryCommandBuffer()
+        : n_slots_(0),
+          pending_(NULL),
+          active_(NULL)
+    {}
+
+    //! Allocate the slots for trajectories of up to max_points points, n_spare of them for acquire()
+    void init(size_t n_joints, size_t max_points, size_t n_spare = 0) {
+        n_slots_ = 3 + n_spare;
+        slots_.reset(new Slot[n_slots_]);
+
+        for (size_t s = 0; s < n_slots_; s++) {
+            slots_[s].trajectory.resize(n_joints, max_points);
+            slots_[s].state.store(SLOT_FREE);
+        }
+
+        slots_[0].state.store(SLOT_ACTIVE);
+        active_ = &slots_[0];
+        pending_.store(NULL);
+    }
+
+    /**
+      Non-RT: reserve an empty trajectory to be filled in place and passed
+      to publish() or release(). Returns NULL if all slots are in use.
+    */
+    FixedTrajectory *acquire() {
+        for (size_t s = 0; s < n_slots_; s++) {
+            int expected = SLOT_FREE;
+
+            if (slots_[s].state.compare_exchange_strong(expected, SLOT_WRITING, boost::memory_order_acquire)) {
+                slots_[s].trajectory.clear();
+                return &slots_[s].trajectory;
+            }
+        }
+
+        return NULL;
+    }
+
+    //! Non-RT: return an acquired trajectory without publishing it
+    void release(FixedTrajectory *trajectory) {
+        slot(trajectory)->state.store(SLOT_FREE, boost::memory_order_release);
+    }
+
+    //! Non-RT: hand an acquired trajectory over to the realtime loop
+    void publish(FixedTrajectory *trajectory) {
+        Slot *published = slot(trajectory);
+        published->state.store(SLOT_PENDING, boost::memory_order_relaxed);
+
+        // A trajectory the realtime loop did not fetch in time is dropped
+        Slot *dropped = pending_.exchange(published, boost::memory_order_acq_rel);
+
+        if (dropped) {
+            dropped->state.store(SLOT_FREE, boost::memory_order_release);
+        }
+    }
+
+    //! Non-RT: validate and publish a trajectory with its command id and held joints, returns false if it was rejected
+    template <class Msg>
+    bool writeFromNonRT(const Msg &msg, uint32_t id = 0, const JointMask &held = JointMask()) {
+        boost::lock_guard<boost::mutex> lock(write_mutex_);
+        FixedTrajectory *trajectory = acquire();
+
+        if (!trajectory) {
+            ROS_ERROR("All trajectory slots are in use.");
+            return false;
+        }
+
+        if (!trajectory->assign(msg, id, held)) {
+            release(trajectory);
+            return false;
+        }
+
+        publish(trajectory);
+        return true;
+    }
+
+    //! RT: fetch the latest trajectory, returns false if nothing new was written
+    bool readFromRT() {
+        if (!pending_.load(boost::memory_order_relaxed)) {
+            return false;
+        }
+
+        Slot *fetched = pending_.exchange(NULL, boost::memory_order_acq_rel);
+
+        if (!fetched) {
+            return false;
+        }
+
+        // The followed trajectory goes back to the writers
+        fetched->state.store(SLOT_ACTIVE, boost::memory_order_relaxed);
+        active_->state.store(SLOT_FREE, boost::memory_order_release);
+        active_ = fetched;
+        return true;
+    }
+
+    //! RT: drop any pending trajectory and return the current one for in-place initialization
+    FixedTrajectory &initRT() {
+        readFromRT();
+        return active_->trajectory;
+    }
+
+    //! RT: the current trajectory
+    const FixedTrajectory &trajectory() {
+        return active_->trajectory;
+    }
+
+private:
+    enum SlotState {
+        SLOT_FREE,
+        SLOT_WRITING,  //* acquired by a writer
+        SLOT_PENDING,  //* published, not fetched yet
+        SLOT_ACTIVE    //* followed by the realtime loop
+    };
+
+    struct Slot {
+        FixedTrajectory trajectory;
+        boost::atomic<int> state;
+    };
+
+    Slot *slot(FixedTrajectory *trajectory) {
+        size_t s = 0;
+
+        while (&slots_[s].trajectory != trajectory) {
+            s++;
+        }
+
+        return &slots_[s];
+    }
+
+    boost::mutex write_mutex_;
+    boost::scoped_array<Slot> slots_;
+    size_t n_slots_;
+    boost::atomic<Slot *> pending_;
+    Slot *active_;  //* only used by the realtime loop
+
+    // Non-copyable
+    TrajectoryCommandBuffer(const TrajectoryCommandBuffer &);
+    TrajectoryCommandBuffer &operator=(const TrajectoryCommandBuffer &);
+};
+
+} // namespace
+
+#endif
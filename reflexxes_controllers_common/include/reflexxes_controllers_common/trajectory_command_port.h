@@ -0,0 +1,126 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_COMMAND_PORT_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_COMMAND_PORT_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryCommandPort
+  @brief In-process command interface of a joint trajectory controller
+
+  Planners running in the same process as the controller manager, e.g. as
+  nodelets or controller plugins, look up the port of a controller by its
+  namespace with find(), instead of going through the trajectory_command
+  topic. Commands through a port replace the current trajectory and preempt
+  the active goal, like topic commands.
+
+  - command(msg) takes the message by pointer. It is only copied if it does
+    not list the controller joints in their order or has to be rewritten
+    (lookahead_points, segment_timing "scale"), before it is converted
+    into the realtime storage.
+
+  - acquire() hands out an empty FixedTrajectory from the preallocated
+    pool of the controller (see trajectory_pool_size), in the order of the
+    controller joints. It is filled in place and passed to command(), which
+    checks it and publishes it to the realtime loop by swapping a pointer,
+    or to release(). Nothing is copied or allocated on the way.
+
+  Ports are created by the controllers with advertise() and shut down when
+  the controller is unloaded, after which all commands fail. Trajectories
+  acquired from a port must be commanded or released before the controller
+  is unloaded. All methods are thread safe and none is realtime safe.
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+#include <reflexxes_controllers_common/trajectory_command_buffer.h>
+
+namespace reflexxes_controllers_common {
+
+class TrajectoryCommandPort;
+typedef boost::shared_ptr<TrajectoryCommandPort> TrajectoryCommandPortPtr;
+
+class TrajectoryCommandPort {
+
+public:
+    //! Command a message, returns false if it was rejected
+    typedef boost::function<bool(const trajectory_msgs::JointTrajectoryConstPtr &)> MessageFunction;
+
+    //! Check and publish an acquired trajectory or release it, returns false if it was rejected
+    typedef boost::function<bool(FixedTrajectory *)> TrajectoryFunction;
+
+    //! The port of the controller in controller_namespace (e.g. "/arm_controller"), NULL if there is none
+    static TrajectoryCommandPortPtr find(const std::string &controller_namespace);
+
+    //! Controller: create and register the port of the controller in controller_namespace
+    static TrajectoryCommandPortPtr advertise(const std::string &controller_namespace,
+                                              const std::vector<std::string> &joint_names,
+                                              TrajectoryCommandBuffer &buffer,
+                                              const MessageFunction &command_message,
+                                              const TrajectoryFunction &command_trajectory);
+
+    //! Controller: unregister the port and reject all further commands
+    void shutdown();
+
+    //! Whether the controller still accepts commands
+    bool connected() const;
+
+    //! The controller joints, in the order of acquired trajectories
+    const std::vector<std::string> &jointNames() const {
+        return joint_names_;
+    }
+
+    //! Command a trajectory, returns false if it was rejected
+    bool command(const trajectory_msgs::JointTrajectoryConstPtr &msg);
+
+    //! An empty trajectory to be filled in place, NULL if all are in use or the controller is gone
+    FixedTrajectory *acquire();
+
+    //! Command an acquired trajectory, which is given back to the controller in any case
+    bool command(FixedTrajectory *trajectory);
+
+    //! Give back an acquired trajectory without commanding it
+    void release(FixedTrajectory *trajectory);
+
+private:
+    TrajectoryCommandPort() : buffer_(NULL) {}
+
+    mutable boost::mutex mutex_;
+    std::string namespace_;
+    std::vector<std::string> joint_names_;
+    TrajectoryCommandBuffer *buffer_;  //* guarded by mutex_, NULL after shutdown()
+    MessageFunction command_message_;
+    TrajectoryFunction command_trajectory_;
+
+    static boost::mutex registry_mutex_;
+    static std::map<std::string, boost::weak_ptr<TrajectoryCommandPort> > registry_;  //* guarded by registry_mutex_
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,118 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_CURSOR_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_CURSOR_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryCursor
+  @brief Progress of a realtime loop along a FixedTrajectory
+
+  Keeps the start time of the followed trajectory and the index of the
+  point it is heading to, and answers the timing questions of the target
+  sources following FixedTrajectory commands point by point: when the
+  trajectory starts, how long is left to reach the active point, and when
+  the points after it are due. The trajectory itself is passed to every
+  call, the cursor does not keep a reference to it.
+
+  Nothing allocates, all methods are realtime safe.
+*/
+
+#include <algorithm>
+
+#include <ros/time.h>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+class TrajectoryCursor {
+
+public:
+    TrajectoryCursor()
+        : point_index_(0)
+    {}
+
+    //! Head for the first point, the trajectory starts at its stamp or at time if the stamp is zero
+    void start(const FixedTrajectory &trajectory, const ros::Time &time) {
+        start_time_ = trajectory.stamp().isZero() ? time : trajectory.stamp();
+        point_index_ = 0;
+    }
+
+    //! Skip the points whose time has already passed at time, but the last one
+    void skipPassed(const FixedTrajectory &trajectory, const ros::Time &time) {
+        while (point_index_ + 1 < trajectory.size() &&
+                start_time_ + trajectory.timeFromStart(point_index_) <= time) {
+            point_index_++;
+        }
+    }
+
+    //! Head for the next point, once the active one is reached
+    void advance(const FixedTrajectory &trajectory) {
+        if (point_index_ < trajectory.size()) {
+            point_index_++;
+        }
+    }
+
+    //! Whether the trajectory starts within the cycle at time
+    bool started(const ros::Time &time, const ros::Duration &period) const {
+        return start_time_ <= time + period;
+    }
+
+    //! Whether every point has been reached
+    bool complete(const FixedTrajectory &trajectory) const {
+        return point_index_ >= trajectory.size();
+    }
+
+    //! Seconds left at time to reach the active point at its time from start, at least 0
+    double timeToPoint(const FixedTrajectory &trajectory, const ros::Time &time) const {
+        return std::max(0.0, (trajectory.timeFromStart(point_index_) - (time - start_time_)).toSec());
+    }
+
+    //! Seconds from time to each of the points after the active one, returns their number
+    size_t upcomingWaypoints(const FixedTrajectory &trajectory, const ros::Time &time, double *times,
+                             size_t max_waypoints) const {
+        size_t n_waypoints = 0;
+
+        for (size_t k = point_index_ + 1; k < trajectory.size() && n_waypoints < max_waypoints; k++) {
+            times[n_waypoints++] = (start_time_ + trajectory.timeFromStart(k) - time).toSec();
+        }
+
+        return n_waypoints;
+    }
+
+    size_t pointIndex() const {
+        return point_index_;
+    }
+
+    void setPointIndex(size_t point_index) {
+        point_index_ = point_index;
+    }
+
+    const ros::Time &startTime() const {
+        return start_time_;
+    }
+
+private:
+    ros::Time start_time_;
+    size_t point_index_;
+};
+
+} // namespace
+
+#endif
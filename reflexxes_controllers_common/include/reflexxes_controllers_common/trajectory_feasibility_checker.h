@@ -0,0 +1,131 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_FEASIBILITY_CHECKER_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_FEASIBILITY_CHECKER_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryFeasibilityChecker
+  @brief Checks commanded trajectories against the joint limits before execution
+
+  Every point must be finite, lie within the URDF position limits of the
+  bounded joints and respect the max_velocity and the max_acceleration of
+  each joint. The times from start must not decrease.
+
+  For every segment between two points, a lower bound of its duration is
+  computed from the displacement, the boundary velocities and
+  accelerations, and the velocity, acceleration and jerk limits. Segments
+  which are shorter than that are kept, and left for Reflexxes to stretch
+  online, rejected, or stretched to their minimum duration up front,
+  depending on the SegmentTiming. The segment towards the first point
+  starts from the state at execution time and is not checked.
+
+  The points of messages are copied into flat point-major arrays, so that
+  the checks run as flat loops over all joints and points. A FixedTrajectory
+  is checked in place. Not realtime safe, meant to be run when a trajectory
+  is received.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <urdf/model.h>
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <reflexxes_controllers_common/fixed_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+class TrajectoryFeasibilityChecker {
+
+public:
+    //! Handling of segments shorter than their minimum duration
+    enum SegmentTiming {
+        KEEP_SEGMENT_TIMING,    //* accept them, Reflexxes reaches the point late
+        REJECT_SHORT_SEGMENTS,  //* reject the trajectory
+        SCALE_SHORT_SEGMENTS    //* stretch them to their minimum duration, delaying the following points
+    };
+
+    TrajectoryFeasibilityChecker();
+
+    void init(const std::vector<std::string> &joint_names,
+              const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints, SegmentTiming segment_timing);
+
+    //! Parse a SegmentTiming from "keep", "reject" or "scale"
+    static bool parseSegmentTiming(const std::string &name, SegmentTiming &segment_timing);
+
+    /**
+      Check trajectory, which is in the order of the controller joints, with
+      the joints in held left out, against the current limits. Returns false
+      with a description in error if the trajectory is rejected. If short
+      segments have to be stretched, stretched() is set afterwards.
+    */
+    bool check(const trajectory_msgs::JointTrajectory &trajectory, const JointMask &held,
+               const std::vector<double> &max_velocities, const std::vector<double> &max_accelerations,
+               const std::vector<double> &max_jerks, std::string &error);
+
+    //! Check a trajectory in the order of the controller joints, leaving out its held joints
+    bool check(const FixedTrajectory &trajectory,
+               const std::vector<double> &max_velocities, const std::vector<double> &max_accelerations,
+               const std::vector<double> &max_jerks, std::string &error);
+
+    //! Whether the SegmentTiming requires the last checked trajectory to be stretched
+    bool stretched() const {
+        return stretched_;
+    }
+
+    //! Delay the points of the last checked trajectory so that its segments last their minimum duration
+    void stretch(trajectory_msgs::JointTrajectory &trajectory) const;
+    void stretch(FixedTrajectory &trajectory) const;
+
+    //! Minimum duration of every segment of the last checked trajectory, the first one is 0
+    const std::vector<double> &minimumDurations() const {
+        return minimum_durations_;
+    }
+
+private:
+    //! Check n_points point-major points with times_ filled in
+    bool checkPoints(size_t n_points, const double *positions, const double *velocities,
+                     const double *accelerations, const JointMask &held,
+                     const std::vector<double> &max_velocities, const std::vector<double> &max_accelerations,
+                     const std::vector<double> &max_jerks, std::string &error);
+
+    std::vector<std::string> joint_names_;
+    std::vector<double> lower_limits_;  //* -inf for unbounded joints
+    std::vector<double> upper_limits_;  //* +inf for unbounded joints
+    SegmentTiming segment_timing_;
+
+    //! Scratch arrays, point-major with one entry per joint
+    std::vector<double> positions_;
+    std::vector<double> velocities_;
+    std::vector<double> accelerations_;
+    std::vector<double> times_;
+    std::vector<double> minimum_durations_;
+    std::vector<double> joint_durations_;  //* per joint of one segment
+    std::vector<double> delays_;           //* of each point to stretch the segments
+    JointMask held_;                       //* of the checked FixedTrajectory
+    JointMask checked_;                    //* joints which are not held
+    bool stretched_;
+};
+
+} // namespace
+
+#endif
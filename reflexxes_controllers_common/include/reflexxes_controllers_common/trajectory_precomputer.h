@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_PRECOMPUTER_H
+#define REFLEXXES_CONTROLLERS_COMMON_TRAJECTORY_PRECOMPUTER_H
+
+/**
+  @class reflexxes_controllers_common::TrajectoryPrecomputer
+  @brief Samples whole Reflexxes trajectories on a non-realtime thread
+
+  The precomputer runs the same point-by-point Reflexxes planning as the
+  online JointTrajectoryController loop over a complete
+  trajectory_msgs::JointTrajectory, starting from the setpoint last reported
+  by the realtime loop, and samples the result into a SampledTrajectory. The
+  realtime loop fetches finished profiles through a lock-free mailbox and
+  only has to interpolate them.
+
+  Trajectories with more than max_points points are rejected by request().
+  If a trajectory cannot be planned or does not fit into the preallocated
+  profile, an invalid profile is delivered which still carries the
+  trajectory, so that the controller can fall back to online planning.
+  Profiles start from the last reported setpoint, at the time it was
+  reported or at a later header stamp. Point times of trajectories with a
+  zero header stamp count from the reported setpoint. Held joints stay at
+  their start position.
+*/
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <ReflexxesAPI.h>
+#include <RMLPositionFlags.h>
+#include <RMLPositionInputParameters.h>
+#include <RMLPositionOutputParameters.h>
+
+#include <reflexxes_controllers_common/kinematic_limits.h>
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+#include <reflexxes_controllers_common/sampled_trajectory.h>
+
+namespace reflexxes_controllers_common {
+
+//! Position, velocity and acceleration of all joints at a given time
+struct TrajectoryState {
+    ros::Time stamp;
+    std::vector<double> positions;
+    std::vector<double> velocities;
+    std::vector<double> accelerations;
+
+    void resize(size_t n_joints) {
+        positions.resize(n_joints);
+        velocities.resize(n_joints);
+        accelerations.resize(n_joints);
+    }
+};
+
+class TrajectoryPrecomputer {
+
+public:
+    TrajectoryPrecomputer();
+    ~TrajectoryPrecomputer();
+
+    /**
+      Allocate all buffers and start the worker thread. The kinematic limits
+      and the selection vector are taken from limits, profiles are sampled
+      every sampling_resolution seconds and may last up to max_duration.
+    */
+    bool init(const RMLPositionInputParameters &limits, double sampling_resolution, double max_duration,
+              size_t max_points);
+
+    //! Stop the worker thread
+    void stop();
+
+    //! Non-RT: queue a trajectory with its command id and held joints for sampling, replacing any queued one. Returns false if it was rejected.
+    bool request(const trajectory_msgs::JointTrajectoryConstPtr &msg, uint32_t id = 0, const JointMask &held = JointMask());
+
+    //! Non-RT: plan the next requested trajectories with new limits
+    void setLimits(const KinematicLimits &limits);
+
+    //! RT: report the setpoint at time, used as start state of the next profile
+    void setStartState(const ros::Time &time, const double *positions, const double *velocities,
+                       const double *accelerations);
+
+    //! RT: fetch the latest profile, returns false if there is none
+    bool fetch();
+
+    //! RT: last fetched profile
+    const SampledTrajectory &trajectory() {
+        return profile_mailbox_.readBuffer();
+    }
+
+private:
+    size_t n_joints_;
+    double sampling_resolution_;
+    FixedTrajectory validator_;  //* only sized, used to check requests
+
+    //! Trajectory Generator, only used by the worker
+    boost::scoped_ptr<ReflexxesAPI> rml_;
+    boost::scoped_ptr<RMLPositionInputParameters> rml_in_;
+    boost::scoped_ptr<RMLPositionOutputParameters> rml_out_;
+    RMLPositionFlags rml_flags_;
+
+    //! Worker thread
+    boost::thread thread_;
+    boost::mutex mutex_;
+    boost::condition_variable condition_;
+    trajectory_msgs::JointTrajectoryConstPtr pending_trajectory_;  //* guarded by mutex_
+    uint32_t pending_id_;                                         //* guarded by mutex_
+    JointMask pending_held_;                                      //* guarded by mutex_
+    KinematicLimits pending_limits_;                              //* guarded by mutex_
+    bool limits_pending_;                                         //* guarded by mutex_
+    bool shutdown_;                                               //* guarded by mutex_
+
+    RealtimeMailbox<TrajectoryState> start_state_mailbox_;  //* RT -> worker
+    RealtimeMailbox<SampledTrajectory> profile_mailbox_;    //* worker -> RT
+
+    void worker();
+    bool compute(const FixedTrajectory &trajectory,
+                 const TrajectoryState &start,
+                 SampledTrajectory &profile);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,48 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_COMMON_VIA_VELOCITIES_H
+#define REFLEXXES_CONTROLLERS_COMMON_VIA_VELOCITIES_H
+
+#include <vector>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+namespace reflexxes_controllers_common {
+
+/**
+  Fill in the velocities of the trajectory points which have none, so that
+  the trajectory is passed through instead of stopping at every point.
+
+  For every joint, the velocity at a point follows the direction of motion
+  and is the smaller of the incoming and outgoing segment velocities given
+  by the point times. It is zero where the joint reverses. If the joint has
+  to stop or reverse within the next lookahead points, the velocity is
+  limited so that it can brake to rest in the remaining distance with
+  max_accelerations. The last point is always reached at rest. All
+  velocities are clamped to max_velocities.
+
+  Not realtime safe, meant to be run when a trajectory is received.
+*/
+void computeViaVelocities(trajectory_msgs::JointTrajectory &trajectory, size_t lookahead,
+                          const std::vector<double> &max_velocities,
+                          const std::vector<double> &max_accelerations);
+
+} // namespace
+
+#endif
@@ -0,0 +1,252 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include <reflexxes_controllers_common/black_box_recorder.h>
+#include <ros/console.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace reflexxes_controllers_common {
+
+static const boost::uint32_t BLACK_BOX_VERSION = 1;
+
+//! Time the service waits for the realtime loop to freeze, in milliseconds
+static const int FREEZE_TIMEOUT_MS = 1000;
+
+BlackBoxRecorder::BlackBoxRecorder()
+    : fd_(-1),
+      mapping_(NULL),
+      mapping_size_(0),
+      header_(NULL),
+      records_(NULL),
+      n_joints_(0),
+      freeze_on_error_(true),
+      max_snapshots_(10),
+      records_since_rearm_(0),
+      freeze_requested_(false),
+      frozen_(FREEZE_NONE),
+      snapshots_(0)
+{}
+
+BlackBoxRecorder::~BlackBoxRecorder() {
+    close();
+}
+
+void BlackBoxRecorder::close() {
+    timer_.stop();
+    service_.shutdown();
+
+    if (mapping_) {
+        munlock(mapping_, mapping_size_);
+        munmap(mapping_, mapping_size_);
+    }
+
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+
+    fd_ = -1;
+    mapping_ = NULL;
+    header_ = NULL;
+    records_ = NULL;
+}
+
+bool BlackBoxRecorder::init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names, double nominal_period) {
+    close();
+
+    ros::NodeHandle black_box_nh(nh, "black_box");
+    bool enabled;
+    black_box_nh.param("enabled", enabled, false);
+
+    if (!enabled) {
+        return true;
+    }
+
+    // Default to a file named after the controller namespace
+    std::string name = nh.getNamespace();
+    std::replace(name.begin(), name.end(), '/', '_');
+    black_box_nh.param("path", path_, "/tmp/" + name.substr(name.find_first_not_of('_')) + "_black_box.bin");
+
+    double duration;
+    black_box_nh.param("duration", duration, 10.0);
+    black_box_nh.param("freeze_on_error", freeze_on_error_, true);
+    black_box_nh.param("max_snapshots", max_snapshots_, 10);
+
+    if (duration <= 0 || nominal_period <= 0) {
+        ROS_ERROR("The 'black_box/duration' parameter must be positive (namespace '%s')", nh.getNamespace().c_str());
+        return false;
+    }
+
+    // Lay out the file, the records start on a page
+    n_joints_ = joint_names.size();
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t names_size = n_joints_ * BLACK_BOX_NAME_SIZE;
+    size_t records_offset = (sizeof(BlackBoxFileHeader) + names_size + page_size - 1) / page_size * page_size;
+    size_t record_size = sizeof(BlackBoxRecord) + n_joints_ * BLACK_BOX_VALUES_PER_JOINT * sizeof(double);
+    size_t capacity = static_cast<size_t>(std::ceil(duration / nominal_period));
+    mapping_size_ = records_offset + capacity * record_size;
+
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd_ < 0 || ftruncate(fd_, mapping_size_) != 0) {
+        ROS_ERROR("Could not create the black box file '%s': %s", path_.c_str(), std::strerror(errno));
+        close();
+        return false;
+    }
+
+    void *mapping = mmap(NULL, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (mapping == MAP_FAILED) {
+        ROS_ERROR("Could not map the black box file '%s': %s", path_.c_str(), std::strerror(errno));
+        close();
+        return false;
+    }
+
+    // Touch every page now, the realtime loop must not fault
+    mapping_ = static_cast<char *>(mapping);
+    std::memset(mapping_, 0, mapping_size_);
+
+    if (mlock(mapping_, mapping_size_) != 0) {
+        ROS_WARN("Could not lock the black box file '%s' in memory: %s", path_.c_str(), std::strerror(errno));
+    }
+
+    header_ = reinterpret_cast<BlackBoxFileHeader *>(mapping_);
+    std::strncpy(header_->magic, "RFXBBOX", sizeof(header_->magic));
+    header_->version = BLACK_BOX_VERSION;
+    header_->n_joints = n_joints_;
+    header_->values_per_joint = BLACK_BOX_VALUES_PER_JOINT;
+    header_->record_size = record_size;
+    header_->records_offset = records_offset;
+    header_->capacity = capacity;
+    header_->count = 0;
+    header_->frozen = 0;
+    header_->nominal_period = nominal_period;
+
+    char *names = mapping_ + sizeof(BlackBoxFileHeader);
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        std::strncpy(names + i * BLACK_BOX_NAME_SIZE, joint_names[i].c_str(), BLACK_BOX_NAME_SIZE - 1);
+    }
+
+    records_since_rearm_ = capacity;
+    freeze_requested_.store(false);
+    frozen_.store(FREEZE_NONE);
+    snapshots_.store(0);
+    records_ = mapping_ + records_offset;
+
+    ROS_INFO("Recording %zu cycles (%f seconds) into black box file '%s'.", capacity, duration, path_.c_str());
+
+    timer_ = nh.createTimer(ros::Duration(0.1), &BlackBoxRecorder::update, this);
+    service_ = nh.advertiseService("freeze_black_box", &BlackBoxRecorder::freeze, this);
+
+    return true;
+}
+
+void BlackBoxRecorder::update(const ros::TimerEvent &) {
+    if (frozen_.load(boost::memory_order_acquire) == FREEZE_AUTOMATIC) {
+        std::string snapshot = writeSnapshot(FREEZE_AUTOMATIC);
+
+        if (!snapshot.empty()) {
+            ROS_WARN("The controller reported an error, black box snapshot written to '%s'.", snapshot.c_str());
+        }
+    }
+}
+
+bool BlackBoxRecorder::freeze(std_srvs::Trigger::Request &, std_srvs::Trigger::Response &response) {
+    freeze_requested_.store(true, boost::memory_order_relaxed);
+
+    // Wait for the realtime loop to complete its record, an automatic freeze is written by the timer first
+    for (int ms = 0; ms < FREEZE_TIMEOUT_MS && frozen_.load(boost::memory_order_acquire) != FREEZE_REQUESTED; ms++) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    bool requested = true;
+
+    if (frozen_.load(boost::memory_order_acquire) != FREEZE_REQUESTED &&
+            freeze_requested_.compare_exchange_strong(requested, false, boost::memory_order_relaxed)) {
+        response.success = false;
+        response.message = frozen_.load(boost::memory_order_acquire) == FREEZE_AUTOMATIC ?
+                           "The recording is frozen by an error, its snapshot is still pending." :
+                           "The controller is not running.";
+        return true;
+    }
+
+    // The realtime loop took the request, its freeze follows at once
+    while (frozen_.load(boost::memory_order_acquire) != FREEZE_REQUESTED) {
+        boost::this_thread::yield();
+    }
+
+    response.message = writeSnapshot(FREEZE_REQUESTED);
+    response.success = !response.message.empty();
+    return true;
+}
+
+std::string BlackBoxRecorder::writeSnapshot(FreezeCause cause) {
+    boost::lock_guard<boost::mutex> lock(snapshot_mutex_);
+
+    if (frozen_.load(boost::memory_order_acquire) != cause) {
+        return std::string();
+    }
+
+    std::string base = path_;
+    std::string::size_type extension = base.rfind(".bin");
+
+    if (extension != std::string::npos && extension + 4 == base.size()) {
+        base.erase(extension);
+    }
+
+    std::ostringstream snapshot;
+    snapshot << base << "_" << boost::posix_time::to_iso_string(boost::posix_time::microsec_clock::universal_time())
+             << ".bin";
+
+    std::ofstream file(snapshot.str().c_str(), std::ios::binary);
+    file.write(mapping_, mapping_size_);
+    bool written = file.good();
+    file.close();
+
+    if (!written) {
+        ROS_ERROR("Could not write the black box snapshot '%s'.", snapshot.str().c_str());
+    }
+
+    // Resume, automatic freezes wait until the ring has been filled again
+    if (cause == FREEZE_AUTOMATIC) {
+        snapshots_.fetch_add(1, boost::memory_order_relaxed);
+        records_since_rearm_ = 0;
+    }
+
+    header_->frozen = 0;
+    frozen_.store(FREEZE_NONE, boost::memory_order_release);
+
+    return written ? snapshot.str() : std::string();
+}
+
+} // namespace
@@ -0,0 +1,123 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/controller_state_publisher.h>
+
+namespace reflexxes_controllers_common {
+
+//! Size the per-sample and per-joint arrays of a batch
+static void allocate(reflexxes_controllers_msgs::ControllerStateBatch &batch,
+                     const std::vector<std::string> &joint_names, size_t decimation, bool effort_terms) {
+    const size_t n_values = decimation * joint_names.size();
+
+    batch.joint_names = joint_names;
+    batch.n_samples = decimation;
+    batch.time_from_header.resize(decimation);
+    batch.set_point.resize(n_values);
+    batch.process_value.resize(n_values);
+    batch.error.resize(n_values);
+
+    if (effort_terms) {
+        batch.command.resize(n_values);
+        batch.p_term.resize(n_values);
+        batch.i_term.resize(n_values);
+        batch.d_term.resize(n_values);
+        batch.ff_term.resize(n_values);
+    }
+}
+
+ControllerStatePublisher::ControllerStatePublisher()
+    : n_joints_(0),
+      decimation_(1),
+      sample_(0),
+      offset_(0)
+{}
+
+void ControllerStatePublisher::init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names,
+                                    int decimation, bool effort_terms) {
+    n_joints_ = joint_names.size();
+    decimation_ = decimation;
+    sample_ = 0;
+    offset_ = 0;
+
+    allocate(batch_, joint_names, decimation_, effort_terms);
+
+    publisher_.reset(new realtime_tools::RealtimePublisher<Batch>(nh, "state", 1));
+    publisher_->lock();
+    allocate(publisher_->msg_, joint_names, decimation_, effort_terms);
+    publisher_->unlock();
+}
+
+void ControllerStatePublisher::reset() {
+    sample_ = 0;
+    offset_ = 0;
+}
+
+void ControllerStatePublisher::beginSample(const ros::Time &time) {
+    if (sample_ == 0) {
+        batch_.header.stamp = time;
+    }
+
+    batch_.time_from_header[sample_] = (time - batch_.header.stamp).toSec();
+    offset_ = sample_ * n_joints_;
+}
+
+void ControllerStatePublisher::setJoint(size_t j, double set_point, double process_value, double error) {
+    batch_.set_point[offset_ + j] = set_point;
+    batch_.process_value[offset_ + j] = process_value;
+    batch_.error[offset_ + j] = error;
+}
+
+void ControllerStatePublisher::setEffort(size_t j, double command, double p_term, double i_term, double d_term,
+                                         double ff_term) {
+    batch_.command[offset_ + j] = command;
+    batch_.p_term[offset_ + j] = p_term;
+    batch_.i_term[offset_ + j] = i_term;
+    batch_.d_term[offset_ + j] = d_term;
+    batch_.ff_term[offset_ + j] = ff_term;
+}
+
+bool ControllerStatePublisher::endSample() {
+    if (++sample_ < decimation_) {
+        return false;
+    }
+
+    sample_ = 0;
+
+    if (!publisher_ || !publisher_->trylock()) {
+        return true;
+    }
+
+    // Swapping equally sized arrays hands the batch over without copying or allocating
+    Batch &msg = publisher_->msg_;
+    msg.header.stamp = batch_.header.stamp;
+    msg.time_from_header.swap(batch_.time_from_header);
+    msg.set_point.swap(batch_.set_point);
+    msg.process_value.swap(batch_.process_value);
+    msg.error.swap(batch_.error);
+    msg.command.swap(batch_.command);
+    msg.p_term.swap(batch_.p_term);
+    msg.i_term.swap(batch_.i_term);
+    msg.d_term.swap(batch_.d_term);
+    msg.ff_term.swap(batch_.ff_term);
+
+    publisher_->unlockAndPublish();
+    return true;
+}
+
+} // namespace
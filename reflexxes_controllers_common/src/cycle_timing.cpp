@@ -0,0 +1,159 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/cycle_timing.h>
+
+#include <cmath>
+#include <limits>
+
+namespace reflexxes_controllers_common {
+
+//! Names of the timing phases in the service response
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+    "update",
+    "rml_position",
+    "rml_sample",
+    "ik",
+    "pid",
+    "rml_velocity",
+    "feedforward"
+};
+
+void PhaseStatistics::reset() {
+    count = 0;
+    min_ns = std::numeric_limits<int64_t>::max();
+    max_ns = 0;
+    total_ns = 0;
+
+    for (int b = 0; b < N_BUCKETS; b++) {
+        histogram[b] = 0;
+    }
+}
+
+void PhaseStatistics::add(int64_t ns) {
+    count++;
+    min_ns = std::min(min_ns, ns);
+    max_ns = std::max(max_ns, ns);
+    total_ns += ns;
+
+    // Bucket b > 0 holds [2^(b-1), 2^b) microseconds
+    int bucket = 0;
+
+    for (int64_t us = ns / 1000; us > 0 && bucket < N_BUCKETS - 1; us >>= 1) {
+        bucket++;
+    }
+
+    histogram[bucket]++;
+}
+
+void TimingStatistics::reset() {
+    cycles = 0;
+    period_deviations = 0;
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        phases[p].reset();
+    }
+}
+
+CycleTiming::CycleTiming()
+    : nominal_period_(0.001),
+      period_tolerance_(0.0001),
+      first_cycle_(true),
+      reset_requested_(false)
+{
+    statistics_.reset();
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        phase_start_ns_[p] = 0;
+    }
+}
+
+void CycleTiming::init(ros::NodeHandle &nh, double nominal_period, double period_tolerance) {
+    nominal_period_ = nominal_period;
+    period_tolerance_ = period_tolerance;
+    first_cycle_ = true;
+
+    statistics_.reset();
+    mailbox_.init(statistics_);
+
+    service_ = nh.advertiseService("get_timing", &CycleTiming::getTiming, this);
+}
+
+void CycleTiming::startCycle(const ros::Duration &period) {
+    if (reset_requested_.exchange(false)) {
+        statistics_.reset();
+        first_cycle_ = true;
+    }
+
+    start(PHASE_UPDATE);
+
+    if (!first_cycle_ && std::abs(period.toSec() - nominal_period_) > period_tolerance_) {
+        statistics_.period_deviations++;
+    }
+
+    first_cycle_ = false;
+}
+
+void CycleTiming::endCycle() {
+    stop(PHASE_UPDATE);
+    statistics_.cycles++;
+
+    mailbox_.writeBuffer() = statistics_;
+    mailbox_.publish();
+}
+
+bool CycleTiming::getTiming(reflexxes_controllers_msgs::GetTimingStatistics::Request &request,
+                            reflexxes_controllers_msgs::GetTimingStatistics::Response &response) {
+    boost::lock_guard<boost::mutex> lock(service_mutex_);
+
+    mailbox_.fetch();
+    const TimingStatistics &statistics = mailbox_.readBuffer();
+
+    response.cycles = statistics.cycles;
+    response.period_deviations = statistics.period_deviations;
+    response.nominal_period = nominal_period_;
+    response.period_tolerance = period_tolerance_;
+
+    response.bucket_upper_bounds.resize(PhaseStatistics::N_BUCKETS - 1);
+
+    for (int b = 0; b < PhaseStatistics::N_BUCKETS - 1; b++) {
+        response.bucket_upper_bounds[b] = 1e-6 * (1 << b);
+    }
+
+    response.phases.resize(PHASE_COUNT);
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const PhaseStatistics &phase = statistics.phases[p];
+        reflexxes_controllers_msgs::PhaseTiming &timing = response.phases[p];
+
+        timing.name = PHASE_NAMES[p];
+        timing.count = phase.count;
+        timing.min = phase.count > 0 ? 1e-9 * phase.min_ns : 0.0;
+        timing.max = 1e-9 * phase.max_ns;
+        timing.mean = phase.count > 0 ? 1e-9 * phase.total_ns / phase.count : 0.0;
+        timing.histogram.assign(phase.histogram, phase.histogram + PhaseStatistics::N_BUCKETS);
+    }
+
+    if (request.reset) {
+        reset_requested_.store(true);
+    }
+
+    return true;
+}
+
+} // namespace
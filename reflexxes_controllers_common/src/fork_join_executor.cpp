@@ -0,0 +1,232 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include <reflexxes_controllers_common/fork_join_executor.h>
+#include <ros/console.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+namespace reflexxes_controllers_common {
+
+namespace {
+
+//! Tell the core that this is a spin loop
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+} // namespace
+
+ForkJoinExecutor::ForkJoinExecutor()
+    : priority_(0),
+      job_(NULL),
+      context_(NULL),
+      n_jobs_(0),
+      generation_(0),
+      next_job_(0),
+      done_jobs_(0),
+      finished_workers_(0),
+      started_workers_(0),
+      failed_workers_(0),
+      paused_(true),
+      shutdown_(false)
+{}
+
+ForkJoinExecutor::~ForkJoinExecutor() {
+    stop();
+}
+
+bool ForkJoinExecutor::init(const std::vector<int> &cores, int priority) {
+    stop();
+
+    if (priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO)) {
+        ROS_ERROR("Invalid SCHED_FIFO priority %d for the worker threads.", priority);
+        return false;
+    }
+
+    for (size_t i = 0; i < cores.size(); i++) {
+        if (cores[i] < 0 || cores[i] >= CPU_SETSIZE) {
+            ROS_ERROR("Invalid core %d for a worker thread.", cores[i]);
+            return false;
+        }
+    }
+
+    cores_ = cores;
+    priority_ = priority;
+    started_workers_.store(0);
+    failed_workers_.store(0);
+    paused_.store(true);
+    shutdown_.store(false);
+
+    // The workers wait for the batch after the current one, even if they start late
+    unsigned generation = generation_.load();
+
+    for (size_t i = 0; i < cores_.size(); i++) {
+        threads_.push_back(boost::make_shared<boost::thread>(
+                               boost::bind(&ForkJoinExecutor::worker, this, cores_[i], generation)));
+    }
+
+    // Unpinned or non-realtime workers would make every cycle wait for the scheduler
+    while (started_workers_.load() < cores_.size()) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    if (failed_workers_.load() > 0) {
+        ROS_WARN("%zu of %zu worker threads could not be set up, running all jobs on the calling thread.",
+                 failed_workers_.load(), cores_.size());
+        stop();
+    }
+
+    return true;
+}
+
+void ForkJoinExecutor::stop() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        shutdown_.store(true);
+    }
+
+    condition_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        threads_[i]->join();
+    }
+
+    threads_.clear();
+    cores_.clear();
+}
+
+void ForkJoinExecutor::pause() {
+    paused_.store(true, boost::memory_order_relaxed);
+}
+
+void ForkJoinExecutor::resume() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        paused_.store(false, boost::memory_order_relaxed);
+    }
+
+    condition_.notify_all();
+}
+
+void ForkJoinExecutor::run(Job job, void *context, size_t n_jobs) {
+    // Without workers, the batch is not published at all
+    if (cores_.empty() || paused_.load(boost::memory_order_relaxed)) {
+        for (size_t i = 0; i < n_jobs; i++) {
+            job(context, i);
+        }
+
+        return;
+    }
+
+    job_ = job;
+    context_ = context;
+    n_jobs_ = n_jobs;
+    next_job_.store(0, boost::memory_order_relaxed);
+    done_jobs_.store(0, boost::memory_order_relaxed);
+    finished_workers_.store(0, boost::memory_order_relaxed);
+
+    // Publish the batch
+    generation_.fetch_add(1, boost::memory_order_release);
+
+    runJobs();
+
+    // Join, no worker may still look at the batch when the next one is set up
+    while (done_jobs_.load(boost::memory_order_acquire) < n_jobs ||
+            finished_workers_.load(boost::memory_order_acquire) < cores_.size()) {
+        cpuRelax();
+    }
+}
+
+void ForkJoinExecutor::runJobs() {
+    for (;;) {
+        size_t index = next_job_.fetch_add(1, boost::memory_order_relaxed);
+
+        if (index >= n_jobs_) {
+            break;
+        }
+
+        job_(context_, index);
+        done_jobs_.fetch_add(1, boost::memory_order_release);
+    }
+}
+
+void ForkJoinExecutor::worker(int core, unsigned generation) {
+    // Pin the worker and make it realtime, init() falls back to the calling thread if this is not permitted
+    bool failed = false;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+
+    if (result != 0) {
+        ROS_WARN("Could not pin worker thread to core %d: %s", core, std::strerror(result));
+        failed = true;
+    }
+
+    sched_param param;
+    param.sched_priority = priority_;
+    result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    if (result != 0) {
+        ROS_WARN("Could not set SCHED_FIFO priority %d of the worker thread on core %d: %s",
+                 priority_, core, std::strerror(result));
+        failed = true;
+    }
+
+    if (failed) {
+        failed_workers_.fetch_add(1);
+    }
+
+    started_workers_.fetch_add(1);
+
+    while (!shutdown_.load(boost::memory_order_relaxed)) {
+        // Sleep while paused, run() does not publish batches meanwhile
+        if (paused_.load(boost::memory_order_relaxed)) {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+
+            while (paused_.load(boost::memory_order_relaxed) && !shutdown_.load(boost::memory_order_relaxed)) {
+                condition_.wait(lock);
+            }
+
+            continue;
+        }
+
+        unsigned current = generation_.load(boost::memory_order_acquire);
+
+        if (current == generation) {
+            cpuRelax();
+            continue;
+        }
+
+        generation = current;
+        runJobs();
+        finished_workers_.fetch_add(1, boost::memory_order_release);
+    }
+}
+
+} // namespace
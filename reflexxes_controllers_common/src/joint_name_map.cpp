@@ -0,0 +1,161 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/joint_name_map.h>
+
+#include <algorithm>
+
+#include <ros/console.h>
+
+namespace reflexxes_controllers_common {
+
+static bool entryLess(const std::pair<std::string, int> &entry, const std::string &name) {
+    return entry.first < name;
+}
+
+void JointNameMap::init(const std::vector<std::string> &joint_names) {
+    n_joints_ = joint_names.size();
+    names_ = joint_names;
+    table_.resize(n_joints_);
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        table_[i] = Entry(joint_names[i], i);
+    }
+
+    std::sort(table_.begin(), table_.end());
+}
+
+int JointNameMap::index(const std::string &name) const {
+    std::vector<Entry>::const_iterator entry = std::lower_bound(table_.begin(), table_.end(), name, entryLess);
+
+    if (entry == table_.end() || entry->first != name) {
+        return -1;
+    }
+
+    return entry->second;
+}
+
+bool JointNameMap::resolve(const std::vector<std::string> &names, std::vector<int> &permutation) const {
+    permutation.assign(n_joints_, -1);
+
+    // Commands without names are in controller order
+    if (names.empty()) {
+        for (size_t i = 0; i < n_joints_; i++) {
+            permutation[i] = i;
+        }
+
+        return true;
+    }
+
+    for (size_t j = 0; j < names.size(); j++) {
+        int i = index(names[j]);
+
+        if (i < 0) {
+            ROS_ERROR("Command includes unknown joint '%s'.", names[j].c_str());
+            return false;
+        }
+
+        if (permutation[i] >= 0) {
+            ROS_ERROR("Command includes joint '%s' more than once.", names[j].c_str());
+            return false;
+        }
+
+        permutation[i] = j;
+    }
+
+    return true;
+}
+
+bool JointNameMap::permute(const trajectory_msgs::JointTrajectory &msg, trajectory_msgs::JointTrajectory &out,
+                           JointMask &held) const {
+    std::vector<int> permutation;
+
+    if (!resolve(msg.joint_names, permutation)) {
+        return false;
+    }
+
+    size_t n_columns = msg.joint_names.empty() ? n_joints_ : msg.joint_names.size();
+
+    held.resize(n_joints_);
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        held[i] = permutation[i] < 0;
+    }
+
+    out.header = msg.header;
+    out.joint_names.clear();
+    out.points.resize(msg.points.size());
+
+    for (size_t k = 0; k < msg.points.size(); k++) {
+        const trajectory_msgs::JointTrajectoryPoint &in = msg.points[k];
+        trajectory_msgs::JointTrajectoryPoint &point = out.points[k];
+
+        if (in.positions.size() != n_columns ||
+                (!in.velocities.empty() && in.velocities.size() != n_columns) ||
+                (!in.accelerations.empty() && in.accelerations.size() != n_columns)) {
+            ROS_ERROR("Trajectory point %zu does not have %zu joints.", k, n_columns);
+            return false;
+        }
+
+        point.positions.assign(n_joints_, 0.0);
+        point.velocities.assign(in.velocities.empty() ? 0 : n_joints_, 0.0);
+        point.accelerations.assign(in.accelerations.empty() ? 0 : n_joints_, 0.0);
+        point.effort.clear();
+        point.time_from_start = in.time_from_start;
+
+        for (size_t i = 0; i < n_joints_; i++) {
+            int j = permutation[i];
+
+            if (j < 0) {
+                continue;
+            }
+
+            point.positions[i] = in.positions[j];
+
+            if (!in.velocities.empty()) {
+                point.velocities[i] = in.velocities[j];
+            }
+
+            if (!in.accelerations.empty()) {
+                point.accelerations[i] = in.accelerations[j];
+            }
+        }
+    }
+
+    return true;
+}
+
+bool JointNameMap::inOrder(const trajectory_msgs::JointTrajectory &msg) const {
+    if (!msg.joint_names.empty() && msg.joint_names != names_) {
+        return false;
+    }
+
+    for (size_t k = 0; k < msg.points.size(); k++) {
+        const trajectory_msgs::JointTrajectoryPoint &point = msg.points[k];
+
+        if (point.positions.size() != n_joints_ ||
+                (!point.velocities.empty() && point.velocities.size() != n_joints_) ||
+                (!point.accelerations.empty() && point.accelerations.size() != n_joints_)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
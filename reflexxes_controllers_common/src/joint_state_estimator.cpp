@@ -0,0 +1,241 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/joint_state_estimator.h>
+
+#include <algorithm>
+
+#include <ros/console.h>
+
+namespace reflexxes_controllers_common {
+
+JointStateEstimator::JointStateEstimator()
+    : type_(MEASURED),
+      n_joints_(0),
+      seed_from_setpoint_(false),
+      alpha_(0.5),
+      beta_(0.1),
+      gamma_(0.01),
+      window_(9),
+      newest_(0)
+{}
+
+bool JointStateEstimator::parseType(const std::string &name, Type &type) {
+    if (name == "measured") {
+        type = MEASURED;
+    } else if (name == "finite_difference") {
+        type = FINITE_DIFFERENCE;
+    } else if (name == "alpha_beta_gamma") {
+        type = ALPHA_BETA_GAMMA;
+    } else if (name == "savitzky_golay") {
+        type = SAVITZKY_GOLAY;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+//! Weights of the quadratic least-squares fit over window samples, by sample age
+static bool savitzkyGolayWeights(size_t window, std::vector<double> &w0, std::vector<double> &w1,
+                                 std::vector<double> &w2) {
+    // Normal equations of the fit p(t) = c0 + c1 t + c2 t^2 over t = 0, -1, ..., 1 - window
+    double s[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+
+    for (size_t a = 0; a < window; a++) {
+        double t = -static_cast<double>(a);
+        double tk = 1.0;
+
+        for (int k = 0; k < 5; k++) {
+            s[k] += tk;
+            tk *= t;
+        }
+    }
+
+    double m[3][3] = {{s[0], s[1], s[2]}, {s[1], s[2], s[3]}, {s[2], s[3], s[4]}};
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+    if (det == 0.0) {
+        return false;
+    }
+
+    // Inverse by the adjugate, it is symmetric
+    double inv[3][3];
+
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            int r0 = (c + 1) % 3, r1 = (c + 2) % 3;
+            int c0 = (r + 1) % 3, c1 = (r + 2) % 3;
+            inv[r][c] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / det;
+        }
+    }
+
+    w0.resize(window);
+    w1.resize(window);
+    w2.resize(window);
+
+    for (size_t a = 0; a < window; a++) {
+        double t = -static_cast<double>(a);
+        w0[a] = inv[0][0] + inv[0][1] * t + inv[0][2] * t * t;
+        w1[a] = inv[1][0] + inv[1][1] * t + inv[1][2] * t * t;
+        w2[a] = inv[2][0] + inv[2][1] * t + inv[2][2] * t * t;
+    }
+
+    return true;
+}
+
+bool JointStateEstimator::init(ros::NodeHandle &nh, size_t n_joints, double nominal_period, Type default_type) {
+    ros::NodeHandle estimator_nh(nh, "state_estimation");
+    std::string type;
+
+    type_ = default_type;
+
+    if (estimator_nh.getParam("type", type) && !parseType(type, type_)) {
+        ROS_ERROR("The 'state_estimation/type' parameter must be 'measured', 'finite_difference', "
+                  "'alpha_beta_gamma' or 'savitzky_golay' (namespace '%s')", nh.getNamespace().c_str());
+        return false;
+    }
+
+    estimator_nh.param("seed_from_setpoint", seed_from_setpoint_, false);
+
+    n_joints_ = n_joints;
+    measured_positions_.assign(n_joints, 0.0);
+    measured_velocities_.assign(n_joints, 0.0);
+    positions_.assign(n_joints, 0.0);
+    velocities_.assign(n_joints, 0.0);
+    accelerations_.assign(n_joints, 0.0);
+
+    if (type_ == ALPHA_BETA_GAMMA) {
+        estimator_nh.param("alpha", alpha_, 0.5);
+        estimator_nh.param("beta", beta_, 0.1);
+        estimator_nh.param("gamma", gamma_, 0.01);
+
+        if (!(alpha_ > 0.0 && alpha_ <= 1.0) || beta_ < 0.0 || gamma_ < 0.0) {
+            ROS_ERROR("The 'state_estimation' gains must be alpha in (0, 1], beta >= 0 and gamma >= 0 (namespace '%s')",
+                      nh.getNamespace().c_str());
+            return false;
+        }
+    }
+
+    if (type_ == SAVITZKY_GOLAY) {
+        int window;
+        estimator_nh.param("window", window, 9);
+
+        if (window < 3 || !savitzkyGolayWeights(window, position_weights_, velocity_weights_, acceleration_weights_)) {
+            ROS_ERROR("The 'state_estimation/window' parameter must be at least 3 (namespace '%s')",
+                      nh.getNamespace().c_str());
+            return false;
+        }
+
+        // Scale the derivatives from samples to seconds
+        window_ = window;
+
+        for (size_t a = 0; a < window_; a++) {
+            velocity_weights_[a] /= nominal_period;
+            acceleration_weights_[a] *= 2.0 / (nominal_period * nominal_period);
+        }
+
+        history_.assign(window_ * n_joints, 0.0);
+        newest_ = 0;
+    }
+
+    return true;
+}
+
+void JointStateEstimator::restart() {
+    std::copy(measured_positions_.begin(), measured_positions_.end(), positions_.begin());
+    std::copy(measured_velocities_.begin(), measured_velocities_.end(), velocities_.begin());
+    std::fill(accelerations_.begin(), accelerations_.end(), 0.0);
+
+    // The history starts at rest at the current positions
+    for (size_t a = 0; a < history_.size(); a += n_joints_) {
+        std::copy(measured_positions_.begin(), measured_positions_.end(), history_.begin() + a);
+    }
+}
+
+void JointStateEstimator::estimate(double dt) {
+    const size_t n = n_joints_;
+    const double *z = &measured_positions_[0];
+    double *p = &positions_[0];
+    double *v = &velocities_[0];
+    double *a = &accelerations_[0];
+
+    // Derivatives need a time step, late or repeated cycles only update the positions
+    if (dt <= 0.0 && type_ != SAVITZKY_GOLAY) {
+        std::copy(z, z + n, p);
+        return;
+    }
+
+    switch (type_) {
+    case MEASURED:
+        std::copy(z, z + n, p);
+        std::copy(measured_velocities_.begin(), measured_velocities_.end(), v);
+        break;
+
+    case FINITE_DIFFERENCE:
+        for (size_t i = 0; i < n; i++) {
+            double velocity = (z[i] - p[i]) / dt;
+            a[i] = (velocity - v[i]) / dt;
+            v[i] = velocity;
+            p[i] = z[i];
+        }
+
+        break;
+
+    case ALPHA_BETA_GAMMA:
+        for (size_t i = 0; i < n; i++) {
+            // Predict with constant acceleration, then correct by the residual of the measurement
+            double predicted_position = p[i] + v[i] * dt + 0.5 * a[i] * dt * dt;
+            double predicted_velocity = v[i] + a[i] * dt;
+            double residual = z[i] - predicted_position;
+
+            p[i] = predicted_position + alpha_ * residual;
+            v[i] = predicted_velocity + beta_ * residual / dt;
+            a[i] = a[i] + 2.0 * gamma_ * residual / (dt * dt);
+        }
+
+        break;
+
+    case SAVITZKY_GOLAY:
+        // Store the latest positions and convolve the window, oldest rows last
+        newest_ = (newest_ + 1) % window_;
+        std::copy(z, z + n, &history_[newest_ * n]);
+        std::fill(p, p + n, 0.0);
+        std::fill(v, v + n, 0.0);
+        std::fill(a, a + n, 0.0);
+
+        for (size_t age = 0; age < window_; age++) {
+            const double *h = &history_[((newest_ + window_ - age) % window_) * n];
+            const double w0 = position_weights_[age];
+            const double w1 = velocity_weights_[age];
+            const double w2 = acceleration_weights_[age];
+
+            for (size_t i = 0; i < n; i++) {
+                p[i] += w0 * h[i];
+                v[i] += w1 * h[i];
+                a[i] += w2 * h[i];
+            }
+        }
+
+        break;
+    };
+}
+
+} // namespace
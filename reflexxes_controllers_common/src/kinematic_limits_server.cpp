@@ -0,0 +1,139 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/kinematic_limits_server.h>
+
+#include <sstream>
+
+namespace reflexxes_controllers_common {
+
+//! Copy the requested values of one limit into the joints they belong to
+static bool assignValues(const std::vector<double> &values, const std::vector<int> &columns,
+                         const char *name, std::vector<double> &limits, std::ostringstream &error) {
+    if (values.empty()) {
+        return true;
+    }
+
+    size_t n_requested = 0;
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i] >= 0) {
+            n_requested++;
+        }
+    }
+
+    if (values.size() != n_requested) {
+        error << "Expected " << n_requested << " " << name << ", got " << values.size() << ".";
+        return false;
+    }
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i] < 0) {
+            continue;
+        }
+
+        double value = values[columns[i]];
+
+        if (!(value > 0.0)) {
+            error << "The " << name << " must be positive.";
+            return false;
+        }
+
+        limits[i] = value;
+    }
+
+    return true;
+}
+
+void KinematicLimitsServer::init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names,
+                                 const KinematicLimits &limits, const RMLPositionInputParameters &rml_in,
+                                 const UpdateFunction &update) {
+    joint_name_map_.init(joint_names);
+    update_ = update;
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        current_ = limits;
+        check_.reset(new RMLPositionInputParameters(rml_in));
+        mailbox_.init(limits);
+    }
+
+    service_ = nh.advertiseService("set_limits", &KinematicLimitsServer::setLimits, this);
+}
+
+bool KinematicLimitsServer::setLimits(reflexxes_controllers_msgs::SetLimits::Request &request,
+                                      reflexxes_controllers_msgs::SetLimits::Response &response) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    std::ostringstream error;
+    std::vector<int> columns;
+
+    KinematicLimits limits = current_;
+    response.success = false;
+
+    if (!joint_name_map_.resolve(request.joint_names, columns)) {
+        response.message = "Unknown or repeated joint names.";
+        return true;
+    }
+
+    if (!assignValues(request.max_velocities, columns, "max_velocities", limits.max_velocities, error) ||
+            !assignValues(request.max_accelerations, columns, "max_accelerations", limits.max_accelerations, error) ||
+            !assignValues(request.max_jerks, columns, "max_jerks", limits.max_jerks, error) ||
+            !assignValues(request.position_tolerances, columns, "position_tolerances", limits.position_tolerances,
+                          error)) {
+        response.message = error.str();
+        return true;
+    }
+
+    if (request.speed_scaling < 0.0 || request.speed_scaling > 1.0) {
+        response.message = "The speed_scaling must be in (0, 1].";
+        return true;
+    }
+
+    if (request.speed_scaling > 0.0) {
+        limits.speed_scaling = request.speed_scaling;
+    }
+
+    if (request.command_update_tolerance >= 0.0) {
+        limits.command_update_tolerance = request.command_update_tolerance;
+    }
+
+    // Let Reflexxes check the scaled limits
+    limits.apply(*check_);
+
+    if (!check_->CheckForValidity()) {
+        current_.apply(*check_);
+        response.message = "The limits are not valid for Reflexxes.";
+        return true;
+    }
+
+    current_ = limits;
+
+    if (update_) {
+        update_(limits);
+    }
+
+    mailbox_.writeBuffer() = limits;
+    mailbox_.publish();
+
+    ROS_INFO("Changed the limits (speed scaling: %f).", limits.speed_scaling);
+
+    response.success = true;
+    return true;
+}
+
+} // namespace
@@ -0,0 +1,182 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/plan_preview_publisher.h>
+
+#include <algorithm>
+
+#include <ros/console.h>
+
+namespace reflexxes_controllers_common {
+
+void PlannedMotion::resize(size_t n_joints, size_t max_waypoints) {
+    current_positions.resize(n_joints);
+    current_velocities.resize(n_joints);
+    current_accelerations.resize(n_joints);
+    target_positions.resize(n_joints);
+    target_velocities.resize(n_joints);
+    max_velocities.resize(n_joints);
+    max_accelerations.resize(n_joints);
+    max_jerks.resize(n_joints);
+    selection.resize(n_joints);
+
+    // Keep one element, waypointTimes() points into it
+    waypoint_times.resize(std::max<size_t>(max_waypoints, 1));
+    n_waypoints = 0;
+}
+
+PlanPreviewPublisher::PlanPreviewPublisher()
+    : enabled_(false),
+      n_joints_(0),
+      n_samples_(20),
+      max_waypoints_(64)
+{}
+
+bool PlanPreviewPublisher::init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names,
+                                double sampling_resolution) {
+    timer_.stop();
+    enabled_ = false;
+
+    ros::NodeHandle preview_nh(nh, "preview");
+    bool enabled;
+    preview_nh.param("enabled", enabled, false);
+
+    if (!enabled) {
+        return true;
+    }
+
+    double rate;
+    int n_samples, max_waypoints;
+    preview_nh.param("rate", rate, 20.0);
+    preview_nh.param("samples", n_samples, 20);
+    preview_nh.param("max_waypoints", max_waypoints, 64);
+
+    if (rate <= 0.0 || n_samples < 2 || max_waypoints < 0) {
+        ROS_ERROR("The 'preview/rate' parameter must be positive, 'preview/samples' at least 2 and "
+                  "'preview/max_waypoints' not negative (namespace '%s')", nh.getNamespace().c_str());
+        return false;
+    }
+
+    n_joints_ = joint_names.size();
+    n_samples_ = n_samples;
+    max_waypoints_ = max_waypoints;
+
+    // Create trajectory generator
+    rml_.reset(new ReflexxesAPI(n_joints_, sampling_resolution));
+    rml_in_.reset(new RMLPositionInputParameters(n_joints_));
+    rml_out_.reset(new RMLPositionOutputParameters(n_joints_));
+    rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = RMLPositionFlags::RECOMPUTE_TRAJECTORY;
+
+    // Preallocate the buffers shared with the realtime loop
+    PlannedMotion motion;
+    motion.resize(n_joints_, max_waypoints_);
+    motion_mailbox_.init(motion);
+
+    preview_.joint_names = joint_names;
+    preview_.sample_times.resize(n_samples_);
+    preview_.positions.resize(n_samples_ * n_joints_);
+    preview_.waypoint_times.reserve(max_waypoints_ + 1);
+
+    publisher_ = nh.advertise<reflexxes_controllers_msgs::PlanPreview>("plan_preview", 1, true);
+    timer_ = nh.createTimer(ros::Duration(1.0 / rate), &PlanPreviewPublisher::update, this);
+    enabled_ = true;
+
+    return true;
+}
+
+void PlanPreviewPublisher::planned(const ros::Time &start, const RMLPositionInputParameters &rml_in,
+                                   const RMLPositionFlags &flags, size_t n_waypoints) {
+    PlannedMotion &motion = motion_mailbox_.writeBuffer();
+    motion.start = start;
+    motion.minimum_synchronization_time = rml_in.GetMinimumSynchronizationTime();
+    motion.synchronization_behavior = flags.SynchronizationBehavior;
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        motion.current_positions[i] = rml_in.CurrentPositionVector->VecData[i];
+        motion.current_velocities[i] = rml_in.CurrentVelocityVector->VecData[i];
+        motion.current_accelerations[i] = rml_in.CurrentAccelerationVector->VecData[i];
+        motion.target_positions[i] = rml_in.TargetPositionVector->VecData[i];
+        motion.target_velocities[i] = rml_in.TargetVelocityVector->VecData[i];
+        motion.max_velocities[i] = rml_in.MaxVelocityVector->VecData[i];
+        motion.max_accelerations[i] = rml_in.MaxAccelerationVector->VecData[i];
+        motion.max_jerks[i] = rml_in.MaxJerkVector->VecData[i];
+        motion.selection[i] = rml_in.SelectionVector->VecData[i];
+    }
+
+    motion.n_waypoints = std::min(n_waypoints, max_waypoints_);
+    motion_mailbox_.publish();
+}
+
+void PlanPreviewPublisher::update(const ros::TimerEvent &) {
+    if (!motion_mailbox_.fetch()) {
+        return;
+    }
+
+    const PlannedMotion &motion = motion_mailbox_.readBuffer();
+
+    // Plan again from the copied input
+    for (size_t i = 0; i < n_joints_; i++) {
+        rml_in_->CurrentPositionVector->VecData[i] = motion.current_positions[i];
+        rml_in_->CurrentVelocityVector->VecData[i] = motion.current_velocities[i];
+        rml_in_->CurrentAccelerationVector->VecData[i] = motion.current_accelerations[i];
+        rml_in_->TargetPositionVector->VecData[i] = motion.target_positions[i];
+        rml_in_->TargetVelocityVector->VecData[i] = motion.target_velocities[i];
+        rml_in_->MaxVelocityVector->VecData[i] = motion.max_velocities[i];
+        rml_in_->MaxAccelerationVector->VecData[i] = motion.max_accelerations[i];
+        rml_in_->MaxJerkVector->VecData[i] = motion.max_jerks[i];
+        rml_in_->SelectionVector->VecData[i] = motion.selection[i];
+    }
+
+    rml_in_->SetMinimumSynchronizationTime(motion.minimum_synchronization_time);
+    rml_flags_.SynchronizationBehavior = motion.synchronization_behavior;
+
+    if (rml_->RMLPosition(*rml_in_, rml_out_.get(), rml_flags_) < 0) {
+        ROS_WARN_THROTTLE(1.0, "Could not compute the preview of the plan started at %f.", motion.start.toSec());
+        return;
+    }
+
+    double synchronization_time = rml_out_->GetSynchronizationTime();
+
+    // Sample the positions towards the target, the last sample is at the target
+    for (size_t k = 0; k < n_samples_; k++) {
+        double time_from_start = synchronization_time * k / (n_samples_ - 1);
+
+        if (rml_->RMLPositionAtAGivenSampleTime(time_from_start, rml_out_.get()) < 0) {
+            ROS_WARN_THROTTLE(1.0, "Could not sample the preview of the plan started at %f.", motion.start.toSec());
+            return;
+        }
+
+        preview_.sample_times[k] = time_from_start;
+        std::copy(rml_out_->NewPositionVector->VecData, rml_out_->NewPositionVector->VecData + n_joints_,
+                  preview_.positions.begin() + k * n_joints_);
+    }
+
+    // Later waypoints can not be reached before their nominal time nor before the one ahead of them
+    preview_.waypoint_times.clear();
+    preview_.waypoint_times.push_back(synchronization_time);
+
+    for (size_t k = 0; k < motion.n_waypoints; k++) {
+        preview_.waypoint_times.push_back(std::max(motion.waypoint_times[k], preview_.waypoint_times.back()));
+    }
+
+    preview_.header.stamp = motion.start;
+    preview_.duration = preview_.waypoint_times.back();
+    publisher_.publish(preview_);
+}
+
+} // namespace
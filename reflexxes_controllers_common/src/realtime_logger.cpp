@@ -0,0 +1,223 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/realtime_logger.h>
+
+#include <cstdio>
+
+namespace reflexxes_controllers_common {
+
+//! Period of the drain thread in milliseconds
+static const int DRAIN_PERIOD_MS = 10;
+
+//! Default level of each event code
+static const ros::console::levels::Level EVENT_LEVELS[EVENT_CODE_COUNT] = {
+    ros::console::levels::Debug,    // EVENT_NEW_REFERENCE
+    ros::console::levels::Debug,    // EVENT_RML_RECOMPUTE
+    ros::console::levels::Debug,    // EVENT_RML_FINAL_STATE_REACHED
+    ros::console::levels::Error,    // EVENT_RML_ERROR
+    ros::console::levels::Warn,     // EVENT_TRACKING_ERROR
+    ros::console::levels::Warn,     // EVENT_LEAVING_PRECOMPUTED
+    ros::console::levels::Info,     // EVENT_LIMITS_CHANGED
+    ros::console::levels::Debug,    // EVENT_RML_INPUT
+    ros::console::levels::Debug,    // EVENT_RML_INPUT_CURRENT
+    ros::console::levels::Debug,    // EVENT_RML_INPUT_TARGET
+    ros::console::levels::Debug     // EVENT_RML_INPUT_LIMITS
+};
+
+RealtimeLogger::RealtimeLogger()
+    : throttle_period_(1.0),
+      shutdown_(false)
+{}
+
+RealtimeLogger::~RealtimeLogger() {
+    stop();
+}
+
+void RealtimeLogger::init(const std::string &name, size_t capacity, double throttle_period) {
+    stop();
+
+    name_ = name;
+    throttle_period_ = ros::Duration(throttle_period);
+    throttles_.clear();
+    ring_.init(capacity);
+
+    shutdown_.store(false);
+    thread_ = boost::thread(&RealtimeLogger::worker, this);
+}
+
+void RealtimeLogger::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    shutdown_.store(true);
+    thread_.join();
+}
+
+void RealtimeLogger::log(RealtimeEventCode code, const ros::Time &stamp, int joint,
+                         double v0, double v1, double v2, double v3) {
+    log(EVENT_LEVELS[code], code, stamp, joint, v0, v1, v2, v3);
+}
+
+void RealtimeLogger::log(ros::console::levels::Level level, RealtimeEventCode code, const ros::Time &stamp,
+                         int joint, double v0, double v1, double v2, double v3) {
+    RealtimeEvent event;
+    event.code = code;
+    event.level = level;
+    event.joint = joint;
+    event.values[0] = v0;
+    event.values[1] = v1;
+    event.values[2] = v2;
+    event.values[3] = v3;
+    event.stamp = stamp;
+
+    ring_.push(event);
+}
+
+void RealtimeLogger::logRMLInput(ros::console::levels::Level level, const RMLPositionInputParameters &rml_in,
+                                 const ros::Time &stamp) {
+    log(level, EVENT_RML_INPUT, stamp, -1, rml_in.NumberOfDOFs, rml_in.MinimumSynchronizationTime);
+
+    for (int i = 0; i < static_cast<int>(rml_in.NumberOfDOFs); i++) {
+        log(level, EVENT_RML_INPUT_CURRENT, stamp, i,
+            rml_in.SelectionVector->VecData[i],
+            rml_in.CurrentPositionVector->VecData[i],
+            rml_in.CurrentVelocityVector->VecData[i],
+            rml_in.CurrentAccelerationVector->VecData[i]);
+        log(level, EVENT_RML_INPUT_TARGET, stamp, i,
+            rml_in.TargetPositionVector->VecData[i],
+            rml_in.TargetVelocityVector->VecData[i],
+            rml_in.AlternativeTargetVelocityVector->VecData[i]);
+        log(level, EVENT_RML_INPUT_LIMITS, stamp, i,
+            rml_in.MaxVelocityVector->VecData[i],
+            rml_in.MaxAccelerationVector->VecData[i],
+            rml_in.MaxJerkVector->VecData[i]);
+    }
+}
+
+void RealtimeLogger::worker() {
+    while (!shutdown_.load()) {
+        drain();
+        boost::this_thread::sleep(boost::posix_time::milliseconds(DRAIN_PERIOD_MS));
+    }
+
+    // Print whatever was recorded before stopping
+    drain();
+}
+
+void RealtimeLogger::drain() {
+    RealtimeEvent event;
+
+    while (ring_.pop(event)) {
+        Throttle &throttle = throttles_[std::make_pair(event.code, event.joint)];
+
+        // Events from a restarted controller may go back in time
+        if (throttle.printed && event.stamp >= throttle.last_printed &&
+                event.stamp - throttle.last_printed < throttle_period_) {
+            throttle.suppressed++;
+            continue;
+        }
+
+        print(event);
+
+        if (throttle.suppressed > 0) {
+            ROS_LOG(static_cast<ros::console::levels::Level>(event.level), ROSCONSOLE_DEFAULT_NAME,
+                    "[%s] (%u similar messages suppressed)", name_.c_str(), throttle.suppressed);
+        }
+
+        throttle.printed = true;
+        throttle.last_printed = event.stamp;
+        throttle.suppressed = 0;
+    }
+
+    size_t dropped = ring_.takeDropped();
+
+    if (dropped > 0) {
+        ROS_WARN("[%s] Realtime log ring full, %zu events dropped.", name_.c_str(), dropped);
+    }
+}
+
+void RealtimeLogger::print(const RealtimeEvent &event) {
+    const ros::console::levels::Level level = static_cast<ros::console::levels::Level>(event.level);
+    const double *v = event.values;
+    char message[256];
+
+    switch (event.code) {
+    case EVENT_NEW_REFERENCE:
+        snprintf(message, sizeof(message), "Received new reference.");
+        break;
+
+    case EVENT_RML_RECOMPUTE:
+        snprintf(message, sizeof(message), "RML Recomputing trajectory... (synchronization time: %f)", v[0]);
+        break;
+
+    case EVENT_RML_FINAL_STATE_REACHED:
+        snprintf(message, sizeof(message), "final state reached");
+        break;
+
+    case EVENT_RML_ERROR:
+        snprintf(message, sizeof(message), "Reflexxes error code: %d.",
+                 static_cast<int>(v[0]));
+        break;
+
+    case EVENT_TRACKING_ERROR:
+        snprintf(message, sizeof(message), "Tracking for joint %d outside of tolerance! (%f > %f)",
+                 event.joint, v[0], v[1]);
+        break;
+
+    case EVENT_LEAVING_PRECOMPUTED:
+        snprintf(message, sizeof(message), "Leaving precomputed trajectory, planning online.");
+        break;
+
+    case EVENT_LIMITS_CHANGED:
+        snprintf(message, sizeof(message), "Switched to new limits (speed scaling: %f).", v[0]);
+        break;
+
+    case EVENT_RML_INPUT:
+        snprintf(message, sizeof(message), "RML INPUT NumberOfDOFs: %d MinimumSynchronizationTime: %f",
+                 static_cast<int>(v[0]), v[1]);
+        break;
+
+    case EVENT_RML_INPUT_CURRENT:
+        snprintf(message, sizeof(message),
+                 "RML INPUT joint %d: Selection: %d CurrentPosition: %f CurrentVelocity: %f CurrentAcceleration: %f",
+                 event.joint, static_cast<int>(v[0]), v[1], v[2], v[3]);
+        break;
+
+    case EVENT_RML_INPUT_TARGET:
+        snprintf(message, sizeof(message),
+                 "RML INPUT joint %d: TargetPosition: %f TargetVelocity: %f AlternativeTargetVelocity: %f",
+                 event.joint, v[0], v[1], v[2]);
+        break;
+
+    case EVENT_RML_INPUT_LIMITS:
+        snprintf(message, sizeof(message),
+                 "RML INPUT joint %d: MaxVelocity: %f MaxAcceleration: %f MaxJerk: %f",
+                 event.joint, v[0], v[1], v[2]);
+        break;
+
+    default:
+        snprintf(message, sizeof(message), "Unknown event %d (joint %d)", event.code, event.joint);
+        break;
+    }
+
+    ROS_LOG(level, ROSCONSOLE_DEFAULT_NAME, "[%s] %s", name_.c_str(), message);
+}
+
+} // namespace
@@ -0,0 +1,129 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/robot_model_cache.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/functional/hash.hpp>
+
+#include <ros/console.h>
+#include <kdl_parser/kdl_parser.hpp>
+
+namespace reflexxes_controllers_common {
+
+boost::mutex RobotModelCache::mutex_;
+std::multimap<size_t, RobotModelConstPtr> RobotModelCache::models_;
+
+bool RobotModel::init(const std::string &description) {
+    description_ = description;
+
+    if (!urdf_.initString(description)) {
+        ROS_ERROR("Failed to parse the robot description.");
+        return false;
+    }
+
+    if (!kdl_parser::treeFromUrdfModel(urdf_, tree_)) {
+        ROS_ERROR("Failed to build a KDL tree from the robot description.");
+        return false;
+    }
+
+    return true;
+}
+
+KinematicChainConstPtr RobotModel::chain(const std::string &root, const std::string &tip) const {
+    boost::lock_guard<boost::mutex> lock(chains_mutex_);
+    std::pair<std::string, std::string> key(root, tip);
+
+    std::map<std::pair<std::string, std::string>, KinematicChainConstPtr>::const_iterator cached = chains_.find(key);
+
+    if (cached != chains_.end()) {
+        return cached->second;
+    }
+
+    boost::shared_ptr<KinematicChain> chain(new KinematicChain);
+
+    if (!tree_.getChain(root, tip, chain->chain)) {
+        ROS_ERROR("No kinematic chain from '%s' to '%s' in the robot description.", root.c_str(), tip.c_str());
+        return KinematicChainConstPtr();
+    }
+
+    // Joint limits as read by trac_ik, continuous joints are unbounded
+    unsigned int n_joints = chain->chain.getNrOfJoints();
+    chain->lower_limits.resize(n_joints);
+    chain->upper_limits.resize(n_joints);
+
+    unsigned int j = 0;
+
+    for (unsigned int s = 0; s < chain->chain.getNrOfSegments(); s++) {
+        const KDL::Joint &kdl_joint = chain->chain.getSegment(s).getJoint();
+
+        if (kdl_joint.getType() == KDL::Joint::None) {
+            continue;
+        }
+
+        urdf::JointConstSharedPtr joint = urdf_.getJoint(kdl_joint.getName());
+        double lower = std::numeric_limits<float>::lowest();
+        double upper = std::numeric_limits<float>::max();
+
+        if (joint && joint->type != urdf::Joint::CONTINUOUS && joint->limits) {
+            lower = joint->limits->lower;
+            upper = joint->limits->upper;
+
+            if (joint->safety) {
+                lower = std::max(lower, joint->safety->soft_lower_limit);
+                upper = std::min(upper, joint->safety->soft_upper_limit);
+            }
+        }
+
+        chain->lower_limits(j) = lower;
+        chain->upper_limits(j) = upper;
+        j++;
+    }
+
+    chains_[key] = chain;
+    return chain;
+}
+
+RobotModelConstPtr RobotModelCache::get(const std::string &description) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    size_t hash = boost::hash<std::string>()(description);
+
+    // Equal hashes are confirmed on the whole description
+    typedef std::multimap<size_t, RobotModelConstPtr>::const_iterator Iterator;
+    std::pair<Iterator, Iterator> range = models_.equal_range(hash);
+
+    for (Iterator model = range.first; model != range.second; ++model) {
+        if (model->second->description_ == description) {
+            return model->second;
+        }
+    }
+
+    boost::shared_ptr<RobotModel> model(new RobotModel);
+
+    if (!model->init(description)) {
+        return RobotModelConstPtr();
+    }
+
+    ROS_INFO("Parsed robot description '%s' (%zu cached).", model->urdf().name_.c_str(), models_.size() + 1);
+    models_.insert(std::make_pair(hash, model));
+    return model;
+}
+
+} // namespace
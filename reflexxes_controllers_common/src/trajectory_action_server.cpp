@@ -0,0 +1,303 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/trajectory_action_server.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
+namespace reflexxes_controllers_common {
+
+TrajectoryActionServer::TrajectoryActionServer()
+    : has_goal_(false),
+      goal_started_(false),
+      goal_id_(0),
+      next_goal_id_(1),
+      active_id_(0),
+      finished_id_(0),
+      aborted_id_(0)
+{}
+
+void TrajectoryActionServer::init(ros::NodeHandle &nh, const std::vector<std::string> &joint_names,
+                                  const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints,
+                                  const std::vector<double> &max_velocities, const ros::Duration &feedback_period,
+                                  const CommandFunction &command, const HoldFunction &hold) {
+    joint_names_ = joint_names;
+    joint_name_map_.init(joint_names);
+    urdf_joints_ = urdf_joints;
+    max_velocities_ = max_velocities;
+    command_ = command;
+    hold_ = hold;
+
+    // Preallocate the feedback
+    control_msgs::FollowJointTrajectoryFeedback feedback;
+    feedback.joint_names = joint_names;
+    feedback.desired.positions.resize(joint_names.size());
+    feedback.desired.velocities.resize(joint_names.size());
+    feedback.desired.accelerations.resize(joint_names.size());
+    feedback.actual.positions.resize(joint_names.size());
+    feedback.actual.velocities.resize(joint_names.size());
+    feedback.error.positions.resize(joint_names.size());
+    feedback.error.velocities.resize(joint_names.size());
+    feedback_mailbox_.init(feedback);
+
+    action_server_.reset(new ActionServer(nh, "follow_joint_trajectory",
+                                          boost::bind(&TrajectoryActionServer::goalCB, this, _1),
+                                          boost::bind(&TrajectoryActionServer::cancelCB, this, _1),
+                                          false));
+    action_server_->start();
+
+    timer_ = nh.createTimer(feedback_period, &TrajectoryActionServer::update, this);
+}
+
+bool TrajectoryActionServer::validate(const control_msgs::FollowJointTrajectoryGoal &goal,
+                                      trajectory_msgs::JointTrajectory &trajectory,
+                                      control_msgs::FollowJointTrajectoryResult &result) const {
+    const trajectory_msgs::JointTrajectory &commanded = goal.trajectory;
+    size_t n_joints = joint_names_.size();
+    std::ostringstream error;
+
+    boost::lock_guard<boost::mutex> lock(limits_mutex_);
+
+    // Map the goal joints to the controller joints, joints left out are held by the controller
+    std::vector<int> mapping;
+    std::vector<size_t> joints;
+
+    if (!joint_name_map_.resolve(commanded.joint_names, mapping)) {
+        error << "The goal commands unknown or repeated joints.";
+        result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_JOINTS;
+        result.error_string = error.str();
+        return false;
+    }
+
+    for (size_t i = 0; i < n_joints; i++) {
+        if (mapping[i] >= 0) {
+            joints.push_back(i);
+        }
+    }
+
+    if (joints.empty()) {
+        error << "The goal commands none of the " << n_joints << " controller joints.";
+        result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_JOINTS;
+        result.error_string = error.str();
+        return false;
+    }
+
+    // Reorder the commanded joints into the controller order and check the points
+    size_t n_commanded = joints.size();
+    trajectory.header = commanded.header;
+    trajectory.joint_names.resize(n_commanded);
+
+    for (size_t c = 0; c < n_commanded; c++) {
+        trajectory.joint_names[c] = joint_names_[joints[c]];
+    }
+
+    trajectory.points.resize(commanded.points.size());
+    result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+
+    for (size_t k = 0; k < commanded.points.size(); k++) {
+        const trajectory_msgs::JointTrajectoryPoint &in = commanded.points[k];
+        trajectory_msgs::JointTrajectoryPoint &out = trajectory.points[k];
+
+        if (in.positions.size() != n_commanded ||
+                (!in.velocities.empty() && in.velocities.size() != n_commanded) ||
+                (!in.accelerations.empty() && in.accelerations.size() != n_commanded)) {
+            error << "Point " << k << " does not have " << n_commanded << " joints.";
+            result.error_string = error.str();
+            return false;
+        }
+
+        if (in.time_from_start.toSec() < 0 ||
+                (k > 0 && in.time_from_start <= commanded.points[k - 1].time_from_start)) {
+            error << "The times from start are not increasing at point " << k << ".";
+            result.error_string = error.str();
+            return false;
+        }
+
+        out.positions.resize(n_commanded);
+        out.velocities.resize(in.velocities.size());
+        out.accelerations.resize(in.accelerations.size());
+        out.time_from_start = in.time_from_start;
+
+        for (size_t c = 0; c < n_commanded; c++) {
+            size_t i = joints[c];
+            out.positions[c] = in.positions[mapping[i]];
+
+            const boost::shared_ptr<const urdf::Joint> &urdf_joint = urdf_joints_[i];
+            bool bounded = urdf_joint && urdf_joint->limits && urdf_joint->type != urdf::Joint::CONTINUOUS;
+
+            if (bounded && (out.positions[c] < urdf_joint->limits->lower || out.positions[c] > urdf_joint->limits->upper)) {
+                error << "Point " << k << " exceeds the position limits of joint " << joint_names_[i] << ".";
+                result.error_string = error.str();
+                return false;
+            }
+
+            if (!in.velocities.empty()) {
+                out.velocities[c] = in.velocities[mapping[i]];
+
+                if (std::abs(out.velocities[c]) > max_velocities_[i]) {
+                    error << "Point " << k << " exceeds the max_velocity of joint " << joint_names_[i] << ".";
+                    result.error_string = error.str();
+                    return false;
+                }
+            }
+
+            if (!in.accelerations.empty()) {
+                out.accelerations[c] = in.accelerations[mapping[i]];
+            }
+        }
+    }
+
+    // Reject trajectories which are over already
+    if (!commanded.header.stamp.isZero() && !commanded.points.empty() &&
+            commanded.header.stamp + commanded.points.back().time_from_start < ros::Time::now()) {
+        result.error_code = control_msgs::FollowJointTrajectoryResult::OLD_HEADER_TIMESTAMP;
+        result.error_string = "The goal ends in the past.";
+        return false;
+    }
+
+    result.error_code = control_msgs::FollowJointTrajectoryResult::SUCCESSFUL;
+    return true;
+}
+
+void TrajectoryActionServer::goalCB(GoalHandle gh) {
+    const control_msgs::FollowJointTrajectoryGoal &goal = *gh.getGoal();
+    control_msgs::FollowJointTrajectoryResult result;
+    trajectory_msgs::JointTrajectoryPtr trajectory(new trajectory_msgs::JointTrajectory);
+
+    if (!validate(goal, *trajectory, result)) {
+        ROS_ERROR("Rejected trajectory goal: %s", result.error_string.c_str());
+        gh.setRejected(result, result.error_string);
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    // Id 0 marks trajectories commanded without a goal
+    uint32_t id = next_goal_id_++;
+
+    if (next_goal_id_ == 0) {
+        next_goal_id_ = 1;
+    }
+
+    // The controller may stretch the trajectory to its limits
+    ros::Duration trajectory_duration;
+
+    if (!command_(trajectory, id, &trajectory_duration)) {
+        result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+        result.error_string = "The controller rejected the trajectory.";
+        gh.setRejected(result, result.error_string);
+        return;
+    }
+
+    // The new goal replaces the active one
+    if (has_goal_) {
+        goal_.setCanceled(control_msgs::FollowJointTrajectoryResult(), "Replaced by a new goal.");
+    }
+
+    goal_ = gh;
+    goal_id_ = id;
+    has_goal_ = true;
+    goal_started_ = false;
+    goal_deadline_ = ros::Time();
+
+    // Precompute when the goal has to be finished
+    double duration = trajectory_duration.toSec();
+
+    if (goal.goal_time_tolerance.toSec() > 0) {
+        ros::Time start = trajectory->header.stamp.isZero() ? ros::Time::now() : trajectory->header.stamp;
+        goal_deadline_ = start + ros::Duration(duration) + goal.goal_time_tolerance;
+    }
+
+    gh.setAccepted();
+    ROS_DEBUG("Accepted trajectory goal %u lasting %f seconds.", id, duration);
+}
+
+void TrajectoryActionServer::cancelCB(GoalHandle gh) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (has_goal_ && gh == goal_) {
+        hold_();
+        goal_.setCanceled();
+        has_goal_ = false;
+    }
+}
+
+void TrajectoryActionServer::preempt() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (has_goal_) {
+        goal_.setCanceled(control_msgs::FollowJointTrajectoryResult(), "Replaced by a trajectory command.");
+        has_goal_ = false;
+    }
+}
+
+void TrajectoryActionServer::update(const ros::TimerEvent &event) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    bool new_feedback = feedback_mailbox_.fetch();
+
+    if (!has_goal_) {
+        return;
+    }
+
+    control_msgs::FollowJointTrajectoryResult result;
+
+    if (aborted_id_.load(boost::memory_order_relaxed) == goal_id_) {
+        result.error_code = control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED;
+        result.error_string = "Reflexxes could not plan the trajectory.";
+        goal_.setAborted(result, result.error_string);
+        has_goal_ = false;
+        return;
+    }
+
+    if (finished_id_.load(boost::memory_order_relaxed) == goal_id_) {
+        result.error_code = control_msgs::FollowJointTrajectoryResult::SUCCESSFUL;
+        goal_.setSucceeded(result);
+        has_goal_ = false;
+        return;
+    }
+
+    if (active_id_.load(boost::memory_order_relaxed) == goal_id_) {
+        goal_started_ = true;
+    } else if (goal_started_) {
+        result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+        result.error_string = "The controller stopped following the trajectory.";
+        goal_.setAborted(result, result.error_string);
+        has_goal_ = false;
+        return;
+    }
+
+    if (!goal_deadline_.isZero() && ros::Time::now() > goal_deadline_) {
+        hold_();
+        result.error_code = control_msgs::FollowJointTrajectoryResult::GOAL_TOLERANCE_VIOLATED;
+        result.error_string = "The trajectory was not finished within the goal time tolerance.";
+        goal_.setAborted(result, result.error_string);
+        has_goal_ = false;
+        return;
+    }
+
+    if (new_feedback && goal_started_) {
+        goal_.publishFeedback(feedback_mailbox_.readBuffer());
+    }
+}
+
+} // namespace
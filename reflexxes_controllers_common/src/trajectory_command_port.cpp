@@ -0,0 +1,115 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/trajectory_command_port.h>
+
+#include <boost/thread/lock_guard.hpp>
+
+#include <ros/console.h>
+
+namespace reflexxes_controllers_common {
+
+boost::mutex TrajectoryCommandPort::registry_mutex_;
+std::map<std::string, boost::weak_ptr<TrajectoryCommandPort> > TrajectoryCommandPort::registry_;
+
+TrajectoryCommandPortPtr TrajectoryCommandPort::find(const std::string &controller_namespace) {
+    boost::lock_guard<boost::mutex> lock(registry_mutex_);
+    std::map<std::string, boost::weak_ptr<TrajectoryCommandPort> >::const_iterator entry =
+        registry_.find(controller_namespace);
+
+    if (entry == registry_.end()) {
+        return TrajectoryCommandPortPtr();
+    }
+
+    return entry->second.lock();
+}
+
+TrajectoryCommandPortPtr TrajectoryCommandPort::advertise(const std::string &controller_namespace,
+                                                          const std::vector<std::string> &joint_names,
+                                                          TrajectoryCommandBuffer &buffer,
+                                                          const MessageFunction &command_message,
+                                                          const TrajectoryFunction &command_trajectory) {
+    TrajectoryCommandPortPtr port(new TrajectoryCommandPort);
+    port->namespace_ = controller_namespace;
+    port->joint_names_ = joint_names;
+    port->buffer_ = &buffer;
+    port->command_message_ = command_message;
+    port->command_trajectory_ = command_trajectory;
+
+    // A reloaded controller replaces the port of its predecessor
+    boost::lock_guard<boost::mutex> lock(registry_mutex_);
+    registry_[controller_namespace] = port;
+    return port;
+}
+
+void TrajectoryCommandPort::shutdown() {
+    {
+        boost::lock_guard<boost::mutex> lock(registry_mutex_);
+        std::map<std::string, boost::weak_ptr<TrajectoryCommandPort> >::iterator entry = registry_.find(namespace_);
+
+        if (entry != registry_.end() && entry->second.lock().get() == this) {
+            registry_.erase(entry);
+        }
+    }
+
+    // Waits for commands in progress
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    buffer_ = NULL;
+}
+
+bool TrajectoryCommandPort::connected() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return buffer_ != NULL;
+}
+
+bool TrajectoryCommandPort::command(const trajectory_msgs::JointTrajectoryConstPtr &msg) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (!buffer_) {
+        ROS_ERROR("Controller %s is gone, trajectory command rejected.", namespace_.c_str());
+        return false;
+    }
+
+    return command_message_(msg);
+}
+
+FixedTrajectory *TrajectoryCommandPort::acquire() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return buffer_ ? buffer_->acquire() : NULL;
+}
+
+bool TrajectoryCommandPort::command(FixedTrajectory *trajectory) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (!buffer_) {
+        ROS_ERROR("Controller %s is gone, trajectory command rejected.", namespace_.c_str());
+        return false;
+    }
+
+    return command_trajectory_(trajectory);
+}
+
+void TrajectoryCommandPort::release(FixedTrajectory *trajectory) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (buffer_) {
+        buffer_->release(trajectory);
+    }
+}
+
+} // namespace
@@ -0,0 +1,278 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include <reflexxes_controllers_common/trajectory_feasibility_checker.h>
+#include <ros/console.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace reflexxes_controllers_common {
+
+TrajectoryFeasibilityChecker::TrajectoryFeasibilityChecker()
+    : segment_timing_(KEEP_SEGMENT_TIMING),
+      stretched_(false)
+{}
+
+void TrajectoryFeasibilityChecker::init(const std::vector<std::string> &joint_names,
+                                        const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints,
+                                        SegmentTiming segment_timing) {
+    size_t n_joints = joint_names.size();
+    joint_names_ = joint_names;
+    segment_timing_ = segment_timing;
+    lower_limits_.assign(n_joints, -std::numeric_limits<double>::infinity());
+    upper_limits_.assign(n_joints, std::numeric_limits<double>::infinity());
+    joint_durations_.resize(n_joints);
+    checked_.resize(n_joints);
+
+    for (size_t i = 0; i < n_joints; i++) {
+        const boost::shared_ptr<const urdf::Joint> &urdf_joint = urdf_joints[i];
+
+        if (urdf_joint && urdf_joint->limits && urdf_joint->type != urdf::Joint::CONTINUOUS) {
+            lower_limits_[i] = urdf_joint->limits->lower;
+            upper_limits_[i] = urdf_joint->limits->upper;
+        }
+    }
+}
+
+bool TrajectoryFeasibilityChecker::parseSegmentTiming(const std::string &name, SegmentTiming &segment_timing) {
+    if (name == "keep") {
+        segment_timing = KEEP_SEGMENT_TIMING;
+    } else if (name == "reject") {
+        segment_timing = REJECT_SHORT_SEGMENTS;
+    } else if (name == "scale") {
+        segment_timing = SCALE_SHORT_SEGMENTS;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool TrajectoryFeasibilityChecker::check(const trajectory_msgs::JointTrajectory &trajectory, const JointMask &held,
+                                         const std::vector<double> &max_velocities,
+                                         const std::vector<double> &max_accelerations,
+                                         const std::vector<double> &max_jerks, std::string &error) {
+    size_t n_joints = joint_names_.size();
+    size_t n_points = trajectory.points.size();
+
+    // Copy the points into flat arrays, missing velocities and accelerations are zero
+    positions_.resize(n_points * n_joints);
+    velocities_.assign(n_points * n_joints, 0.0);
+    accelerations_.assign(n_points * n_joints, 0.0);
+    times_.resize(n_points);
+
+    for (size_t k = 0; k < n_points; k++) {
+        const trajectory_msgs::JointTrajectoryPoint &point = trajectory.points[k];
+        std::copy(point.positions.begin(), point.positions.end(), &positions_[k * n_joints]);
+        std::copy(point.velocities.begin(), point.velocities.end(), velocities_.begin() + k * n_joints);
+        std::copy(point.accelerations.begin(), point.accelerations.end(), accelerations_.begin() + k * n_joints);
+        times_[k] = point.time_from_start.toSec();
+    }
+
+    if (n_points == 0) {
+        return checkPoints(0, NULL, NULL, NULL, held, max_velocities, max_accelerations, max_jerks, error);
+    }
+
+    return checkPoints(n_points, &positions_[0], &velocities_[0], &accelerations_[0], held,
+                       max_velocities, max_accelerations, max_jerks, error);
+}
+
+bool TrajectoryFeasibilityChecker::check(const FixedTrajectory &trajectory,
+                                         const std::vector<double> &max_velocities,
+                                         const std::vector<double> &max_accelerations,
+                                         const std::vector<double> &max_jerks, std::string &error) {
+    size_t n_joints = joint_names_.size();
+    size_t n_points = trajectory.size();
+
+    if (trajectory.joints() != n_joints) {
+        error = "The trajectory does not have the joints of the controller.";
+        return false;
+    }
+
+    // Only the times are copied, the points are checked where they are
+    times_.resize(n_points);
+    held_.resize(n_joints);
+
+    for (size_t k = 0; k < n_points; k++) {
+        times_[k] = trajectory.timeFromStart(k).toSec();
+    }
+
+    for (size_t i = 0; i < n_joints; i++) {
+        held_[i] = trajectory.held(i);
+    }
+
+    if (n_points == 0) {
+        return checkPoints(0, NULL, NULL, NULL, held_, max_velocities, max_accelerations, max_jerks, error);
+    }
+
+    return checkPoints(n_points, trajectory.positions(0), trajectory.velocities(0), trajectory.accelerations(0),
+                       held_, max_velocities, max_accelerations, max_jerks, error);
+}
+
+bool TrajectoryFeasibilityChecker::checkPoints(size_t n_points, const double *positions, const double *velocities,
+                                               const double *accelerations, const JointMask &held,
+                                               const std::vector<double> &max_velocities,
+                                               const std::vector<double> &max_accelerations,
+                                               const std::vector<double> &max_jerks, std::string &error) {
+    size_t n_joints = joint_names_.size();
+    std::ostringstream message;
+
+    minimum_durations_.assign(n_points, 0.0);
+    delays_.assign(n_points, 0.0);
+    stretched_ = false;
+
+    for (size_t k = 0; k < n_points; k++) {
+        if (times_[k] < 0 || (k > 0 && times_[k] < times_[k - 1])) {
+            message << "The times from start decrease at point " << k << ".";
+            error = message.str();
+            return false;
+        }
+    }
+
+    // Held joints take their position at execution time, they are not checked
+    for (size_t i = 0; i < n_joints; i++) {
+        checked_[i] = !(i < held.size() && held[i]);
+    }
+
+    // Point limits, checked over all points at once and only searched for the message on failure
+    bool valid = true;
+
+    for (size_t k = 0; k < n_points; k++) {
+        const double *p = &positions[k * n_joints];
+        const double *v = &velocities[k * n_joints];
+        const double *a = &accelerations[k * n_joints];
+
+        for (size_t i = 0; i < n_joints; i++) {
+            valid &= !checked_[i] || (p[i] >= lower_limits_[i] && p[i] <= upper_limits_[i] &&
+                                      std::abs(v[i]) <= max_velocities[i] && std::abs(a[i]) <= max_accelerations[i]);
+        }
+    }
+
+    if (!valid) {
+        for (size_t k = 0; k < n_points; k++) {
+            for (size_t i = 0; i < n_joints; i++) {
+                size_t j = k * n_joints + i;
+
+                if (!checked_[i]) {
+                    continue;
+                } else if (!(positions[j] >= lower_limits_[i] && positions[j] <= upper_limits_[i])) {
+                    message << "Point " << k << " exceeds the position limits of joint " << joint_names_[i] << ".";
+                } else if (!(std::abs(velocities[j]) <= max_velocities[i])) {
+                    message << "Point " << k << " exceeds the max_velocity of joint " << joint_names_[i] << ".";
+                } else if (!(std::abs(accelerations[j]) <= max_accelerations[i])) {
+                    message << "Point " << k << " exceeds the max_acceleration of joint " << joint_names_[i] << ".";
+                } else {
+                    continue;
+                }
+
+                error = message.str();
+                return false;
+            }
+        }
+    }
+
+    // Minimum duration of each segment, the slowest joint decides
+    for (size_t k = 1; k < n_points; k++) {
+        const double *p0 = &positions[(k - 1) * n_joints];
+        const double *v0 = &velocities[(k - 1) * n_joints];
+        const double *a0 = &accelerations[(k - 1) * n_joints];
+        const double *p1 = &positions[k * n_joints];
+        const double *v1 = &velocities[k * n_joints];
+        const double *a1 = &accelerations[k * n_joints];
+
+        for (size_t i = 0; i < n_joints; i++) {
+            if (!checked_[i]) {
+                joint_durations_[i] = 0.0;
+                continue;
+            }
+
+            double distance = std::abs(p1[i] - p0[i]);
+            double v_max = max_velocities[i];
+            double a_max = max_accelerations[i];
+
+            // Cruise, velocity change and acceleration change bounds hold for any boundary state
+            double t = std::max(distance / v_max,
+                                std::max(std::abs(v1[i] - v0[i]) / a_max, std::abs(a1[i] - a0[i]) / max_jerks[i]));
+
+            // Rest to rest, the trapezoidal profile with its acceleration phases is exact without jerk limit
+            double t_rest = distance >= v_max * v_max / a_max ? distance / v_max + v_max / a_max :
+                            2.0 * std::sqrt(distance / a_max);
+            bool at_rest = v0[i] == 0.0 && v1[i] == 0.0;
+
+            joint_durations_[i] = at_rest ? std::max(t, t_rest) : t;
+        }
+
+        minimum_durations_[k] = n_joints > 0 ? *std::max_element(joint_durations_.begin(), joint_durations_.end()) : 0.0;
+    }
+
+    // Handle segments which are too short
+    double delay = 0.0;
+
+    for (size_t k = 1; k < n_points; k++) {
+        double duration = times_[k] - times_[k - 1];
+
+        if (duration < minimum_durations_[k]) {
+            switch (segment_timing_) {
+            case KEEP_SEGMENT_TIMING:
+                break;
+
+            case REJECT_SHORT_SEGMENTS:
+                message << "Segment " << k << " lasts " << duration << " s, it needs at least "
+                        << minimum_durations_[k] << " s within the limits.";
+                error = message.str();
+                return false;
+
+            case SCALE_SHORT_SEGMENTS:
+                delay += minimum_durations_[k] - duration;
+                break;
+            };
+        }
+
+        delays_[k] = delay;
+    }
+
+    stretched_ = delay > 0.0;
+
+    if (stretched_) {
+        ROS_DEBUG("Stretching the trajectory by %f seconds to stay within the limits.", delay);
+    }
+
+    return true;
+}
+
+void TrajectoryFeasibilityChecker::stretch(trajectory_msgs::JointTrajectory &trajectory) const {
+    for (size_t k = 0; k < trajectory.points.size() && k < delays_.size(); k++) {
+        if (delays_[k] > 0.0) {
+            trajectory.points[k].time_from_start = ros::Duration(times_[k] + delays_[k]);
+        }
+    }
+}
+
+void TrajectoryFeasibilityChecker::stretch(FixedTrajectory &trajectory) const {
+    for (size_t k = 0; k < trajectory.size() && k < delays_.size(); k++) {
+        if (delays_[k] > 0.0) {
+            trajectory.setTimeFromStart(k, ros::Duration(times_[k] + delays_[k]));
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,284 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/trajectory_precomputer.h>
+#include <ros/console.h>
+#include <cmath>
+
+namespace reflexxes_controllers_common {
+
+TrajectoryPrecomputer::TrajectoryPrecomputer()
+    : n_joints_(0),
+      sampling_resolution_(0.001),
+      pending_id_(0),
+      limits_pending_(false),
+      shutdown_(false)
+{}
+
+TrajectoryPrecomputer::~TrajectoryPrecomputer() {
+    stop();
+}
+
+bool TrajectoryPrecomputer::init(const RMLPositionInputParameters &limits, double sampling_resolution, double max_duration,
+                                 size_t max_points) {
+    if (sampling_resolution <= 0.0 || max_duration <= 0.0) {
+        ROS_ERROR("Invalid trajectory precomputation parameters (sampling resolution %f, maximum duration %f).",
+                  sampling_resolution, max_duration);
+        return false;
+    }
+
+    n_joints_ = limits.NumberOfDOFs;
+    sampling_resolution_ = sampling_resolution;
+
+    // Create trajectory generator
+    rml_.reset(new ReflexxesAPI(n_joints_, sampling_resolution_));
+    rml_in_.reset(new RMLPositionInputParameters(limits));
+    rml_out_.reset(new RMLPositionOutputParameters(n_joints_));
+
+    rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = RMLPositionFlags::RECOMPUTE_TRAJECTORY;
+    rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
+
+    // Preallocate the buffers shared with the realtime loop
+    size_t capacity = static_cast<size_t>(std::ceil(max_duration / sampling_resolution_)) + 1;
+    ROS_INFO("Preallocating %zu trajectory samples (%f seconds) for trajectory precomputation.",
+             capacity, max_duration);
+
+    validator_.resize(n_joints_, max_points);
+
+    SampledTrajectory profile;
+    profile.resize(n_joints_, capacity);
+    profile.setSamplePeriod(sampling_resolution_);
+    profile.trajectory.resize(n_joints_, max_points);
+    profile_mailbox_.init(profile);
+
+    TrajectoryState state;
+    state.resize(n_joints_);
+    start_state_mailbox_.init(state);
+
+    // Start the worker
+    stop();
+    shutdown_ = false;
+    thread_ = boost::thread(&TrajectoryPrecomputer::worker, this);
+
+    return true;
+}
+
+void TrajectoryPrecomputer::stop() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+
+    condition_.notify_one();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+bool TrajectoryPrecomputer::request(const trajectory_msgs::JointTrajectoryConstPtr &msg, uint32_t id,
+                                    const JointMask &held) {
+    if (!validator_.fits(*msg) || !validator_.fits(held)) {
+        return false;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        pending_trajectory_ = msg;
+        pending_id_ = id;
+        pending_held_ = held;
+    }
+
+    condition_.notify_one();
+    return true;
+}
+
+void TrajectoryPrecomputer::setLimits(const KinematicLimits &limits) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    pending_limits_ = limits;
+    limits_pending_ = true;
+}
+
+void TrajectoryPrecomputer::setStartState(const ros::Time &time, const double *positions, const double *velocities,
+                                          const double *accelerations) {
+    TrajectoryState &state = start_state_mailbox_.writeBuffer();
+    state.stamp = time;
+    std::copy(positions, positions + n_joints_, state.positions.begin());
+    std::copy(velocities, velocities + n_joints_, state.velocities.begin());
+    std::copy(accelerations, accelerations + n_joints_, state.accelerations.begin());
+    start_state_mailbox_.publish();
+}
+
+bool TrajectoryPrecomputer::fetch() {
+    return profile_mailbox_.fetch();
+}
+
+void TrajectoryPrecomputer::worker() {
+    trajectory_msgs::JointTrajectoryConstPtr trajectory;
+    uint32_t id = 0;
+    JointMask held;
+    KinematicLimits limits;
+    bool limits_changed = false;
+
+    while (true) {
+        // Wait for a new trajectory
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+
+            while (!pending_trajectory_ && !shutdown_)
+                condition_.wait(lock);
+
+            if (shutdown_)
+                return;
+
+            trajectory = pending_trajectory_;
+            id = pending_id_;
+            held.swap(pending_held_);
+            pending_trajectory_.reset();
+
+            limits_changed = limits_pending_;
+            limits_pending_ = false;
+
+            if (limits_changed) {
+                limits = pending_limits_;
+            }
+        }
+
+        if (limits_changed) {
+            limits.apply(*rml_in_);
+        }
+
+        // Start from the latest setpoint of the realtime loop
+        start_state_mailbox_.fetch();
+        const TrajectoryState &start = start_state_mailbox_.readBuffer();
+
+        SampledTrajectory &profile = profile_mailbox_.writeBuffer();
+        profile.trajectory.assign(*trajectory, id, held);
+        profile.setValid(compute(profile.trajectory, start, profile));
+
+        if (profile.valid()) {
+            ROS_DEBUG("Precomputed %zu trajectory samples (%f seconds).", profile.size(), profile.duration());
+        } else {
+            ROS_WARN("Could not precompute trajectory, falling back to online planning.");
+        }
+
+        // Hand the profile over to the realtime loop
+        profile_mailbox_.publish();
+        trajectory.reset();
+    }
+}
+
+bool TrajectoryPrecomputer::compute(
+    const FixedTrajectory &trajectory,
+    const TrajectoryState &start,
+    SampledTrajectory &profile) {
+    profile.clear();
+    profile.setSamplePeriod(sampling_resolution_);
+
+    // The profile starts at the header stamp, at the earliest from the start state
+    double start_offset = 0.0;
+
+    if (trajectory.stamp().isZero() || trajectory.stamp() <= start.stamp) {
+        profile.start_time = start.stamp;
+
+        if (!trajectory.stamp().isZero()) {
+            start_offset = (trajectory.stamp() - start.stamp).toSec();
+        }
+    } else {
+        profile.start_time = trajectory.stamp();
+    }
+
+    std::vector<double> current_positions(start.positions);
+    std::vector<double> current_velocities(start.velocities);
+    std::vector<double> current_accelerations(start.accelerations);
+
+    double segment_start_time = 0.0;
+    size_t sample_index = 0;
+
+    for (size_t p = 0; p < trajectory.size(); p++) {
+        const double *target_positions = trajectory.positions(p);
+        const double *target_velocities = trajectory.velocities(p);
+
+        // Plan the segment from the end of the previous one
+        for (size_t i = 0; i < n_joints_; i++) {
+            rml_in_->CurrentPositionVector->VecData[i] = current_positions[i];
+            rml_in_->CurrentVelocityVector->VecData[i] = current_velocities[i];
+            rml_in_->CurrentAccelerationVector->VecData[i] = current_accelerations[i];
+
+            if (trajectory.held(i)) {
+                rml_in_->TargetPositionVector->VecData[i] = start.positions[i];
+                rml_in_->TargetVelocityVector->VecData[i] = 0.0;
+            } else {
+                rml_in_->TargetPositionVector->VecData[i] = target_positions[i];
+                rml_in_->TargetVelocityVector->VecData[i] = target_velocities[i];
+            }
+        }
+
+        rml_in_->SetMinimumSynchronizationTime(
+            std::max(0.0, start_offset + trajectory.timeFromStart(p).toSec() - segment_start_time));
+
+        int rml_result = rml_->RMLPosition(*rml_in_, rml_out_.get(), rml_flags_);
+
+        if (rml_result < 0) {
+            ROS_ERROR("Reflexxes error code: %d while precomputing trajectory point %zu.", rml_result, p);
+            return false;
+        }
+
+        // Sample the segment on the global sampling grid
+        double segment_end_time = segment_start_time + rml_out_->GetSynchronizationTime();
+
+        for (; sample_index * sampling_resolution_ < segment_end_time; sample_index++) {
+            rml_result = rml_->RMLPositionAtAGivenSampleTime(
+                             sample_index * sampling_resolution_ - segment_start_time,
+                             rml_out_.get());
+
+            if (rml_result < 0) {
+                ROS_ERROR("Reflexxes error code: %d while sampling trajectory point %zu.", rml_result, p);
+                return false;
+            }
+
+            if (!profile.push_back(rml_out_->NewPositionVector->VecData,
+                                   rml_out_->NewVelocityVector->VecData,
+                                   rml_out_->NewAccelerationVector->VecData,
+                                   p)) {
+                ROS_ERROR("Trajectory is longer than the precomputation buffer (%zu samples).", profile.capacity());
+                return false;
+            }
+        }
+
+        // The next segment starts in the final state of this one
+        for (size_t i = 0; i < n_joints_; i++) {
+            current_positions[i] = rml_in_->TargetPositionVector->VecData[i];
+            current_velocities[i] = rml_in_->TargetVelocityVector->VecData[i];
+            current_accelerations[i] = 0.0;
+        }
+
+        segment_start_time = segment_end_time;
+    }
+
+    // Terminate the profile with the final state
+    size_t last_point = trajectory.empty() ? 0 : trajectory.size() - 1;
+
+    if (!profile.push_back(&current_positions[0], &current_velocities[0], &current_accelerations[0], last_point)) {
+        ROS_ERROR("Trajectory is longer than the precomputation buffer (%zu samples).", profile.capacity());
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
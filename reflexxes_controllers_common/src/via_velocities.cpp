@@ -0,0 +1,92 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include <reflexxes_controllers_common/via_velocities.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace reflexxes_controllers_common {
+
+//! Joint position changes regarded as no motion
+static const double POSITION_EPSILON = 1e-9;
+
+void computeViaVelocities(trajectory_msgs::JointTrajectory &trajectory, size_t lookahead,
+                          const std::vector<double> &max_velocities,
+                          const std::vector<double> &max_accelerations) {
+    std::vector<trajectory_msgs::JointTrajectoryPoint> &points = trajectory.points;
+    size_t n_points = points.size();
+    size_t n_joints = max_velocities.size();
+
+    // Malformed points are left for the command buffer to reject
+    for (size_t k = 0; k < n_points; k++) {
+        if (points[k].positions.size() != n_joints) {
+            return;
+        }
+    }
+
+    for (size_t k = 0; k < n_points; k++) {
+        if (!points[k].velocities.empty()) {
+            continue;
+        }
+
+        points[k].velocities.assign(n_joints, 0.0);
+
+        // Stop at the last point
+        if (k + 1 == n_points) {
+            continue;
+        }
+
+        double outgoing_duration = (points[k + 1].time_from_start - points[k].time_from_start).toSec();
+        double incoming_duration = k > 0 ? (points[k].time_from_start - points[k - 1].time_from_start).toSec()
+                                         : outgoing_duration;
+
+        if (outgoing_duration <= 0 || incoming_duration <= 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < n_joints; i++) {
+            double outgoing = points[k + 1].positions[i] - points[k].positions[i];
+            double incoming = k > 0 ? points[k].positions[i] - points[k - 1].positions[i] : outgoing;
+
+            // Stop where the joint does not move on or reverses
+            if (std::abs(outgoing) < POSITION_EPSILON || incoming * outgoing <= 0) {
+                continue;
+            }
+
+            double direction = outgoing > 0 ? 1.0 : -1.0;
+            double speed = std::min(std::abs(incoming) / incoming_duration, std::abs(outgoing) / outgoing_duration);
+
+            // Look for the next stop within the window and make sure the joint can brake for it
+            double distance = 0;
+
+            for (size_t j = k + 1; j < n_points && j <= k + lookahead; j++) {
+                distance += std::abs(points[j].positions[i] - points[j - 1].positions[i]);
+
+                if (j + 1 == n_points || (points[j + 1].positions[i] - points[j].positions[i]) * direction <= POSITION_EPSILON) {
+                    speed = std::min(speed, std::sqrt(2 * max_accelerations[i] * distance));
+                    break;
+                }
+            }
+
+            points[k].velocities[i] = direction * std::min(speed, max_velocities[i]);
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,307 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+/**
+  Headless benchmark of the reflexxes controllers
+
+  Every controller plugin is loaded through pluginlib and stepped against an
+  in-process fake robot, without a controller manager, a simulator or wall
+  clock time. Scripted command streams are published on the controller
+  topics and update() is called back to back with simulated time, so the
+  numbers only depend on the controllers themselves.
+
+  For every controller and number of joints it reports the update() rate,
+  the per-cycle latency percentiles and the heap allocations made by the
+  realtime thread. The 7 joint runs use the sevenbot model when it is given
+  in ~sevenbot_description, the others use a sevenbot-like serial chain.
+
+  @param ~controllers Plugin types to benchmark (default: all of them).
+  @param ~dofs Numbers of joints to benchmark (default: [1, 6, 7, 14, 32]).
+  @param ~cycles Number of measured control cycles per run (default: 20000).
+  @param ~warmup_cycles Control cycles run before measuring (default: 100).
+  @param ~sampling_resolution Simulated control period in seconds (default: 0.001).
+  @param ~rml_rate_divisor Servo cycles per trajectory generator sample of the controllers (default: 1).
+  @param ~output_file Write the results as YAML to this file (default: none).
+  @param ~max_allocations_per_cycle Fail when exceeded (default: -1, disabled).
+  @param ~min_cycles_per_second Fail when not reached (default: -1, disabled).
+  @param ~max_p99_latency Fail when the 99th percentile in seconds is exceeded (default: -1, disabled).
+
+  The process returns a non-zero exit code when a run fails or a limit is
+  violated, so it can gate performance regressions.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <reflexxes_controllers_common/cycle_timing.h>
+
+#include "controller_harness.h"
+
+namespace reflexxes_controllers_tests {
+
+struct BenchmarkOptions {
+    int cycles;
+    int warmup_cycles;
+    double sampling_resolution;
+    int rml_rate_divisor;
+    std::string sevenbot_description;
+};
+
+struct BenchmarkResult {
+    std::string type;
+    size_t n_joints;
+    int cycles;
+    double cycles_per_second;
+    double latency_p50;
+    double latency_p90;
+    double latency_p99;
+    double latency_p999;
+    double latency_max;
+    double allocations_per_cycle;
+    int allocating_cycles;
+};
+
+double percentile(const std::vector<double> &sorted, double fraction) {
+    size_t index = static_cast<size_t>(fraction * sorted.size());
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+bool runBenchmark(ControllerLoader &loader,
+                  const ControllerSpec &spec, size_t n_joints,
+                  const BenchmarkOptions &options, BenchmarkResult &result) {
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    // Robot model
+    bool sevenbot = n_joints == 7 && !options.sevenbot_description.empty();
+    std::string description = sevenbot ? options.sevenbot_description : chainDescription(n_joints);
+    nh.setParam("/robot_description", description);
+
+    std::vector<std::string> joint_names = jointNames(n_joints);
+
+    std::string root_name, tip_name;
+    KDL::Chain chain;
+    if (!kinematicChain(description, n_joints, chain, root_name, tip_name)) {
+        return false;
+    }
+
+    std::string name = std::string(spec.type);
+    std::replace(name.begin(), name.end(), '/', '_');
+    ros::NodeHandle controller_nh(pnh, name + "_" + std::to_string(n_joints) + "dof");
+    setControllerParameters(controller_nh, spec, joint_names, root_name, tip_name, options.sampling_resolution,
+                            options.rml_rate_divisor);
+
+    // The robot has to outlive the controller holding its handles
+    FakeRobot robot(joint_names);
+    boost::shared_ptr<controller_interface::ControllerBase> controller =
+        loadController(loader, spec, controller_nh, robot);
+
+    if (!controller) {
+        return false;
+    }
+
+    CommandStream commands(controller_nh, spec, joint_names, chain, root_name);
+    if (!commands.waitForController(5.0)) {
+        ROS_ERROR("%s did not subscribe to %s", spec.type, spec.topic);
+        return false;
+    }
+
+    // Simulated time
+    ros::Duration period(options.sampling_resolution);
+    ros::Time time(1.0);
+    controller->starting(time);
+
+    int total_cycles = options.warmup_cycles + options.cycles;
+    std::vector<double> latencies;
+    latencies.reserve(options.cycles);
+    size_t allocations = 0;
+    int allocating_cycles = 0;
+    double total_latency = 0.0;
+
+    for (int cycle = 0; cycle < total_cycles; cycle++) {
+        commands.update(cycle);
+
+        size_t allocations_before = allocationCount();
+        int64_t start = reflexxes_controllers_common::monotonicNanoseconds();
+        countAllocations(true);
+        controller->update(time, period);
+        countAllocations(false);
+        int64_t stop = reflexxes_controllers_common::monotonicNanoseconds();
+
+        robot.write(spec.effort, period.toSec());
+        time += period;
+
+        if (cycle < options.warmup_cycles) {
+            continue;
+        }
+
+        double latency = 1e-9 * (stop - start);
+        latencies.push_back(latency);
+        total_latency += latency;
+
+        size_t cycle_allocations = allocationCount() - allocations_before;
+        allocations += cycle_allocations;
+        if (cycle_allocations > 0) {
+            allocating_cycles++;
+        }
+    }
+
+    controller->stopping(time);
+    controller.reset();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    result.type = spec.type;
+    result.n_joints = n_joints;
+    result.cycles = options.cycles;
+    result.cycles_per_second = total_latency > 0.0 ? options.cycles / total_latency : 0.0;
+    result.latency_p50 = percentile(latencies, 0.5);
+    result.latency_p90 = percentile(latencies, 0.9);
+    result.latency_p99 = percentile(latencies, 0.99);
+    result.latency_p999 = percentile(latencies, 0.999);
+    result.latency_max = latencies.back();
+    result.allocations_per_cycle = static_cast<double>(allocations) / options.cycles;
+    result.allocating_cycles = allocating_cycles;
+
+    ROS_INFO("%-60s %2zu DOF%s: %9.0f cycles/s, latency p50 %7.1f us p90 %7.1f us p99 %7.1f us p99.9 %7.1f us max %7.1f us, "
+             "%.3f allocations/cycle (%d cycles)",
+             spec.type, n_joints, sevenbot ? " (sevenbot)" : "", result.cycles_per_second,
+             1e6 * result.latency_p50, 1e6 * result.latency_p90, 1e6 * result.latency_p99,
+             1e6 * result.latency_p999, 1e6 * result.latency_max,
+             result.allocations_per_cycle, result.allocating_cycles);
+
+    return true;
+}
+
+void writeResults(const std::string &path, const std::vector<BenchmarkResult> &results) {
+    std::ofstream output(path.c_str());
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        output << "- controller: " << result.type << "\n"
+               << "  dofs: " << result.n_joints << "\n"
+               << "  cycles: " << result.cycles << "\n"
+               << "  cycles_per_second: " << result.cycles_per_second << "\n"
+               << "  latency_p50: " << result.latency_p50 << "\n"
+               << "  latency_p90: " << result.latency_p90 << "\n"
+               << "  latency_p99: " << result.latency_p99 << "\n"
+               << "  latency_p999: " << result.latency_p999 << "\n"
+               << "  latency_max: " << result.latency_max << "\n"
+               << "  allocations_per_cycle: " << result.allocations_per_cycle << "\n"
+               << "  allocating_cycles: " << result.allocating_cycles << "\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    using namespace reflexxes_controllers_tests;
+
+    ros::init(argc, argv, "controller_benchmark");
+    ros::NodeHandle pnh("~");
+
+    BenchmarkOptions options;
+    pnh.param("cycles", options.cycles, 20000);
+    pnh.param("warmup_cycles", options.warmup_cycles, 100);
+    pnh.param("sampling_resolution", options.sampling_resolution, 0.001);
+    pnh.param("rml_rate_divisor", options.rml_rate_divisor, 1);
+    pnh.param("sevenbot_description", options.sevenbot_description, std::string());
+
+    if (options.cycles < 1 || options.warmup_cycles < 0 || options.sampling_resolution <= 0.0 ||
+            options.rml_rate_divisor < 1) {
+        ROS_ERROR("Invalid benchmark parameters (cycles: %d, warmup_cycles: %d, sampling_resolution: %f, "
+                  "rml_rate_divisor: %d)",
+                  options.cycles, options.warmup_cycles, options.sampling_resolution, options.rml_rate_divisor);
+        return 1;
+    }
+
+    std::vector<std::string> types;
+    if (!pnh.getParam("controllers", types)) {
+        for (size_t i = 0; i < N_CONTROLLER_SPECS; i++) {
+            types.push_back(CONTROLLER_SPECS[i].type);
+        }
+    }
+
+    std::vector<int> dofs;
+    if (!pnh.getParam("dofs", dofs)) {
+        int default_dofs[] = {1, 6, 7, 14, 32};
+        dofs.assign(default_dofs, default_dofs + 5);
+    }
+
+    double max_allocations_per_cycle, min_cycles_per_second, max_p99_latency;
+    pnh.param("max_allocations_per_cycle", max_allocations_per_cycle, -1.0);
+    pnh.param("min_cycles_per_second", min_cycles_per_second, -1.0);
+    pnh.param("max_p99_latency", max_p99_latency, -1.0);
+
+    std::string output_file;
+    pnh.param("output_file", output_file, std::string());
+
+    ControllerLoader loader("controller_interface", "controller_interface::ControllerBase");
+
+    std::vector<BenchmarkResult> results;
+    bool failed = false;
+
+    for (size_t t = 0; t < types.size(); t++) {
+        const ControllerSpec *spec = findControllerSpec(types[t]);
+
+        if (!spec) {
+            ROS_ERROR("Unknown controller type '%s'", types[t].c_str());
+            failed = true;
+            continue;
+        }
+
+        for (size_t d = 0; d < dofs.size(); d++) {
+            BenchmarkResult result;
+            if (dofs[d] < 1 || !runBenchmark(loader, *spec, dofs[d], options, result)) {
+                failed = true;
+                continue;
+            }
+
+            if (max_allocations_per_cycle >= 0.0 && result.allocations_per_cycle > max_allocations_per_cycle) {
+                ROS_ERROR("%s with %d joints: %.3f allocations per cycle exceed the limit of %.3f",
+                          spec->type, dofs[d], result.allocations_per_cycle, max_allocations_per_cycle);
+                failed = true;
+            }
+
+            if (min_cycles_per_second >= 0.0 && result.cycles_per_second < min_cycles_per_second) {
+                ROS_ERROR("%s with %d joints: %.0f cycles per second are below the limit of %.0f",
+                          spec->type, dofs[d], result.cycles_per_second, min_cycles_per_second);
+                failed = true;
+            }
+
+            if (max_p99_latency >= 0.0 && result.latency_p99 > max_p99_latency) {
+                ROS_ERROR("%s with %d joints: 99th percentile latency of %f s exceeds the limit of %f s",
+                          spec->type, dofs[d], result.latency_p99, max_p99_latency);
+                failed = true;
+            }
+
+            results.push_back(result);
+        }
+    }
+
+    if (!output_file.empty()) {
+        writeResults(output_file, results);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,419 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include "controller_harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <controller_interface/controller.h>
+
+#include <trajectory_msgs/JointTrajectory.h>
+#include <trajectory_msgs/JointTrajectoryPoint.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include <kdl_parser/kdl_parser.hpp>
+#include <kdl_conversions/kdl_msg.h>
+
+namespace {
+
+//! Heap allocation accounting, only the thread stepping the controllers is counted
+thread_local bool count_allocations = false;
+size_t allocation_count = 0;
+
+void *countedAllocation(std::size_t size) {
+    if (count_allocations) {
+        allocation_count++;
+    }
+
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    void *ptr = countedAllocation(size);
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void *operator new[](std::size_t size) {
+    void *ptr = countedAllocation(size);
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocation(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocation(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+namespace reflexxes_controllers_tests {
+
+void countAllocations(bool enabled) {
+    count_allocations = enabled;
+}
+
+size_t allocationCount() {
+    return allocation_count;
+}
+
+// The Cartesian controller solves IK with trac_ik on a worker thread, its commands depend on
+// when and how the worker converged
+const ControllerSpec CONTROLLER_SPECS[] = {
+    {"reflexxes_position_controllers/JointTrajectoryController", "trajectory_command", JOINT_TRAJECTORY, false, 4000, true},
+    {"reflexxes_position_controllers/JointPositionController", "joint_position_command", JOINT_POSITION, false, 500, true},
+    {"reflexxes_position_controllers/CartesianPositionController", "cartesian_position_command", CARTESIAN_POSITION, false, 1000, false},
+    {"reflexxes_effort_controllers/JointTrajectoryController", "trajectory_command", JOINT_TRAJECTORY, true, 4000, true},
+};
+
+const size_t N_CONTROLLER_SPECS = sizeof(CONTROLLER_SPECS) / sizeof(CONTROLLER_SPECS[0]);
+
+const ControllerSpec *findControllerSpec(const std::string &type) {
+    for (size_t i = 0; i < N_CONTROLLER_SPECS; i++) {
+        if (type == CONTROLLER_SPECS[i].type) {
+            return &CONTROLLER_SPECS[i];
+        }
+    }
+
+    return NULL;
+}
+
+FakeRobot::FakeRobot(const std::vector<std::string> &joint_names) :
+    positions_(joint_names.size(), 0.0),
+    velocities_(joint_names.size(), 0.0),
+    efforts_(joint_names.size(), 0.0),
+    position_commands_(joint_names.size(), 0.0),
+    effort_commands_(joint_names.size(), 0.0) {
+    for (size_t i = 0; i < joint_names.size(); i++) {
+        hardware_interface::JointStateHandle state_handle(
+            joint_names[i], &positions_[i], &velocities_[i], &efforts_[i]);
+
+        state_interface_.registerHandle(state_handle);
+        position_interface_.registerHandle(
+            hardware_interface::JointHandle(state_handle, &position_commands_[i]));
+        effort_interface_.registerHandle(
+            hardware_interface::JointHandle(state_handle, &effort_commands_[i]));
+    }
+}
+
+void FakeRobot::write(bool effort, double dt) {
+    for (size_t i = 0; i < positions_.size(); i++) {
+        if (effort) {
+            efforts_[i] = effort_commands_[i];
+            velocities_[i] += (effort_commands_[i] - DAMPING * velocities_[i]) * dt;
+            positions_[i] += velocities_[i] * dt;
+        } else {
+            velocities_[i] = (position_commands_[i] - positions_[i]) / dt;
+            positions_[i] = position_commands_[i];
+        }
+    }
+}
+
+void FakeRobot::setState(const double *positions, const double *velocities, const double *efforts) {
+    std::copy(positions, positions + positions_.size(), positions_.begin());
+    std::copy(velocities, velocities + velocities_.size(), velocities_.begin());
+    std::copy(efforts, efforts + efforts_.size(), efforts_.begin());
+}
+
+CommandStream::CommandStream(ros::NodeHandle &nh, const ControllerSpec &spec,
+                             const std::vector<std::string> &joint_names,
+                             const KDL::Chain &chain, const std::string &root_name,
+                             std::vector<RecordedCommand> *recording) :
+    spec_(spec),
+    joint_names_(joint_names),
+    root_name_(root_name),
+    fk_solver_(chain),
+    joint_positions_(joint_names.size()),
+    recording_(recording) {
+    switch (spec_.command) {
+    case JOINT_TRAJECTORY:
+        publisher_ = nh.advertise<trajectory_msgs::JointTrajectory>(spec_.topic, 1);
+        break;
+    case JOINT_POSITION:
+        publisher_ = nh.advertise<trajectory_msgs::JointTrajectoryPoint>(spec_.topic, 1);
+        break;
+    case CARTESIAN_POSITION:
+        publisher_ = nh.advertise<geometry_msgs::PoseStamped>(spec_.topic, 1);
+        break;
+    }
+}
+
+bool CommandStream::waitForController(double timeout) {
+    for (double waited = 0.0; publisher_.getNumSubscribers() == 0; waited += 0.01) {
+        if (waited > timeout || !ros::ok()) {
+            return false;
+        }
+
+        ros::WallDuration(0.01).sleep();
+    }
+
+    return true;
+}
+
+void CommandStream::update(int cycle) {
+    if (cycle % spec_.command_period != 0) {
+        return;
+    }
+
+    int index = cycle / spec_.command_period;
+
+    switch (spec_.command) {
+    case JOINT_TRAJECTORY: {
+        trajectory_msgs::JointTrajectory trajectory;
+        trajectory.joint_names = joint_names_;
+        trajectory.points.resize(TRAJECTORY_POINTS);
+
+        for (int k = 0; k < TRAJECTORY_POINTS; k++) {
+            target(index * TRAJECTORY_POINTS + k, trajectory.points[k].positions);
+            trajectory.points[k].velocities.assign(joint_names_.size(), 0.0);
+            trajectory.points[k].time_from_start = ros::Duration(1.0 + k);
+        }
+
+        publish(cycle, trajectory);
+        break;
+    }
+    case JOINT_POSITION: {
+        trajectory_msgs::JointTrajectoryPoint point;
+        target(index, point.positions);
+        point.velocities.assign(joint_names_.size(), 0.0);
+        publish(cycle, point);
+        break;
+    }
+    case CARTESIAN_POSITION: {
+        std::vector<double> positions;
+        target(index, positions);
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            joint_positions_(i) = positions[i];
+        }
+
+        KDL::Frame frame;
+        fk_solver_.JntToCart(joint_positions_, frame);
+
+        geometry_msgs::PoseStamped pose;
+        pose.header.frame_id = root_name_;
+        tf::poseKDLToMsg(frame, pose.pose);
+        publish(cycle, pose);
+        break;
+    }
+    }
+
+    // Intraprocess messages are queued on publish, run the subscriber now
+    ros::spinOnce();
+}
+
+void CommandStream::replay(const RecordedCommand &command) {
+    // The message is read from a copy, IStream does not take const data
+    std::vector<boost::uint8_t> data(command.data);
+    ros::serialization::IStream stream(data.empty() ? NULL : &data[0], data.size());
+
+    switch (spec_.command) {
+    case JOINT_TRAJECTORY: {
+        trajectory_msgs::JointTrajectory trajectory;
+        ros::serialization::deserialize(stream, trajectory);
+        publisher_.publish(trajectory);
+        break;
+    }
+    case JOINT_POSITION: {
+        trajectory_msgs::JointTrajectoryPoint point;
+        ros::serialization::deserialize(stream, point);
+        publisher_.publish(point);
+        break;
+    }
+    case CARTESIAN_POSITION: {
+        geometry_msgs::PoseStamped pose;
+        ros::serialization::deserialize(stream, pose);
+        publisher_.publish(pose);
+        break;
+    }
+    }
+
+    ros::spinOnce();
+}
+
+void CommandStream::target(int index, std::vector<double> &positions) const {
+    positions.resize(joint_names_.size());
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = 0.8 * std::sin(0.9 * index + 0.5 * i);
+    }
+}
+
+template <class Message>
+void CommandStream::publish(int cycle, const Message &msg) {
+    publisher_.publish(msg);
+
+    if (!recording_) {
+        return;
+    }
+
+    RecordedCommand command;
+    command.cycle = cycle;
+    command.data.resize(ros::serialization::serializationLength(msg));
+
+    ros::serialization::OStream stream(command.data.empty() ? NULL : &command.data[0], command.data.size());
+    ros::serialization::serialize(stream, msg);
+    recording_->push_back(command);
+}
+
+std::string chainDescription(size_t n_joints) {
+    std::ostringstream urdf;
+    urdf << "<?xml version=\"1.0\"?>\n"
+         << "<robot name=\"benchbot\">\n"
+         << "  <link name=\"world\"/>\n"
+         << "  <joint name=\"base_joint\" type=\"fixed\">\n"
+         << "    <parent link=\"world\"/>\n"
+         << "    <child link=\"base_link\"/>\n"
+         << "  </joint>\n";
+
+    for (size_t i = 0; i <= n_joints; i++) {
+        std::string link = i == 0 ? std::string("base_link") : "l" + std::to_string(i);
+        urdf << "  <link name=\"" << link << "\">\n"
+             << "    <inertial>\n"
+             << "      <origin xyz=\"0 0 0\"/>\n"
+             << "      <mass value=\"0.1\"/>\n"
+             << "      <inertia ixx=\"0.1\" ixy=\"0\" ixz=\"0\" iyy=\"0.1\" iyz=\"0\" izz=\"0.1\"/>\n"
+             << "    </inertial>\n"
+             << "  </link>\n";
+    }
+
+    for (size_t i = 1; i <= n_joints; i++) {
+        urdf << "  <joint name=\"j" << i << "\" type=\"revolute\">\n"
+             << "    <parent link=\"" << (i == 1 ? std::string("base_link") : "l" + std::to_string(i - 1)) << "\"/>\n"
+             << "    <child link=\"l" << i << "\"/>\n"
+             << "    <origin xyz=\"1 0 0\"/>\n"
+             << "    <axis xyz=\"0 0 1\"/>\n"
+             << "    <limit effort=\"100\" velocity=\"100\" lower=\"-1.57\" upper=\"1.57\"/>\n"
+             << "  </joint>\n";
+    }
+
+    urdf << "</robot>\n";
+    return urdf.str();
+}
+
+std::vector<std::string> jointNames(size_t n_joints) {
+    std::vector<std::string> joint_names;
+
+    for (size_t i = 1; i <= n_joints; i++) {
+        joint_names.push_back("j" + std::to_string(i));
+    }
+
+    return joint_names;
+}
+
+bool kinematicChain(const std::string &description, size_t n_joints, KDL::Chain &chain,
+                    std::string &root_name, std::string &tip_name) {
+    root_name = "base_link";
+    tip_name = "l" + std::to_string(n_joints);
+
+    KDL::Tree tree;
+    if (!kdl_parser::treeFromString(description, tree) || !tree.getChain(root_name, tip_name, chain)) {
+        ROS_ERROR("Failed to build the kinematic chain from %s to %s", root_name.c_str(), tip_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void setControllerParameters(const ros::NodeHandle &nh, const ControllerSpec &spec,
+                             const std::vector<std::string> &joint_names,
+                             const std::string &root_name, const std::string &tip_name,
+                             double sampling_resolution, int rml_rate_divisor) {
+    nh.setParam("type", std::string(spec.type));
+    nh.setParam("joint_names", joint_names);
+    nh.setParam("sampling_resolution", sampling_resolution);
+    nh.setParam("rml_rate_divisor", rml_rate_divisor);
+    nh.setParam("root_name", root_name);
+    nh.setParam("tip_name", tip_name);
+
+    for (size_t i = 0; i < joint_names.size(); i++) {
+        ros::NodeHandle joint_nh(nh, "joints/" + joint_names[i]);
+        joint_nh.setParam("position_tolerance", 0.1);
+        joint_nh.setParam("tracking_position_tolerance", 0.1);
+        joint_nh.setParam("max_acceleration", 1.0);
+        joint_nh.setParam("max_jerk", 1000.0);
+        joint_nh.setParam("pid/p", 100.0);
+        joint_nh.setParam("pid/i", 0.0);
+        joint_nh.setParam("pid/d", 20.0);
+    }
+}
+
+boost::shared_ptr<controller_interface::ControllerBase> loadController(
+    ControllerLoader &loader, const ControllerSpec &spec, ros::NodeHandle &nh, FakeRobot &robot) {
+    boost::shared_ptr<controller_interface::ControllerBase> controller;
+
+    try {
+        controller = loader.createInstance(spec.type);
+    } catch (pluginlib::PluginlibException &ex) {
+        ROS_ERROR("Failed to load %s: %s", spec.type, ex.what());
+        return boost::shared_ptr<controller_interface::ControllerBase>();
+    }
+
+    bool initialized = false;
+    if (spec.effort) {
+        controller_interface::Controller<hardware_interface::EffortJointInterface> *effort_controller =
+            dynamic_cast<controller_interface::Controller<hardware_interface::EffortJointInterface> *>(controller.get());
+        initialized = effort_controller && effort_controller->init(robot.effortInterface(), nh);
+    } else {
+        controller_interface::Controller<hardware_interface::PositionJointInterface> *position_controller =
+            dynamic_cast<controller_interface::Controller<hardware_interface::PositionJointInterface> *>(controller.get());
+        initialized = position_controller && position_controller->init(robot.positionInterface(), nh);
+    }
+
+    if (!initialized) {
+        ROS_ERROR("Failed to initialize %s in namespace %s", spec.type, nh.getNamespace().c_str());
+        return boost::shared_ptr<controller_interface::ControllerBase>();
+    }
+
+    return controller;
+}
+
+} // namespace
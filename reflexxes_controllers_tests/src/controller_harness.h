@@ -0,0 +1,208 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_TESTS_CONTROLLER_HARNESS_H
+#define REFLEXXES_CONTROLLERS_TESTS_CONTROLLER_HARNESS_H
+
+/**
+  Headless harness of the reflexxes controllers
+
+  Controller plugins are loaded through pluginlib and stepped against an
+  in-process FakeRobot, without a controller manager, a simulator or wall
+  clock time. A CommandStream publishes scripted commands on the controller
+  topics and delivers them before the cycle they are due in, so a run only
+  depends on the controllers themselves.
+
+  Heap allocations are counted on the thread which enabled counting with
+  countAllocations(). The harness replaces the global operator new, so it
+  must be linked into each executable exactly once.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <pluginlib/class_loader.h>
+#include <controller_interface/controller_base.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+
+#include <kdl/chain.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/jntarray.hpp>
+
+namespace reflexxes_controllers_tests {
+
+typedef pluginlib::ClassLoader<controller_interface::ControllerBase> ControllerLoader;
+
+//! Count the heap allocations of the calling thread from now on, or stop counting
+void countAllocations(bool enabled);
+
+//! Heap allocations counted so far, by all threads
+size_t allocationCount();
+
+enum CommandType {
+    JOINT_TRAJECTORY,
+    JOINT_POSITION,
+    CARTESIAN_POSITION
+};
+
+struct ControllerSpec {
+    const char *type;
+    const char *topic;
+    CommandType command;
+    bool effort;                //* drives an EffortJointInterface
+    int command_period;         //* control cycles between two commands
+    bool deterministic;         //* the commands only depend on the inputs of each cycle, see ReplayFixture
+};
+
+extern const ControllerSpec CONTROLLER_SPECS[];
+extern const size_t N_CONTROLLER_SPECS;
+
+//! Spec of the given plugin type, NULL if there is none
+const ControllerSpec *findControllerSpec(const std::string &type);
+
+//! Points of every scripted joint trajectory, one second apart
+const int TRAJECTORY_POINTS = 3;
+
+/**
+  Hardware interfaces of an ideal robot
+
+  Position commands are tracked exactly, effort commands drive unit inertias
+  with a little viscous friction.
+*/
+class FakeRobot {
+
+public:
+    FakeRobot(const std::vector<std::string> &joint_names);
+
+    //! Apply the commands of the last cycle
+    void write(bool effort, double dt);
+
+    //! Overwrite the joint state read by the controller
+    void setState(const double *positions, const double *velocities, const double *efforts);
+
+    double position(size_t i) const {
+        return positions_[i];
+    }
+
+    double velocity(size_t i) const {
+        return velocities_[i];
+    }
+
+    double effort(size_t i) const {
+        return efforts_[i];
+    }
+
+    //! Last command of the joint on the interface the controller drives
+    double command(bool effort, size_t i) const {
+        return effort ? effort_commands_[i] : position_commands_[i];
+    }
+
+    hardware_interface::PositionJointInterface *positionInterface() {
+        return &position_interface_;
+    }
+
+    hardware_interface::EffortJointInterface *effortInterface() {
+        return &effort_interface_;
+    }
+
+private:
+    static constexpr double DAMPING = 0.1;
+
+    //! Joint state and commands, never resized since the handles point into them
+    std::vector<double> positions_;
+    std::vector<double> velocities_;
+    std::vector<double> efforts_;
+    std::vector<double> position_commands_;
+    std::vector<double> effort_commands_;
+
+    hardware_interface::JointStateInterface state_interface_;
+    hardware_interface::PositionJointInterface position_interface_;
+    hardware_interface::EffortJointInterface effort_interface_;
+};
+
+//! Serialized command message and the control cycle it was delivered before
+struct RecordedCommand {
+    boost::uint32_t cycle;
+    std::vector<boost::uint8_t> data;
+};
+
+/**
+  Deterministic command stream of one run
+
+  If a recording is given, every published command is appended to it, and
+  replay() delivers such a recording again.
+*/
+class CommandStream {
+
+public:
+    CommandStream(ros::NodeHandle &nh, const ControllerSpec &spec,
+                  const std::vector<std::string> &joint_names,
+                  const KDL::Chain &chain, const std::string &root_name,
+                  std::vector<RecordedCommand> *recording = NULL);
+
+    bool waitForController(double timeout);
+
+    //! Publish the command due at the given cycle and deliver it
+    void update(int cycle);
+
+    //! Publish a recorded command and deliver it
+    void replay(const RecordedCommand &command);
+
+private:
+    //! Reachable joint configuration, well inside the sevenbot limits
+    void target(int index, std::vector<double> &positions) const;
+
+    template <class Message>
+    void publish(int cycle, const Message &msg);
+
+    const ControllerSpec &spec_;
+    std::vector<std::string> joint_names_;
+    std::string root_name_;
+    ros::Publisher publisher_;
+    KDL::ChainFkSolverPos_recursive fk_solver_;
+    KDL::JntArray joint_positions_;
+    std::vector<RecordedCommand> *recording_;
+};
+
+//! Serial chain with the joint and link layout of the sevenbot model
+std::string chainDescription(size_t n_joints);
+
+//! Names of the joints of chainDescription() and of the sevenbot model
+std::vector<std::string> jointNames(size_t n_joints);
+
+//! Chain from base_link to the last link of a description with n_joints joints, false on failure
+bool kinematicChain(const std::string &description, size_t n_joints, KDL::Chain &chain,
+                    std::string &root_name, std::string &tip_name);
+
+void setControllerParameters(const ros::NodeHandle &nh, const ControllerSpec &spec,
+                             const std::vector<std::string> &joint_names,
+                             const std::string &root_name, const std::string &tip_name,
+                             double sampling_resolution, int rml_rate_divisor);
+
+//! Create the controller of spec and initialize it in nh with the interface of robot, NULL on failure
+boost::shared_ptr<controller_interface::ControllerBase> loadController(
+    ControllerLoader &loader, const ControllerSpec &spec, ros::NodeHandle &nh, FakeRobot &robot);
+
+} // namespace
+
+#endif
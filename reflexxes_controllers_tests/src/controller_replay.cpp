@@ -0,0 +1,228 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+/**
+  Records and replays the regression fixtures of the reflexxes controllers
+
+  In record mode, a ReplayFixture is recorded for every deterministic
+  controller and number of joints and written to ~fixture_dir as
+  TYPE_Ndof.bin, with the slashes of the type replaced. In replay mode,
+  every fixture in ~fixture_dir is replayed and the commands are compared
+  with the recorded ones, see replayFixture(). Each fixture is replayed
+  with its recorded controller type and with the fixed-size variant of the
+  type for its number of joints, if there is one.
+
+  @param ~mode "record" or "replay" (default: "replay").
+  @param ~fixture_dir Directory of the fixture files (required).
+  @param ~controllers Plugin types to record (default: all deterministic ones).
+  @param ~dofs Numbers of joints to record (default: [1, 6, 7, 14]).
+  @param ~cycles Number of control cycles recorded per fixture (default: 10000).
+  @param ~sampling_resolution Simulated control period in seconds (default: 0.001).
+  @param ~rml_rate_divisor Servo cycles per trajectory generator sample of the controllers (default: 1).
+  @param ~tolerance Largest deviation of a command, relative to its magnitude if that exceeds 1 (default: 1e-9).
+  @param ~max_allocations_per_cycle Fail when exceeded while replaying (default: -1, disabled).
+
+  The process returns a non-zero exit code when a fixture could not be
+  recorded or replayed, a command deviated or a limit was violated.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ros/ros.h>
+
+#include "replay_fixture.h"
+
+namespace reflexxes_controllers_tests {
+
+std::string fixturePath(const std::string &directory, const std::string &type, size_t n_joints) {
+    std::string name = type;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return (boost::filesystem::path(directory) / (name + "_" + std::to_string(n_joints) + "dof.bin")).string();
+}
+
+//! Fixture files in directory, sorted by name
+std::vector<std::string> fixturePaths(const std::string &directory) {
+    std::vector<std::string> paths;
+    boost::system::error_code error;
+
+    for (boost::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() == ".bin") {
+            paths.push_back(it->path().string());
+        }
+    }
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+//! Fixed-size variant of type for n_joints joints, empty if it has none
+std::string fixedSizeVariant(const std::string &type, size_t n_joints) {
+    if (n_joints != 6 && n_joints != 7) {
+        return std::string();
+    }
+
+    return type + (n_joints == 6 ? "6DOF" : "7DOF");
+}
+
+void reportReplay(const std::string &path, const ReplayResult &result) {
+    if (result.mismatches == 0) {
+        ROS_INFO("%s replayed with %s: %zu cycles match (max error %g), %.0f ns/cycle (p99 %.0f ns), "
+                 "%.3f allocations/cycle (%zu cycles)",
+                 path.c_str(), result.type.c_str(), result.cycles, result.max_error, result.ns_per_cycle,
+                 result.ns_p99, result.allocations_per_cycle, result.allocating_cycles);
+    } else {
+        ROS_ERROR("%s replayed with %s: %zu commands deviate (max error %g), the first in cycle %ld on joint %zu, "
+                  "%.0f ns/cycle (p99 %.0f ns), %.3f allocations/cycle (%zu cycles)",
+                  path.c_str(), result.type.c_str(), result.mismatches, result.max_error, result.first_mismatch,
+                  result.first_mismatch_joint, result.ns_per_cycle, result.ns_p99, result.allocations_per_cycle,
+                  result.allocating_cycles);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    using namespace reflexxes_controllers_tests;
+
+    ros::init(argc, argv, "controller_replay");
+    ros::NodeHandle pnh("~");
+
+    std::string mode, fixture_dir;
+    pnh.param("mode", mode, std::string("replay"));
+
+    if (!pnh.getParam("fixture_dir", fixture_dir) || (mode != "record" && mode != "replay")) {
+        ROS_ERROR("The 'fixture_dir' parameter is required and 'mode' must be \"record\" or \"replay\".");
+        return 1;
+    }
+
+    ControllerLoader loader("controller_interface", "controller_interface::ControllerBase");
+    bool failed = false;
+
+    if (mode == "record") {
+        RecordOptions options;
+        pnh.param("cycles", options.cycles, 10000);
+        pnh.param("sampling_resolution", options.sampling_resolution, 0.001);
+        pnh.param("rml_rate_divisor", options.rml_rate_divisor, 1);
+
+        if (options.cycles < 1 || options.sampling_resolution <= 0.0 || options.rml_rate_divisor < 1) {
+            ROS_ERROR("Invalid recording parameters (cycles: %d, sampling_resolution: %f, rml_rate_divisor: %d)",
+                      options.cycles, options.sampling_resolution, options.rml_rate_divisor);
+            return 1;
+        }
+
+        std::vector<std::string> types;
+        if (!pnh.getParam("controllers", types)) {
+            for (size_t i = 0; i < N_CONTROLLER_SPECS; i++) {
+                if (CONTROLLER_SPECS[i].deterministic) {
+                    types.push_back(CONTROLLER_SPECS[i].type);
+                }
+            }
+        }
+
+        std::vector<int> dofs;
+        if (!pnh.getParam("dofs", dofs)) {
+            int default_dofs[] = {1, 6, 7, 14};
+            dofs.assign(default_dofs, default_dofs + 4);
+        }
+
+        boost::system::error_code error;
+        boost::filesystem::create_directories(fixture_dir, error);
+
+        for (size_t t = 0; t < types.size(); t++) {
+            const ControllerSpec *spec = findControllerSpec(types[t]);
+
+            if (!spec) {
+                ROS_ERROR("Unknown controller type '%s'", types[t].c_str());
+                failed = true;
+                continue;
+            }
+
+            for (size_t d = 0; d < dofs.size(); d++) {
+                ReplayFixture fixture;
+                std::string path = fixturePath(fixture_dir, spec->type, dofs[d]);
+
+                if (dofs[d] < 1 || !recordFixture(loader, *spec, dofs[d], options, fixture) || !fixture.write(path)) {
+                    failed = true;
+                    continue;
+                }
+
+                ROS_INFO("Wrote %s", path.c_str());
+            }
+        }
+
+        return failed ? 1 : 0;
+    }
+
+    ReplayOptions options;
+    double max_allocations_per_cycle;
+    pnh.param("tolerance", options.tolerance, 1e-9);
+    pnh.param("max_allocations_per_cycle", max_allocations_per_cycle, -1.0);
+
+    std::vector<std::string> paths = fixturePaths(fixture_dir);
+
+    if (paths.empty()) {
+        ROS_ERROR("No replay fixtures found in '%s'.", fixture_dir.c_str());
+        return 1;
+    }
+
+    for (size_t p = 0; p < paths.size(); p++) {
+        ReplayFixture fixture;
+
+        if (!fixture.read(paths[p])) {
+            failed = true;
+            continue;
+        }
+
+        // Replay with the recorded type, then with its fixed-size variant
+        std::vector<std::string> types(1, std::string());
+        std::string variant = fixedSizeVariant(fixture.type, fixture.joint_names.size());
+
+        if (!variant.empty()) {
+            types.push_back(variant);
+        }
+
+        for (size_t t = 0; t < types.size(); t++) {
+            ReplayResult result;
+            options.type = types[t];
+
+            if (!replayFixture(loader, fixture, options, result)) {
+                failed = true;
+                continue;
+            }
+
+            reportReplay(paths[p], result);
+
+            if (result.mismatches > 0) {
+                failed = true;
+            }
+
+            if (max_allocations_per_cycle >= 0.0 && result.allocations_per_cycle > max_allocations_per_cycle) {
+                ROS_ERROR("%s replayed with %s: %.3f allocations per cycle exceed the limit of %.3f",
+                          paths[p].c_str(), result.type.c_str(), result.allocations_per_cycle,
+                          max_allocations_per_cycle);
+                failed = true;
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,417 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include "replay_fixture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <ros/ros.h>
+
+#include <reflexxes_controllers_common/cycle_timing.h>
+
+namespace reflexxes_controllers_tests {
+
+namespace {
+
+const boost::uint32_t REPLAY_VERSION = 1;
+
+//! Longest string or command accepted when reading, guards against corrupt files
+const boost::uint32_t MAX_FIELD_SIZE = 1 << 24;
+
+template <class T>
+void writeValue(std::ostream &output, const T &value) {
+    output.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <class T>
+bool readValue(std::istream &input, T &value) {
+    return static_cast<bool>(input.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+void writeBytes(std::ostream &output, const void *data, size_t size) {
+    writeValue(output, static_cast<boost::uint32_t>(size));
+    output.write(static_cast<const char *>(data), size);
+}
+
+void writeString(std::ostream &output, const std::string &value) {
+    writeBytes(output, value.data(), value.size());
+}
+
+bool readString(std::istream &input, std::string &value) {
+    boost::uint32_t size;
+
+    if (!readValue(input, size) || size > MAX_FIELD_SIZE) {
+        return false;
+    }
+
+    value.resize(size);
+    return size == 0 || input.read(&value[0], size);
+}
+
+//! Namespace of a run, unique for each purpose, controller type and number of joints
+ros::NodeHandle runNodeHandle(const std::string &purpose, const std::string &type, size_t n_joints) {
+    std::string name = type;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return ros::NodeHandle(ros::NodeHandle("~"), purpose + "_" + name + "_" + std::to_string(n_joints) + "dof");
+}
+
+double percentile(const std::vector<double> &sorted, double fraction) {
+    size_t index = static_cast<size_t>(fraction * sorted.size());
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+ReplayFixture::ReplayFixture()
+    : sampling_resolution(0.001),
+      rml_rate_divisor(1),
+      start(1.0),
+      n_cycles(0)
+{}
+
+bool ReplayFixture::write(const std::string &path) const {
+    std::ofstream output(path.c_str(), std::ios::binary);
+
+    ReplayFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::strncpy(header.magic, "RFXRPLY", sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.n_joints = joint_names.size();
+    header.values_per_joint = REPLAY_VALUES_PER_JOINT;
+    header.rml_rate_divisor = rml_rate_divisor;
+    header.n_commands = commands.size();
+    header.n_cycles = n_cycles;
+    header.start_ns = start.toNSec();
+    header.sampling_resolution = sampling_resolution;
+    writeValue(output, header);
+
+    writeString(output, type);
+    writeString(output, description);
+
+    for (size_t i = 0; i < joint_names.size(); i++) {
+        writeString(output, joint_names[i]);
+    }
+
+    for (size_t k = 0; k < commands.size(); k++) {
+        writeValue(output, commands[k].cycle);
+        writeBytes(output, commands[k].data.empty() ? NULL : &commands[k].data[0], commands[k].data.size());
+    }
+
+    output.write(reinterpret_cast<const char *>(values.empty() ? NULL : &values[0]), values.size() * sizeof(double));
+    output.close();
+
+    if (!output) {
+        ROS_ERROR("Could not write the replay fixture '%s'.", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ReplayFixture::read(const std::string &path) {
+    std::ifstream input(path.c_str(), std::ios::binary);
+    ReplayFileHeader header;
+
+    if (!readValue(input, header) || std::strncmp(header.magic, "RFXRPLY", sizeof(header.magic)) != 0) {
+        ROS_ERROR("'%s' is not a replay fixture.", path.c_str());
+        return false;
+    }
+
+    if (header.version != REPLAY_VERSION || header.values_per_joint != REPLAY_VALUES_PER_JOINT) {
+        ROS_ERROR("The replay fixture '%s' has version %u with %u values per joint, expected version %u with %zu.",
+                  path.c_str(), header.version, header.values_per_joint, REPLAY_VERSION, REPLAY_VALUES_PER_JOINT);
+        return false;
+    }
+
+    bool valid = header.n_joints > 0 && header.sampling_resolution > 0.0 && header.rml_rate_divisor > 0 &&
+                 readString(input, type) && readString(input, description);
+
+    joint_names.resize(header.n_joints);
+
+    for (size_t i = 0; valid && i < joint_names.size(); i++) {
+        valid = readString(input, joint_names[i]);
+    }
+
+    commands.clear();
+
+    for (boost::uint64_t k = 0; valid && k < header.n_commands; k++) {
+        RecordedCommand command;
+        boost::uint32_t size;
+        valid = readValue(input, command.cycle) && readValue(input, size) && size <= MAX_FIELD_SIZE;
+
+        if (valid) {
+            command.data.resize(size);
+            valid = size == 0 || input.read(reinterpret_cast<char *>(&command.data[0]), size);
+            commands.push_back(command);
+        }
+    }
+
+    if (valid) {
+        values.resize(header.n_cycles * header.n_joints * REPLAY_VALUES_PER_JOINT);
+        valid = values.empty() || input.read(reinterpret_cast<char *>(&values[0]), values.size() * sizeof(double));
+    }
+
+    if (!valid) {
+        ROS_ERROR("The replay fixture '%s' is truncated or corrupt.", path.c_str());
+        return false;
+    }
+
+    sampling_resolution = header.sampling_resolution;
+    rml_rate_divisor = header.rml_rate_divisor;
+    start.fromNSec(header.start_ns);
+    n_cycles = header.n_cycles;
+
+    return true;
+}
+
+bool recordFixture(ControllerLoader &loader, const ControllerSpec &spec, size_t n_joints,
+                   const RecordOptions &options, ReplayFixture &fixture) {
+    if (!spec.deterministic) {
+        ROS_ERROR("%s can not be replayed, its commands do not only depend on its inputs.", spec.type);
+        return false;
+    }
+
+    fixture = ReplayFixture();
+    fixture.type = spec.type;
+    fixture.description = chainDescription(n_joints);
+    fixture.joint_names = jointNames(n_joints);
+    fixture.sampling_resolution = options.sampling_resolution;
+    fixture.rml_rate_divisor = options.rml_rate_divisor;
+    fixture.n_cycles = options.cycles;
+    fixture.values.resize(fixture.n_cycles * n_joints * REPLAY_VALUES_PER_JOINT);
+
+    ros::NodeHandle nh;
+    nh.setParam("/robot_description", fixture.description);
+
+    std::string root_name, tip_name;
+    KDL::Chain chain;
+    if (!kinematicChain(fixture.description, n_joints, chain, root_name, tip_name)) {
+        return false;
+    }
+
+    ros::NodeHandle controller_nh = runNodeHandle("record", spec.type, n_joints);
+    setControllerParameters(controller_nh, spec, fixture.joint_names, root_name, tip_name,
+                            fixture.sampling_resolution, fixture.rml_rate_divisor);
+
+    // The robot has to outlive the controller holding its handles
+    FakeRobot robot(fixture.joint_names);
+    boost::shared_ptr<controller_interface::ControllerBase> controller =
+        loadController(loader, spec, controller_nh, robot);
+
+    if (!controller) {
+        return false;
+    }
+
+    CommandStream commands(controller_nh, spec, fixture.joint_names, chain, root_name, &fixture.commands);
+    if (!commands.waitForController(5.0)) {
+        ROS_ERROR("%s did not subscribe to %s", spec.type, spec.topic);
+        return false;
+    }
+
+    // Simulated time, closed loop with the robot
+    ros::Duration period(fixture.sampling_resolution);
+    ros::Time time = fixture.start;
+    controller->starting(time);
+
+    for (size_t cycle = 0; cycle < fixture.n_cycles; cycle++) {
+        commands.update(cycle);
+
+        double *values = fixture.cycle(cycle);
+
+        for (size_t i = 0; i < n_joints; i++, values += REPLAY_VALUES_PER_JOINT) {
+            values[0] = robot.position(i);
+            values[1] = robot.velocity(i);
+            values[2] = robot.effort(i);
+        }
+
+        controller->update(time, period);
+
+        values = fixture.cycle(cycle);
+
+        for (size_t i = 0; i < n_joints; i++, values += REPLAY_VALUES_PER_JOINT) {
+            values[3] = robot.command(spec.effort, i);
+        }
+
+        robot.write(spec.effort, period.toSec());
+        time += period;
+    }
+
+    controller->stopping(time);
+
+    ROS_INFO("Recorded %zu cycles and %zu commands of %s with %zu joints.",
+             fixture.n_cycles, fixture.commands.size(), spec.type, n_joints);
+
+    return true;
+}
+
+bool replayFixture(ControllerLoader &loader, const ReplayFixture &fixture, const ReplayOptions &options,
+                   ReplayResult &result) {
+    if (fixture.n_cycles == 0) {
+        ROS_ERROR("The replay fixture of %s has no cycles.", fixture.type.c_str());
+        return false;
+    }
+
+    const ControllerSpec *recorded_spec = findControllerSpec(fixture.type);
+
+    if (!recorded_spec || !recorded_spec->deterministic) {
+        ROS_ERROR("The replay fixture was recorded with %s, which can not be replayed.", fixture.type.c_str());
+        return false;
+    }
+
+    // Variants of the recorded controller take the same commands
+    ControllerSpec spec = *recorded_spec;
+    if (!options.type.empty()) {
+        spec.type = options.type.c_str();
+    }
+
+    size_t n_joints = fixture.joint_names.size();
+    ros::NodeHandle nh;
+    nh.setParam("/robot_description", fixture.description);
+
+    std::string root_name, tip_name;
+    KDL::Chain chain;
+    if (!kinematicChain(fixture.description, n_joints, chain, root_name, tip_name)) {
+        return false;
+    }
+
+    ros::NodeHandle controller_nh = runNodeHandle("replay", spec.type, n_joints);
+    setControllerParameters(controller_nh, spec, fixture.joint_names, root_name, tip_name,
+                            fixture.sampling_resolution, fixture.rml_rate_divisor);
+
+    // The robot has to outlive the controller holding its handles
+    FakeRobot robot(fixture.joint_names);
+    boost::shared_ptr<controller_interface::ControllerBase> controller =
+        loadController(loader, spec, controller_nh, robot);
+
+    if (!controller) {
+        return false;
+    }
+
+    CommandStream commands(controller_nh, spec, fixture.joint_names, chain, root_name);
+    if (!commands.waitForController(5.0)) {
+        ROS_ERROR("%s did not subscribe to %s", spec.type, spec.topic);
+        return false;
+    }
+
+    result.type = spec.type;
+    result.n_joints = n_joints;
+    result.cycles = fixture.n_cycles;
+    result.mismatches = 0;
+    result.max_error = 0.0;
+    result.first_mismatch = -1;
+    result.first_mismatch_joint = 0;
+    result.allocating_cycles = 0;
+
+    std::vector<double> positions(n_joints), velocities(n_joints), efforts(n_joints);
+    std::vector<double> latencies;
+    latencies.reserve(fixture.n_cycles);
+    size_t allocations = 0;
+    double total_latency = 0.0;
+
+    // Simulated time, open loop with the recorded joint states
+    ros::Duration period(fixture.sampling_resolution);
+    ros::Time time = fixture.start;
+    size_t next_command = 0;
+
+    // Start from the recorded initial state, before the first command like the recording
+    const double *initial = fixture.cycle(0);
+
+    for (size_t i = 0; i < n_joints; i++, initial += REPLAY_VALUES_PER_JOINT) {
+        positions[i] = initial[0];
+        velocities[i] = initial[1];
+        efforts[i] = initial[2];
+    }
+
+    robot.setState(&positions[0], &velocities[0], &efforts[0]);
+    controller->starting(time);
+
+    for (size_t cycle = 0; cycle < fixture.n_cycles; cycle++) {
+        while (next_command < fixture.commands.size() && fixture.commands[next_command].cycle <= cycle) {
+            commands.replay(fixture.commands[next_command++]);
+        }
+
+        const double *values = fixture.cycle(cycle);
+
+        for (size_t i = 0; i < n_joints; i++, values += REPLAY_VALUES_PER_JOINT) {
+            positions[i] = values[0];
+            velocities[i] = values[1];
+            efforts[i] = values[2];
+        }
+
+        robot.setState(&positions[0], &velocities[0], &efforts[0]);
+
+        size_t allocations_before = allocationCount();
+        int64_t start = reflexxes_controllers_common::monotonicNanoseconds();
+        countAllocations(true);
+        controller->update(time, period);
+        countAllocations(false);
+        int64_t stop = reflexxes_controllers_common::monotonicNanoseconds();
+
+        latencies.push_back(stop - start);
+        total_latency += stop - start;
+
+        size_t cycle_allocations = allocationCount() - allocations_before;
+        allocations += cycle_allocations;
+        if (cycle_allocations > 0) {
+            result.allocating_cycles++;
+        }
+
+        // Compare the commands, NaN matches only NaN
+        values = fixture.cycle(cycle);
+
+        for (size_t i = 0; i < n_joints; i++, values += REPLAY_VALUES_PER_JOINT) {
+            double expected = values[3];
+            double command = robot.command(spec.effort, i);
+
+            if (std::isnan(expected) && std::isnan(command)) {
+                continue;
+            }
+
+            double error = std::abs(command - expected);
+
+            if (!(error <= options.tolerance * std::max(1.0, std::abs(expected)))) {
+                if (result.first_mismatch < 0) {
+                    result.first_mismatch = cycle;
+                    result.first_mismatch_joint = i;
+                }
+
+                result.mismatches++;
+            }
+
+            if (!(error <= result.max_error)) {
+                result.max_error = error;
+            }
+        }
+
+        time += period;
+    }
+
+    controller->stopping(time);
+
+    std::sort(latencies.begin(), latencies.end());
+    result.ns_per_cycle = latencies.empty() ? 0.0 : total_latency / latencies.size();
+    result.ns_p99 = latencies.empty() ? 0.0 : percentile(latencies, 0.99);
+    result.allocations_per_cycle = latencies.empty() ? 0.0 : static_cast<double>(allocations) / latencies.size();
+
+    return true;
+}
+
+} // namespace
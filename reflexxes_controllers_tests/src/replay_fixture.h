@@ -0,0 +1,141 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef REFLEXXES_CONTROLLERS_TESTS_REPLAY_FIXTURE_H
+#define REFLEXXES_CONTROLLERS_TESTS_REPLAY_FIXTURE_H
+
+/**
+  Recorded scenario of one controller, replayed to check that its commands
+  did not change
+
+  recordFixture() runs a controller in closed loop with the FakeRobot and
+  the scripted CommandStream on a simulated clock. Every cycle it stores the
+  joint state handed to update() and the command it wrote. replayFixture()
+  runs the controller again in open loop: before each update() the joint
+  state is set to the recorded one and the recorded command messages are
+  delivered in the same cycles. Then the command written by update() is
+  compared with the recorded one, so a deviation does not grow over the
+  following cycles. The replay reports its execution time and allocations
+  per cycle as well.
+
+  Only specs which are deterministic can be replayed. The controller
+  parameters are the ones of setControllerParameters(), the robot
+  description is stored in the fixture.
+
+  Fixture files are little endian. They start with a ReplayFileHeader,
+  followed by these strings, each a uint32 length and the characters:
+  the controller type, the robot description and the joint names. Next
+  come the commands, each a uint32 cycle, a uint32 size and the serialized
+  message. The file ends with the cycles, each REPLAY_VALUES_PER_JOINT
+  doubles per joint.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <ros/time.h>
+
+#include "controller_harness.h"
+
+namespace reflexxes_controllers_tests {
+
+//! Layout of the start of a fixture file
+struct ReplayFileHeader {
+    char magic[8];                     //* "RFXRPLY"
+    boost::uint32_t version;
+    boost::uint32_t n_joints;
+    boost::uint32_t values_per_joint;  //* REPLAY_VALUES_PER_JOINT
+    boost::uint32_t rml_rate_divisor;
+    boost::uint64_t n_commands;
+    boost::uint64_t n_cycles;
+    boost::int64_t start_ns;           //* simulated time of the first cycle
+    double sampling_resolution;        //* simulated control period in seconds
+};
+
+/**
+  Values of each joint in a cycle, in this order: measured position,
+  velocity and effort given to update(), and the command it wrote.
+*/
+const size_t REPLAY_VALUES_PER_JOINT = 4;
+
+struct ReplayFixture {
+    std::string type;         //* controller spec the fixture was recorded with
+    std::string description;  //* robot description
+    std::vector<std::string> joint_names;
+    double sampling_resolution;
+    int rml_rate_divisor;
+    ros::Time start;
+    std::vector<RecordedCommand> commands;  //* in the order they were delivered
+    size_t n_cycles;
+    std::vector<double> values;             //* cycle-major, REPLAY_VALUES_PER_JOINT per joint
+
+    ReplayFixture();
+
+    double *cycle(size_t index) {
+        return &values[index * joint_names.size() * REPLAY_VALUES_PER_JOINT];
+    }
+
+    const double *cycle(size_t index) const {
+        return &values[index * joint_names.size() * REPLAY_VALUES_PER_JOINT];
+    }
+
+    //! Write the fixture to path, false on failure
+    bool write(const std::string &path) const;
+
+    //! Read the fixture from path, false if it can not be read
+    bool read(const std::string &path);
+};
+
+struct RecordOptions {
+    int cycles;
+    double sampling_resolution;
+    int rml_rate_divisor;
+};
+
+struct ReplayOptions {
+    std::string type;  //* plugin type to replay with, e.g. a fixed-size variant (default: the recorded one)
+    double tolerance;  //* largest deviation of a command, relative to its magnitude if that exceeds 1
+};
+
+struct ReplayResult {
+    std::string type;
+    size_t n_joints;
+    size_t cycles;
+    size_t mismatches;         //* commands outside the tolerance
+    double max_error;          //* largest deviation of a command
+    long first_mismatch;       //* cycle of the first mismatch, -1 if there was none
+    size_t first_mismatch_joint;
+    double ns_per_cycle;       //* mean execution time of update()
+    double ns_p99;             //* 99th percentile of the execution time of update()
+    double allocations_per_cycle;
+    size_t allocating_cycles;
+};
+
+//! Record a fixture of spec with n_joints joints, false on failure
+bool recordFixture(ControllerLoader &loader, const ControllerSpec &spec, size_t n_joints,
+                   const RecordOptions &options, ReplayFixture &fixture);
+
+//! Replay a fixture, false if it could not be replayed. Mismatches are reported in result.
+bool replayFixture(ControllerLoader &loader, const ReplayFixture &fixture, const ReplayOptions &options,
+                   ReplayResult &result);
+
+} // namespace
+
+#endif
@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+/**
+  Replay regression tests of the reflexxes controllers
+
+  RecordedFixtures replays every fixture in ~fixture_dir, recorded with the
+  controller_replay node on a reference build, and fails if a command
+  deviates by more than ~tolerance or if there are no fixtures.
+  RecordAndReplay records a short fixture of every deterministic controller,
+  writes and reads it back and replays it with the recorded type and its
+  fixed-size variant, which must reproduce every command exactly.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+
+#include "replay_fixture.h"
+
+using namespace reflexxes_controllers_tests;
+
+namespace {
+
+ControllerLoader *loader = NULL;
+
+void expectMatch(const std::string &name, const ReplayResult &result) {
+    EXPECT_EQ(0u, result.mismatches)
+            << name << " replayed with " << result.type << ": the first deviation is in cycle "
+            << result.first_mismatch << " on joint " << result.first_mismatch_joint
+            << ", max error " << result.max_error;
+
+    ROS_INFO("%s replayed with %s: %.0f ns/cycle (p99 %.0f ns), %.3f allocations/cycle (%zu cycles)",
+             name.c_str(), result.type.c_str(), result.ns_per_cycle, result.ns_p99, result.allocations_per_cycle,
+             result.allocating_cycles);
+}
+
+} // namespace
+
+TEST(ControllerReplay, RecordedFixtures) {
+    ros::NodeHandle pnh("~");
+    std::string fixture_dir;
+    double tolerance;
+    pnh.param("fixture_dir", fixture_dir, std::string());
+    pnh.param("tolerance", tolerance, 1e-9);
+
+    std::vector<std::string> paths;
+    boost::system::error_code error;
+
+    for (boost::filesystem::directory_iterator it(fixture_dir, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() == ".bin") {
+            paths.push_back(it->path().string());
+        }
+    }
+
+    // A missing fixture must not pass as an unchanged controller
+    if (paths.empty()) {
+        FAIL() << "No replay fixtures found in '" << fixture_dir
+               << "', record them with the controller_replay node on the reference build.";
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    for (size_t p = 0; p < paths.size(); p++) {
+        ReplayFixture fixture;
+        ASSERT_TRUE(fixture.read(paths[p])) << paths[p];
+
+        ReplayOptions options;
+        options.tolerance = tolerance;
+
+        ReplayResult result;
+        ASSERT_TRUE(replayFixture(*loader, fixture, options, result)) << paths[p];
+        expectMatch(paths[p], result);
+    }
+}
+
+TEST(ControllerReplay, RecordAndReplay) {
+    const size_t n_joints = 7;
+
+    RecordOptions record_options;
+    record_options.cycles = 5000;
+    record_options.sampling_resolution = 0.001;
+    record_options.rml_rate_divisor = 1;
+
+    boost::filesystem::path path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("replay_%%%%%%%%.bin");
+
+    for (size_t i = 0; i < N_CONTROLLER_SPECS; i++) {
+        const ControllerSpec &spec = CONTROLLER_SPECS[i];
+
+        if (!spec.deterministic) {
+            continue;
+        }
+
+        ReplayFixture recorded, fixture;
+        ASSERT_TRUE(recordFixture(*loader, spec, n_joints, record_options, recorded)) << spec.type;
+        ASSERT_TRUE(recorded.write(path.string())) << spec.type;
+        ASSERT_TRUE(fixture.read(path.string())) << spec.type;
+        boost::filesystem::remove(path);
+
+        ASSERT_EQ(recorded.n_cycles, fixture.n_cycles);
+        ASSERT_EQ(recorded.commands.size(), fixture.commands.size());
+        EXPECT_FALSE(fixture.commands.empty()) << spec.type;
+        EXPECT_TRUE(recorded.values == fixture.values) << spec.type;
+
+        // The same build reproduces every command exactly, with dynamic and fixed-size storage
+        ReplayOptions options;
+        options.tolerance = 0.0;
+
+        ReplayResult result;
+        ASSERT_TRUE(replayFixture(*loader, fixture, options, result)) << spec.type;
+        expectMatch(spec.type, result);
+
+        options.type = std::string(spec.type) + "7DOF";
+        ASSERT_TRUE(replayFixture(*loader, fixture, options, result)) << options.type;
+        expectMatch(spec.type, result);
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "controller_replay_test");
+
+    ControllerLoader controller_loader("controller_interface", "controller_interface::ControllerBase");
+    loader = &controller_loader;
+
+    return RUN_ALL_TESTS();
+}
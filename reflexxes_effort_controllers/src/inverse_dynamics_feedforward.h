@@ -0,0 +1,207 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef EFFORT_CONTROLLERS_INVERSE_DYNAMICS_FEEDFORWARD_H
+#define EFFORT_CONTROLLERS_INVERSE_DYNAMICS_FEEDFORWARD_H
+
+/**
+  @class reflexxes_effort_controllers::InverseDynamicsFeedforward
+  @brief Inverse dynamics efforts of the desired state
+
+  Computes the efforts the desired positions, velocities and accelerations
+  require with KDL::ChainIdSolver_RNE on the chain between root_link and
+  tip_link, so that the PID loops only have to correct the model error.
+  Every moving joint of the chain must be controlled, controlled joints
+  outside of the chain get no feedforward.
+
+  The chain, solver and joint arrays are allocated in init(). The efforts
+  are recomputed every rate_divisor cycles and held in between.
+
+  @section ROS ROS interface
+
+  @param feedforward/enabled Add the inverse dynamics efforts to the PID commands (default: false).
+  @param feedforward/root_link First link of the chain, fixed in the world.
+  @param feedforward/tip_link Last link of the chain.
+  @param feedforward/gravity Gravity in the root_link frame (default: [0, 0, -9.81]).
+  @param feedforward/rate_divisor Number of cycles between two recomputations (default: 1).
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <kdl/chainidsolver_recursive_newton_euler.hpp>
+
+#include <reflexxes_controllers_common/robot_model_cache.h>
+
+namespace reflexxes_effort_controllers
+{
+
+  class InverseDynamicsFeedforward
+  {
+
+  public:
+    InverseDynamicsFeedforward()
+      : enabled_(false),
+        rate_divisor_(1),
+        cycles_(0)
+    {}
+
+    bool init(ros::NodeHandle &nh, const reflexxes_controllers_common::RobotModel &model,
+        const std::vector<std::string> &joint_names)
+    {
+      ros::NodeHandle ff_nh(nh, "feedforward");
+      ff_nh.param("enabled", enabled_, false);
+      efforts_.assign(joint_names.size(), 0.0);
+
+      if (!enabled_) {
+        return true;
+      }
+
+      std::string root_link, tip_link;
+      if (!ff_nh.getParam("root_link", root_link) || !ff_nh.getParam("tip_link", tip_link)) {
+        ROS_ERROR("No 'feedforward/root_link' and 'feedforward/tip_link' parameters given (namespace: %s)",
+            nh.getNamespace().c_str());
+        return false;
+      }
+
+      chain_ = model.chain(root_link, tip_link);
+      if (!chain_) {
+        ROS_ERROR("No chain from '%s' to '%s' for the feedforward (namespace: %s)",
+            root_link.c_str(), tip_link.c_str(), nh.getNamespace().c_str());
+        return false;
+      }
+
+      std::vector<double> gravity;
+      ff_nh.param("gravity", gravity, std::vector<double>());
+      if (gravity.empty()) {
+        gravity.push_back(0.0);
+        gravity.push_back(0.0);
+        gravity.push_back(-9.81);
+      }
+
+      if (gravity.size() != 3) {
+        ROS_ERROR("The 'feedforward/gravity' parameter must have 3 elements (namespace: %s)",
+            nh.getNamespace().c_str());
+        return false;
+      }
+
+      ff_nh.param("rate_divisor", rate_divisor_, 1);
+      if (rate_divisor_ < 1) {
+        ROS_ERROR("The 'feedforward/rate_divisor' parameter must be at least 1 (namespace: %s)",
+            nh.getNamespace().c_str());
+        return false;
+      }
+
+      // Find the controlled joint of each moving joint of the chain
+      const KDL::Chain &chain = chain_->chain;
+      joint_indices_.clear();
+
+      for(unsigned int s=0; s<chain.getNrOfSegments(); s++) {
+        const KDL::Joint &joint = chain.getSegment(s).getJoint();
+        if (joint.getType() == KDL::Joint::None) {
+          continue;
+        }
+
+        std::vector<std::string>::const_iterator it =
+          std::find(joint_names.begin(), joint_names.end(), joint.getName());
+        if (it == joint_names.end()) {
+          ROS_ERROR("Joint '%s' of the feedforward chain is not controlled (namespace: %s)",
+              joint.getName().c_str(), nh.getNamespace().c_str());
+          return false;
+        }
+
+        joint_indices_.push_back(it - joint_names.begin());
+      }
+
+      // Preallocate the solver and its arguments
+      const unsigned int n_chain_joints = chain.getNrOfJoints();
+      q_.resize(n_chain_joints);
+      qdot_.resize(n_chain_joints);
+      qdotdot_.resize(n_chain_joints);
+      torques_.resize(n_chain_joints);
+      KDL::SetToZero(torques_);
+      external_wrenches_.assign(chain.getNrOfSegments(), KDL::Wrench::Zero());
+
+      solver_.reset(new KDL::ChainIdSolver_RNE(chain, KDL::Vector(gravity[0], gravity[1], gravity[2])));
+
+      return true;
+    }
+
+    bool enabled() const
+    {
+      return enabled_;
+    }
+
+    void starting()
+    {
+      cycles_ = 0;
+      std::fill(efforts_.begin(), efforts_.end(), 0.0);
+    }
+
+    //! RT: recompute the efforts of the desired state if they are due
+    template <class JointValues>
+    void update(const JointValues &positions, const JointValues &velocities,
+        const JointValues &accelerations)
+    {
+      if (cycles_++ % rate_divisor_ != 0) {
+        return;
+      }
+
+      for(size_t k=0; k<joint_indices_.size(); k++) {
+        q_(k) = positions[joint_indices_[k]];
+        qdot_(k) = velocities[joint_indices_[k]];
+        qdotdot_(k) = accelerations[joint_indices_[k]];
+      }
+
+      // Keep the last efforts if the solver fails
+      if (solver_->CartToJnt(q_, qdot_, qdotdot_, external_wrenches_, torques_) < 0) {
+        return;
+      }
+
+      for(size_t k=0; k<joint_indices_.size(); k++) {
+        efforts_[joint_indices_[k]] = torques_(k);
+      }
+    }
+
+    //! The feedforward effort of joint i, zero if it is disabled
+    double effort(size_t i) const
+    {
+      return efforts_[i];
+    }
+
+  private:
+    bool enabled_;
+    int rate_divisor_;
+    unsigned long cycles_;
+
+    reflexxes_controllers_common::KinematicChainConstPtr chain_;  //* referenced by solver_
+    boost::scoped_ptr<KDL::ChainIdSolver_RNE> solver_;
+    std::vector<size_t> joint_indices_;  //* controlled joint of each chain joint
+
+    KDL::JntArray q_, qdot_, qdotdot_, torques_;
+    KDL::Wrenches external_wrenches_;
+    std::vector<double> efforts_;  //* by controlled joint
+  };
+
+} // namespace
+
+#endif
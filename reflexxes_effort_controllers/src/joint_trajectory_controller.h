@@ -56,107 +56,114 @@
   @class reflexxes_effort_controllers::JointTrajectoryController
   @brief Joint Position Controller
 
-  This class controls positon using a pid loop.
+  This class controls positon using a pid loop. The trajectory is followed
+  by JointTrajectoryControllerCore, the PID loops are run by
+  PidEffortOutput.
+
+  If precompute_trajectory is set, each commanded trajectory is planned and
+  sampled as a whole on a non-realtime thread, and the realtime loop only
+  interpolates the samples. Reflexxes is run online again only if tracking
+  leaves the position tolerances.
+
+  If lookahead_points is positive, points commanded without velocities get
+  via velocities computed from the following points when the trajectory is
+  received, see computeViaVelocities(), so that they are passed through
+  instead of stopping at each of them.
+
+  If splice_trajectories is set, a new trajectory replaces the current one
+  at the current setpoint: its points whose time has passed are skipped,
+  and a command which only repeats the rest of the current trajectory is
+  ignored.
+
+  Commands leaving the position, velocity or acceleration limits are
+  rejected when they arrive, see TrajectoryFeasibilityChecker.
+
+  If feedforward/enabled is set, the inverse dynamics efforts of the
+  desired state are added to the PID efforts, see
+  InverseDynamicsFeedforward, so that lower gains track the trajectory
+  within the position tolerances.
+
+  JointTrajectoryController6DOF and JointTrajectoryController7DOF only
+  accept 6 and 7 joints respectively and keep the joint state in fixed-size
+  storage.
 
   @section ROS ROS interface
 
   @param type Must be "reflexxes_effort_controllers::JointTrajectoryController"
+  (or the "6DOF" / "7DOF" variant)
   @param joint Name of the joint to control.
   @param pid Contains the gains for the PID loop around position.  See: control_toolbox::Pid
+  @param feedforward/enabled Add inverse dynamics efforts to the PID efforts (default: false).
+  @param feedforward/root_link First link of the chain of the inverse dynamics.
+  @param feedforward/tip_link Last link of the chain of the inverse dynamics.
+  @param feedforward/gravity Gravity in the root_link frame (default: [0, 0, -9.81]).
+  @param feedforward/rate_divisor Number of cycles between two computations of the inverse dynamics (default: 1).
+  @param decimation Number of control cycles batched into each state message (default: 10).
+  @param nominal_period Expected period of update() in seconds (default: sampling_resolution).
+  @param period_tolerance Period deviation counted as jitter in seconds (default: 10% of nominal_period).
+  @param rml_rate_divisor Number of servo cycles per sample of the trajectory generator (default: 1).
+  @param speed_scaling Initial speed scaling of the limits, changed by the set_limits service (default: 1).
+  @param max_trajectory_points Largest number of points accepted in a command (default: 2048).
+  @param precompute_trajectory Plan whole trajectories off the realtime thread (default: false).
+  @param precompute_max_duration Longest trajectory that can be precomputed in seconds (default: 30).
+  @param precompute_start_tolerance Largest distance of a precomputed profile start from the setpoint, planned
+  online otherwise (default: 0.01).
+  @param lookahead_points Points looked ahead for via velocities, 0 stops at every point (default: 0).
+  @param splice_trajectories Replace trajectories at the current setpoint and time (default: true).
+  @param segment_timing Keep ("keep"), reject ("reject") or stretch ("scale") segments too short
+  for the joint limits (default: "keep").
+  @param trajectory_pool_size Trajectories in-process planners can fill at once (default: 2).
+  @param preview/enabled Publish a preview after each online plan, see PlanPreviewPublisher (default: false).
 
   Subscribes to:
 
-  - @b command (std_msgs::Float64) : The joint position to achieve.
+  - @b trajectory_command (trajectory_msgs::JointTrajectory) : The trajectory to follow.
+
+  Provides:
+
+  - @b follow_joint_trajectory (control_msgs::FollowJointTrajectory) :
+    The trajectory to follow. Goals are checked against the joint limits and
+    canceled by a newer goal or topic command.
+
+  - TrajectoryCommandPort : found by the controller namespace, commands
+    trajectories from the same process without copying them.
 
 Publishes:
 
-- @b state (control_msgs::JointControllerState) :
-Current state of the controller, including pid error and gains.
+- @b state (reflexxes_controllers_msgs::ControllerStateBatch) :
+Setpoint, position, error, effort, PID and feedforward terms of every joint in each of the
+last decimation control cycles.
+
+- @b plan_preview (reflexxes_controllers_msgs::PlanPreview) :
+Duration and waypoint times of each online plan, if preview/enabled is set.
 
 */
 
-#include <ros/node_handle.h>
-#include <urdf/model.h>
-#include <control_toolbox/pid.h>
-#include <control_toolbox/pid_gains_setter.h>
-#include <boost/scoped_ptr.hpp>
-#include <boost/thread/condition.hpp>
-#include <realtime_tools/realtime_publisher.h>
 #include <hardware_interface/joint_command_interface.h>
-#include <controller_interface/controller.h>
-#include <control_msgs/JointControllerState.h>
-#include <std_msgs/Float64.h>
-#include <control_msgs/JointControllerState.h>
-#include <realtime_tools/realtime_buffer.h>
 
-#include <trajectory_msgs/JointTrajectory.h>
+#include <reflexxes_controllers_common/joint_trajectory_controller_core.h>
 
-#include <ReflexxesAPI.h>
-#include <RMLPositionFlags.h>
-#include <RMLPositionInputParameters.h>
-#include <RMLPositionOutputParameters.h>
+#include "pid_effort_output.h"
 
 namespace reflexxes_effort_controllers
 {
 
-  class JointTrajectoryController: public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  template <size_t DOF>
+  class BasicJointTrajectoryController: public reflexxes_controllers_common::JointTrajectoryControllerCore<
+      hardware_interface::EffortJointInterface, PidEffortOutput, DOF>
   {
 
   public:
-    JointTrajectoryController();
-    ~JointTrajectoryController();
-
-  public:
-    bool init(hardware_interface::EffortJointInterface *robot, ros::NodeHandle &n);
-    void starting(const ros::Time& time);
-    void stopping(const ros::Time& time) { };
-    void update(const ros::Time& time, const ros::Duration& period);
-
-  public:
-    /**< Last commanded position. */
-    realtime_tools::RealtimeBuffer<trajectory_msgs::JointTrajectory> trajectory_command_buffer_; 
-
-    size_t n_joints_;
-    std::vector<std::string> joint_names_;
-    std::vector< boost::shared_ptr<control_toolbox::Pid> > pids_;
-    std::vector<double> position_tolerances_;
-    std::vector<double> max_accelerations_;
-    std::vector<double> max_jerks_;
-    std::vector<double> commanded_efforts_;
-    std::vector<hardware_interface::JointHandle> joints_;
-    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
-
-    size_t point_index_;
-    ros::Time commanded_start_time_;
-
-  private:
-    ros::NodeHandle nh_;
-    int loop_count_;
-    int decimation_;
-
-    void rml_debug(const ros::console::levels::Level level);
-
-    //! Trajectory Generator
-    boost::shared_ptr<ReflexxesAPI> rml_;
-    boost::shared_ptr<RMLPositionInputParameters> rml_in_;
-    boost::shared_ptr<RMLPositionOutputParameters> rml_out_;
-    RMLPositionFlags rml_flags_;
-    ros::Time traj_start_time_;
-
-    //! Trajectory parameters
-    double sampling_resolution_;
-    bool new_reference_;
-    bool recompute_trajectory_;
-
-    boost::scoped_ptr<realtime_tools::RealtimePublisher<control_msgs::JointControllerState> > 
-      controller_state_publisher_ ;
-
-    // Command subscriber
-    ros::Subscriber trajectory_command_sub_;
-    void trajectoryCommandCB(const trajectory_msgs::JointTrajectoryConstPtr& msg);
-    void setTrajectoryCommand(const trajectory_msgs::JointTrajectoryConstPtr& msg);
+    BasicJointTrajectoryController()
+      : reflexxes_controllers_common::JointTrajectoryControllerCore<
+          hardware_interface::EffortJointInterface, PidEffortOutput, DOF>("JointTrajectoryController")
+    {}
   };
 
+  typedef BasicJointTrajectoryController<reflexxes_controllers_common::DYNAMIC_DOF> JointTrajectoryController;
+  typedef BasicJointTrajectoryController<6> JointTrajectoryController6DOF;
+  typedef BasicJointTrajectoryController<7> JointTrajectoryController7DOF;
+
 } // namespace
 
 #endif
@@ -0,0 +1,201 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef EFFORT_CONTROLLERS_PID_EFFORT_OUTPUT_H
+#define EFFORT_CONTROLLERS_PID_EFFORT_OUTPUT_H
+
+/**
+  @class reflexxes_effort_controllers::PidEffortOutput
+  @brief CommandOutput of ReflexxesControllerCore writing effort commands
+
+  Each joint tracks the desired state with a PID loop around position, the
+  efforts are set to zero if Reflexxes failed. The inverse dynamics efforts
+  of the desired state are added to the PID commands if the feedforward is
+  enabled, see InverseDynamicsFeedforward.
+
+  @section ROS ROS interface
+
+  @param joints/NAME/pid Contains the gains for the PID loop around position.  See: control_toolbox::Pid
+  @param feedforward/enabled Add the inverse dynamics efforts of the chain feedforward/root_link
+  to feedforward/tip_link (default: false).
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <urdf/model.h>
+#include <angles/angles.h>
+#include <control_toolbox/pid.h>
+#include <hardware_interface/joint_command_interface.h>
+
+#include <reflexxes_controllers_common/controller_state_publisher.h>
+#include <reflexxes_controllers_common/cycle_timing.h>
+#include <reflexxes_controllers_common/robot_model_cache.h>
+
+#include "inverse_dynamics_feedforward.h"
+
+namespace reflexxes_effort_controllers
+{
+
+  class PidEffortOutput
+  {
+
+  public:
+    bool init(ros::NodeHandle &nh, const reflexxes_controllers_common::RobotModel &model,
+        const std::vector<std::string> &joint_names,
+        const std::vector<boost::shared_ptr<const urdf::Joint> > &urdf_joints)
+    {
+      urdf_joints_ = urdf_joints;
+      pids_.resize(joint_names.size());
+      commanded_efforts_.resize(joint_names.size());
+
+      for(int i=0; i<joint_names.size(); i++)
+      {
+        // Initialize PID from rosparam
+        ros::NodeHandle joint_nh(nh, "joints/"+joint_names[i]);
+        pids_[i].reset(new control_toolbox::Pid());
+        if (!pids_[i]->init(ros::NodeHandle(joint_nh, "pid")))
+        {
+          ROS_WARN_STREAM_NAMED("jtc","Failed to initialize PID from rosparam");
+          return false;
+        }
+      }
+
+      // Build the inverse dynamics solver
+      if (!feedforward_.init(nh, model, joint_names)) {
+        return false;
+      }
+
+      return true;
+    }
+
+    bool effortTerms() const
+    {
+      return true;
+    }
+
+    void starting()
+    {
+      // Reset PID integrator and effort commands
+      for(int i=0; i<pids_.size(); i++) {
+        pids_[i]->reset();
+        commanded_efforts_[i] = 0.0;
+      }
+
+      feedforward_.starting();
+    }
+
+    //! RT: command the efforts tracking the desired state
+    template <class JointHandles, class JointValues>
+    void write(JointHandles &joints,
+        const JointValues &positions, const JointValues &velocities,
+        const JointValues &accelerations, bool valid, const ros::Duration &period,
+        reflexxes_controllers_common::ControllerStatePublisher &state,
+        reflexxes_controllers_common::CycleTiming &timing)
+    {
+      // Compute the efforts the desired state requires
+      if (feedforward_.enabled()) {
+        timing.start(reflexxes_controllers_common::PHASE_FEEDFORWARD);
+        feedforward_.update(positions, velocities, accelerations);
+        timing.stop(reflexxes_controllers_common::PHASE_FEEDFORWARD);
+      }
+
+      // Apply joint-PIDs
+      timing.start(reflexxes_controllers_common::PHASE_PID);
+      for(int i=0; i<joints.size(); i++) {
+        // Convenience variables
+        double pos_actual = joints[i].getPosition(),
+               vel_actual = joints[i].getVelocity();
+
+        double pos_target = positions[i];
+        double vel_target = velocities[i];
+        double pos_error;
+        double vel_error;
+
+        // Compute position error between the actual and the target state
+        switch(urdf_joints_[i]->type) {
+
+          // Revolute joint with limits
+          case urdf::Joint::REVOLUTE:
+            angles::shortest_angular_distance_with_limits(
+                pos_actual,
+                pos_target,
+                urdf_joints_[i]->limits->lower,
+                urdf_joints_[i]->limits->upper,
+                pos_error);
+            break;
+
+            // Continuous joint with no limits
+          case urdf::Joint::CONTINUOUS:
+            pos_error = angles::shortest_angular_distance(
+                pos_actual,
+                pos_target);
+            break;
+
+            // Prismatic joint types
+          default:
+            pos_error = pos_target - pos_actual;
+            break;
+        };
+
+        // Compute velocity error between the actual and the target state
+        vel_error = vel_target - vel_actual;
+
+        // Set the PID error and compute the PID command with nonuniform time
+        // step size, on top of the feedforward
+        commanded_efforts_[i] = pids_[i]->computeCommand(pos_error, vel_error, period)
+          + feedforward_.effort(i);
+
+        state.setJoint(i, pos_target, pos_actual, pos_error);
+      }
+      timing.stop(reflexxes_controllers_common::PHASE_PID);
+
+      // Setting effort commands to zero if Reflexxes failed
+      if(!valid) {
+        std::fill(commanded_efforts_.begin(), commanded_efforts_.end(), 0.0);
+      }
+
+      // Set the lower-level commands
+      for(int i=0; i<joints.size(); i++) {
+        // Set the command
+        joints[i].setCommand(commanded_efforts_[i]);
+
+        // Record the command along with the PID and feedforward terms that produced it
+        double p_error, i_error, d_error, p_gain, i_gain, d_gain, i_max, i_min;
+        pids_[i]->getCurrentPIDErrors(&p_error, &i_error, &d_error);
+        pids_[i]->getGains(p_gain, i_gain, d_gain, i_max, i_min);
+        state.setEffort(i, commanded_efforts_[i],
+            p_gain*p_error, std::max(i_min, std::min(i_max, i_gain*i_error)), d_gain*d_error,
+            feedforward_.effort(i));
+      }
+    }
+
+  private:
+    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
+    std::vector< boost::shared_ptr<control_toolbox::Pid> > pids_;
+    std::vector<double> commanded_efforts_;
+    InverseDynamicsFeedforward feedforward_;
+  };
+
+} // namespace
+
+#endif
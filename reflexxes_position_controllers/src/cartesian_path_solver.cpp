@@ -0,0 +1,222 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include "cartesian_path_solver.h"
+
+#include <algorithm>
+#include <boost/thread/lock_guard.hpp>
+#include <kdl_conversions/kdl_msg.h>
+#include <ros/console.h>
+
+namespace reflexxes_position_controllers {
+
+CartesianPathSolver::CartesianPathSolver()
+    : max_joint_step_(0.5),
+      next_chunk_(0),
+      pending_chunks_(0),
+      shutdown_(false)
+{}
+
+CartesianPathSolver::~CartesianPathSolver() {
+    stop();
+}
+
+bool CartesianPathSolver::init(const reflexxes_controllers_common::KinematicChain &chain,
+                               const std::vector<std::string> &joint_names, int n_threads, double max_joint_step) {
+    if (n_threads < 1) {
+        ROS_ERROR("At least one IK thread is needed to solve Cartesian paths.");
+        return false;
+    }
+
+    joint_names_ = joint_names;
+    max_joint_step_ = max_joint_step;
+    seed_.resize(joint_names.size());
+
+    // trac_ik is not thread safe, every worker gets its own solver of the shared chain
+    for (int t = 0; t < n_threads; t++) {
+        boost::shared_ptr<Worker> worker(new Worker);
+        worker->solver.reset(new TRAC_IK::TRAC_IK(chain.chain, chain.lower_limits, chain.upper_limits));
+        workers_.push_back(worker);
+    }
+
+    for (size_t t = 0; t < workers_.size(); t++) {
+        workers_[t]->thread = boost::thread(&CartesianPathSolver::work, this, t);
+    }
+
+    return true;
+}
+
+void CartesianPathSolver::stop() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+
+    work_condition_.notify_all();
+
+    for (size_t t = 0; t < workers_.size(); t++) {
+        if (workers_[t]->thread.joinable())
+            workers_[t]->thread.join();
+    }
+}
+
+size_t CartesianPathSolver::chunkEnd(size_t chunk) const {
+    return chunk + 1 < chunk_begins_.size() ? chunk_begins_[chunk + 1] : targets_.size();
+}
+
+size_t CartesianPathSolver::solveRange(TRAC_IK::TRAC_IK &solver, size_t begin, size_t end,
+                                       const KDL::JntArray &seed) {
+    for (size_t k = begin; k < end; k++) {
+        const KDL::JntArray &waypoint_seed = k == begin ? seed : solutions_[k - 1];
+
+        if (solver.CartToJnt(waypoint_seed, targets_[k], solutions_[k]) < 0)
+            return k;
+    }
+
+    return end;
+}
+
+void CartesianPathSolver::work(size_t worker) {
+    TRAC_IK::TRAC_IK &solver = *workers_[worker]->solver;
+
+    while (true) {
+        size_t chunk;
+
+        // Wait for a chunk of the current path
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+
+            while (next_chunk_ >= chunk_begins_.size() && !shutdown_)
+                work_condition_.wait(lock);
+
+            if (shutdown_)
+                return;
+
+            chunk = next_chunk_++;
+        }
+
+        size_t failure = solveRange(solver, chunk_begins_[chunk], chunkEnd(chunk), seed_);
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            chunk_failures_[chunk] = failure;
+            pending_chunks_--;
+        }
+
+        done_condition_.notify_one();
+    }
+}
+
+bool CartesianPathSolver::solve(const reflexxes_controllers_msgs::CartesianTrajectory &path,
+                                const KDL::JntArray &seed, trajectory_msgs::JointTrajectory &trajectory) {
+    size_t n_points = path.points.size();
+    size_t n_joints = joint_names_.size();
+
+    if (n_points == 0) {
+        ROS_ERROR("Cartesian path has no waypoints.");
+        return false;
+    }
+
+    for (size_t k = 0; k < n_points; k++) {
+        double time = path.points[k].time_from_start.toSec();
+
+        if (time < 0 || (k > 0 && time <= path.points[k - 1].time_from_start.toSec())) {
+            ROS_ERROR("Times from start of the Cartesian path are not increasing at waypoint %zu.", k);
+            return false;
+        }
+    }
+
+    // Split the path into one chunk per worker and hand them to the pool
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+
+        targets_.resize(n_points);
+        solutions_.resize(n_points, KDL::JntArray(n_joints));
+
+        for (size_t k = 0; k < n_points; k++)
+            tf::poseMsgToKDL(path.points[k].pose, targets_[k]);
+
+        seed_.data = seed.data;
+
+        size_t n_chunks = std::min(workers_.size(), n_points);
+        chunk_begins_.resize(n_chunks);
+        chunk_failures_.resize(n_chunks);
+
+        for (size_t c = 0; c < n_chunks; c++)
+            chunk_begins_[c] = c * n_points / n_chunks;
+
+        next_chunk_ = 0;
+        pending_chunks_ = n_chunks;
+        work_condition_.notify_all();
+
+        while (pending_chunks_ > 0)
+            done_condition_.wait(lock);
+    }
+
+    // Chain the chunks, the pool is idle now
+    TRAC_IK::TRAC_IK &solver = *workers_[0]->solver;
+
+    for (size_t c = 0; c < chunk_begins_.size(); c++) {
+        size_t begin = chunk_begins_[c];
+        size_t end = chunkEnd(c);
+        bool resolve = chunk_failures_[c] != end;
+
+        if (c > 0 && !resolve) {
+            double step = (solutions_[begin].data - solutions_[begin - 1].data).cwiseAbs().maxCoeff();
+            resolve = step > max_joint_step_;
+        }
+
+        if (resolve && c > 0) {
+            chunk_failures_[c] = solveRange(solver, begin, end, solutions_[begin - 1]);
+        }
+
+        if (chunk_failures_[c] != end) {
+            ROS_ERROR("trac_ik found no solution for waypoint %zu of the Cartesian path.", chunk_failures_[c]);
+            return false;
+        }
+    }
+
+    // Convert to a joint trajectory, the velocities of the inner waypoints are central differences
+    trajectory.header = path.header;
+    trajectory.joint_names = joint_names_;
+    trajectory.points.resize(n_points);
+
+    for (size_t k = 0; k < n_points; k++) {
+        trajectory_msgs::JointTrajectoryPoint &point = trajectory.points[k];
+        point.positions.resize(n_joints);
+        point.velocities.assign(n_joints, 0.0);
+        point.accelerations.clear();
+        point.time_from_start = path.points[k].time_from_start;
+
+        const KDL::JntArray &previous = k > 0 ? solutions_[k - 1] : seed_;
+        double previous_time = k > 0 ? path.points[k - 1].time_from_start.toSec() : 0.0;
+
+        for (size_t i = 0; i < n_joints; i++) {
+            point.positions[i] = solutions_[k](i);
+
+            if (k + 1 < n_points) {
+                point.velocities[i] = (solutions_[k + 1](i) - previous(i)) /
+                                      (path.points[k + 1].time_from_start.toSec() - previous_time);
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
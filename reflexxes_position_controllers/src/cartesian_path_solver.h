@@ -0,0 +1,105 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef POSITION_CONTROLLERS_CARTESIAN_PATH_SOLVER_H
+#define POSITION_CONTROLLERS_CARTESIAN_PATH_SOLVER_H
+
+/**
+  @class reflexxes_position_controllers::CartesianPathSolver
+  @brief Parallel inverse kinematics of all waypoints of a Cartesian path
+
+  The waypoints are split into contiguous chunks which are solved by a pool
+  of threads, each with its own trac_ik solver. Within a chunk every
+  waypoint is seeded from the solution of the previous one, the first
+  waypoint of each chunk from the seed of the whole path. Once all chunks
+  are solved, a chunk whose first solution failed or jumps away from the
+  last solution of the previous chunk by more than max_joint_step is solved
+  again sequentially, seeded from its neighbour.
+
+  The joint velocities at the waypoints are estimated by central
+  differences, the path ends at rest. solve() is not realtime safe and must
+  not be called from more than one thread at a time.
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <trac_ik/trac_ik.hpp>
+#include <trajectory_msgs/JointTrajectory.h>
+
+#include <reflexxes_controllers_msgs/CartesianTrajectory.h>
+#include <reflexxes_controllers_common/robot_model_cache.h>
+
+namespace reflexxes_position_controllers {
+
+class CartesianPathSolver {
+
+public:
+    CartesianPathSolver();
+    ~CartesianPathSolver();
+
+    //! Create n_threads solvers for chain and start the pool
+    bool init(const reflexxes_controllers_common::KinematicChain &chain,
+              const std::vector<std::string> &joint_names, int n_threads, double max_joint_step);
+
+    //! Solve every waypoint of path starting from seed, returns false if any waypoint has no solution
+    bool solve(const reflexxes_controllers_msgs::CartesianTrajectory &path, const KDL::JntArray &seed,
+               trajectory_msgs::JointTrajectory &trajectory);
+
+    //! Stop the pool, waits for the chunks being solved
+    void stop();
+
+private:
+    struct Worker {
+        boost::shared_ptr<TRAC_IK::TRAC_IK> solver;
+        boost::thread thread;
+    };
+
+    std::vector<std::string> joint_names_;
+    double max_joint_step_;
+    std::vector<boost::shared_ptr<Worker> > workers_;
+
+    //! Current job, the chunk counters are guarded by mutex_
+    boost::mutex mutex_;
+    boost::condition_variable work_condition_;
+    boost::condition_variable done_condition_;
+    std::vector<KDL::Frame> targets_;
+    std::vector<KDL::JntArray> solutions_;
+    std::vector<size_t> chunk_begins_;     //* one past the end is the begin of the next chunk
+    std::vector<size_t> chunk_failures_;   //* first failed waypoint of each chunk, or its end
+    KDL::JntArray seed_;
+    size_t next_chunk_;
+    size_t pending_chunks_;
+    bool shutdown_;
+
+    void work(size_t worker);
+
+    //! Solve the waypoints [begin, end) in sequence, returns the first failed waypoint or end
+    size_t solveRange(TRAC_IK::TRAC_IK &solver, size_t begin, size_t end, const KDL::JntArray &seed);
+
+    size_t chunkEnd(size_t chunk) const;
+};
+
+} // namespace
+
+#endif
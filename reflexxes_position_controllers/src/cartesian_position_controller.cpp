@@ -50,410 +50,467 @@
  *********************************************************************/
 
 #include "cartesian_position_controller.h"
-#include <angles/angles.h>
 #include <pluginlib/class_list_macros.h>
-#include <trajectory_msgs/JointTrajectory.h>
 #include <kdl_conversions/kdl_msg.h>
-#include <sstream>
 
 namespace reflexxes_position_controllers {
 
-CartesianPositionController::CartesianPositionController()
-    : loop_count_(0),
-      decimation_(10),
-      sampling_resolution_(0.001),
-      new_reference_(false),
-      recompute_trajectory_(false)
+template <size_t DOF>
+BasicCartesianPositionController<DOF>::BasicCartesianPositionController()
+    : Core("CartesianPositionController"),
+      ik_request_pending_(false),
+      ik_shutdown_(false),
+      path_request_pending_(false),
+      ik_solve_ns_(0),
+      servo_mode_(false),
+      servo_max_position_error_(0.05),
+      servo_max_orientation_error_(0.2),
+      servo_damping_(0.05),
+      servo_iterations_(3),
+      servo_position_tolerance_(0.0001),
+      servo_orientation_tolerance_(0.001),
+      ik_cache_size_(0),
+      ik_cache_reuse_solution_(true),
+      max_trajectory_points_(2048),
+      path_active_(false)
 {}
 
-CartesianPositionController::~CartesianPositionController() {
+template <size_t DOF>
+BasicCartesianPositionController<DOF>::~BasicCartesianPositionController() {
     trajectory_command_sub_.shutdown();
+    path_command_sub_.shutdown();
+    stopIkWorker();
+    path_solver_.stop();
 }
 
 
-template<class T>
-std::ostream &operator<< (std::ostream &stream, const RMLVector<T> &rml_vec) {
-    stream << "[ ";
+template <size_t DOF>
+bool BasicCartesianPositionController<DOF>::initTarget() {
+    nh_.getParam("root_name", root_name);
+    nh_.getParam("tip_name", tip_name);
 
-    for (int i = 0; i < rml_vec.VectorDimension; i++) {
-        stream << (rml_vec.VecData[i]) << ", ";
+    // Hold the target once it is reached, the tolerance check triggers a recompute if needed
+    rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = RMLPositionFlags::KEEP_TARGET_VELOCITY;
+    rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
+
+    // Init Kinematic solvers from the chain cached with the robot model
+    kinematic_chain_ = this->robot_model_->chain(root_name, tip_name);
+    if (!kinematic_chain_){
+        ROS_ERROR("Could not extract the KDL chain from URDF!");
+        return false;
     }
+    const KDL::Chain &chain = kinematic_chain_->chain;
+    if (chain.getNrOfJoints() != n_joints_){
+        ROS_ERROR("The chain from '%s' to '%s' has %u joints, but %zu joints are controlled!",
+                  root_name.c_str(), tip_name.c_str(), chain.getNrOfJoints(), n_joints_);
+        return false;
+    }
+    tracik_solver.reset(new TRAC_IK::TRAC_IK(chain, kinematic_chain_->lower_limits, kinematic_chain_->upper_limits));
+    fk_solver.reset(new KDL::ChainFkSolverPos_recursive(chain));
 
-    stream << "]";
-    return stream;
-}
+    // Get servo mode parameters
+    nh_.param("servo_mode", servo_mode_, false);
+    nh_.param("servo_max_position_error", servo_max_position_error_, 0.05);
+    nh_.param("servo_max_orientation_error", servo_max_orientation_error_, 0.2);
+    nh_.param("servo_damping", servo_damping_, 0.05);
+    nh_.param("servo_iterations", servo_iterations_, 3);
+    nh_.param("servo_position_tolerance", servo_position_tolerance_, 0.0001);
+    nh_.param("servo_orientation_tolerance", servo_orientation_tolerance_, 0.001);
+
+    if (servo_mode_) {
+        if (servo_iterations_ < 1) {
+            ROS_ERROR("The 'servo_iterations' parameter must be positive (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
 
-void CartesianPositionController::rml_debug(const ros::console::levels::Level level) {
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT NumberOfDOFs: " << rml_in_->NumberOfDOFs);
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MinimumSynchronizationTime: " << rml_in_->MinimumSynchronizationTime);
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT SelectionVector: " << (*rml_in_->SelectionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentPositionVector: " << (*rml_in_->CurrentPositionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentVelocityVector: " << (*rml_in_->CurrentVelocityVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentAccelerationVector: " << (*rml_in_->CurrentAccelerationVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxAccelerationVector: " << (*rml_in_->MaxAccelerationVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxJerkVector: " << (*rml_in_->MaxJerkVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT TargetVelocityVector: " << (*rml_in_->TargetVelocityVector));
-
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxVelocityVector: " << (*rml_in_->MaxVelocityVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT TargetPositionVector: " << (*rml_in_->TargetPositionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT AlternativeTargetVelocityVector: " 
-        << (*rml_in_->AlternativeTargetVelocityVector));
-}
+        // Preallocate the differential IK workspace
+        jac_solver_.reset(new KDL::ChainJntToJacSolver(chain));
+        servo_jacobian_.resize(n_joints_);
+        joint_lower_limits_ = kinematic_chain_->lower_limits;
+        joint_upper_limits_ = kinematic_chain_->upper_limits;
 
+        ROS_INFO("Solving poses within %f m / %f rad differentially (namespace: %s).",
+                 servo_max_position_error_, servo_max_orientation_error_, nh_.getNamespace().c_str());
+    }
+    current_joint_position.resize(n_joints_);
+    target_joint_position.resize(n_joints_);
 
-bool CartesianPositionController::init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n) {
-    // Store nodehandle
-    nh_ = n;
+    // Get IK cache parameters
+    nh_.param("ik_cache_size", ik_cache_size_, 0);
+    nh_.param("ik_cache_reuse_solution", ik_cache_reuse_solution_, true);
 
-    // Get joint names
-    XmlRpc::XmlRpcValue xml_array;
+    if (ik_cache_size_ > 0) {
+        double position_resolution, orientation_resolution, seed_resolution;
+        nh_.param("ik_cache_position_resolution", position_resolution, 0.001);
+        nh_.param("ik_cache_orientation_resolution", orientation_resolution, 0.002);
+        nh_.param("ik_cache_seed_resolution", seed_resolution, 0.5);
 
-    if (!nh_.getParam("joint_names", xml_array)) {
-        ROS_ERROR("No 'joint_names' parameter in controller (namespace '%s')", nh_.getNamespace().c_str());
-        return false;
+        if (position_resolution <= 0 || orientation_resolution <= 0 || seed_resolution < 0) {
+            ROS_ERROR("The IK cache resolutions must be positive (namespace '%s')", nh_.getNamespace().c_str());
+            return false;
+        }
+
+        ik_cache_.init(nh_, ik_cache_size_, position_resolution, orientation_resolution, seed_resolution);
+        ROS_INFO("Caching %d IK solutions (namespace: %s).", ik_cache_size_, nh_.getNamespace().c_str());
     }
 
-    // Make sure it's an array type
-    if (xml_array.getType() != XmlRpc::XmlRpcValue::TypeArray) {
-        ROS_ERROR("The 'joint_names' parameter is not an array (namespace '%s')", nh_.getNamespace().c_str());
+    // Get Cartesian path parameters
+    int ik_threads;
+    double ik_path_max_joint_step;
+    nh_.param("ik_threads", ik_threads, 4);
+    nh_.param("ik_path_max_joint_step", ik_path_max_joint_step, 0.5);
+    nh_.param("max_trajectory_points", max_trajectory_points_, 2048);
+
+    if (max_trajectory_points_ < 1) {
+        ROS_ERROR("The 'max_trajectory_points' parameter must be positive (namespace '%s')", nh_.getNamespace().c_str());
         return false;
     }
 
-    // Get number of joints
-    n_joints_ = xml_array.size();
+    if (!path_solver_.init(*kinematic_chain_, this->joint_names_, ik_threads, ik_path_max_joint_step)) {
+        return false;
+    }
 
-    ROS_INFO_STREAM("Initializing CartesianPositionController with " << n_joints_ << " joints.");
+    path_command_buffer_.init(n_joints_, max_trajectory_points_);
 
-    // Get trajectory sampling resolution
-    if (!nh_.hasParam("sampling_resolution")) {
-        ROS_INFO("No sampling_resolution specified (namespace: %s), using default.", nh_.getNamespace().c_str());
-    }
+    // Preallocate the IK mailboxes and start the IK worker
+    for (size_t i = 0; i < n_joints_; i++)
+        current_joint_position(i) = joints_[i].getPosition();
 
-    nh_.param("sampling_resolution", sampling_resolution_, 0.001);
+    ik_seed_mailbox_.init(current_joint_position);
+    ik_target_mailbox_.init(current_joint_position);
+    ik_thread_ = boost::thread(&BasicCartesianPositionController::ikWorker, this);
 
-    // Create trajectory generator
-    rml_.reset(new ReflexxesAPI(n_joints_, sampling_resolution_));
-    rml_in_.reset(new RMLPositionInputParameters(n_joints_));
-    rml_out_.reset(new RMLPositionOutputParameters(n_joints_));
+    // Create command subscriber
+    trajectory_command_sub_ = nh_.template subscribe<geometry_msgs::PoseStamped>(
+                                  "cartesian_position_command", 1, &BasicCartesianPositionController::trajectoryCommandCB, this);
+    path_command_sub_ = nh_.template subscribe<reflexxes_controllers_msgs::CartesianTrajectory>(
+                            "cartesian_trajectory_command", 1, &BasicCartesianPositionController::pathCommandCB, this);
 
-    // Get urdf
-    urdf::Model urdf;
-    std::string urdf_str;
-    ros::NodeHandle nh;
-    nh.getParam("/robot_description", urdf_str);
-    nh_.getParam("root_name", root_name);
-    nh_.getParam("tip_name", tip_name);
+    return true;
+}
 
-    if (!urdf.initString(urdf_str)) {
-        ROS_ERROR("Failed to parse urdf from '/robot_description' parameter (namespace: %s)", nh.getNamespace().c_str());
-        return false;
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::startTarget(const ros::Time &time) {
+    // Define an initial joint target from the current position, no IK needed
+    for (size_t i = 0; i < n_joints_; i++) {
+        target_joint_position(i) = joints_[i].getPosition();
     }
 
-    // Get individual joint properties from urdf and parameter server
-    joint_names_.resize(n_joints_);
-    joints_.resize(n_joints_);
-    urdf_joints_.resize(n_joints_);
-    position_tolerances_.resize(n_joints_);
-    max_accelerations_.resize(n_joints_);
-    max_jerks_.resize(n_joints_);
-    commanded_positions_.resize(n_joints_);
-    previous_joint_velocity.resize(n_joints_);
-    current_joint_acceleration.resize(n_joints_);
-
-    for (int i = 0; i < n_joints_; i++) {
-        // Get joint name
-        if (xml_array[i].getType() != XmlRpc::XmlRpcValue::TypeString) {
-            ROS_ERROR("The 'joint_names' parameter contains a non-string element (namespace '%s')", nh_.getNamespace().c_str());
-            return false;
-        }
+    // Discard any IK solution or path computed while the controller was stopped
+    ik_target_mailbox_.fetch();
+    path_command_buffer_.initRT().clear();
+    path_active_ = false;
+}
 
-        joint_names_[i] = static_cast<std::string>(xml_array[i]);
+template <size_t DOF>
+int BasicCartesianPositionController<DOF>::updateTarget(const ros::Time &time, const ros::Duration &period) {
+    // Publish the measured joint state, used by the IK worker as seed
+    KDL::JntArray &ik_seed = ik_seed_mailbox_.writeBuffer();
 
-        // Get the joint-namespace nodehandle
-        {
-            ros::NodeHandle joint_nh(nh_, "joints/" + joint_names_[i]);
-            ROS_INFO("Loading joint information for joint '%s' (namespace: %s)", 
-                     joint_names_[i].c_str(), joint_nh.getNamespace().c_str());
-
-            // Get position tolerance
-            if (!joint_nh.hasParam("position_tolerance")) {
-                ROS_INFO("No position_tolerance specified (namespace: %s), using default.",
-                         joint_nh.getNamespace().c_str());
-            }
+    for (size_t i = 0; i < nJoints(); i++)
+        ik_seed(i) = joints_[i].getPosition();
 
-            joint_nh.param("position_tolerance", position_tolerances_[i], 0.1);
+    ik_seed_mailbox_.publish();
 
-            // Get maximum acceleration
-            if (!joint_nh.hasParam("max_acceleration")) {
-                ROS_INFO("No max_acceleration specified (namespace: %s), using default.",
-                         joint_nh.getNamespace().c_str());
-            }
+    // Check for a new path solved by the IK worker
+    bool new_path = path_command_buffer_.readFromRT();
+    const reflexxes_controllers_common::FixedTrajectory &path = path_command_buffer_.trajectory();
 
-            joint_nh.param("max_acceleration", max_accelerations_[i], 1.0);
+    if (new_path) {
+        // Start path immediately if stamp is zero
+        cursor_.start(path, time);
+        path_active_ = !path.empty();
+        timing_.record(reflexxes_controllers_common::PHASE_IK, ik_solve_ns_.load(boost::memory_order_relaxed));
 
-            // Get maximum acceleration
-            if (!joint_nh.hasParam("max_jerk")) {
-                ROS_INFO("No max_jerk specified (namespace: %s), using default.",
-                         joint_nh.getNamespace().c_str());
-            }
+        // Set flag to recompute trajectory
+        recompute_trajectory_ = true;
 
-            joint_nh.param("max_jerk", max_jerks_[i], 1000.0);
-        }
+        logger_.log(reflexxes_controllers_common::EVENT_NEW_REFERENCE, time);
+    }
 
-        // Get ros_control joint handle
-        joints_[i] = robot->getHandle(joint_names_[i]);
+    // Check for a new joint target solved by the IK worker
+    if (ik_target_mailbox_.fetch()) {
+        target_joint_position.data = ik_target_mailbox_.readBuffer().data;
+        timing_.record(reflexxes_controllers_common::PHASE_IK, ik_solve_ns_.load(boost::memory_order_relaxed));
 
-        // Get urdf joint
-        urdf_joints_[i] = urdf.getJoint(joint_names_[i]);
+        // Set flag to recompute trajectory, a single pose aborts the path
+        recompute_trajectory_ = true;
+        path_active_ = false;
 
-        if (!urdf_joints_[i]) {
-            ROS_ERROR("Could not find joint '%s' in urdf", joint_names_[i].c_str());
-            return false;
+        logger_.log(reflexxes_controllers_common::EVENT_NEW_REFERENCE, time);
+    }
+    
+    // Compute RML traj towards the active waypoint of the path, once it started, or the latest joint target
+    if (recompute_trajectory_ && (!path_active_ || cursor_.started(time, period))) {
+        // Update RML input parameters, starting from the estimated state
+        this->setCurrentState();
+
+        for (size_t i = 0; i < nJoints(); i++) {
+            if (path_active_) {
+                rml_in_->TargetPositionVector->VecData[i] = path.positions(cursor_.pointIndex())[i];
+                rml_in_->TargetVelocityVector->VecData[i] = path.velocities(cursor_.pointIndex())[i];
+            } else {
+                rml_in_->TargetPositionVector->VecData[i] = target_joint_position(i);
+                rml_in_->TargetVelocityVector->VecData[i] = 0;
+            }
         }
 
-        // Get RML parameters from URDF
-        rml_in_->MaxVelocityVector->VecData[i] = urdf_joints_[i]->limits->velocity;
-        rml_in_->MaxAccelerationVector->VecData[i] = max_accelerations_[i];
-        rml_in_->MaxJerkVector->VecData[i] = max_jerks_[i];
+        if (path_active_) {
+            // Reach the waypoint at its time from start
+            computeTrajectory(time, cursor_.timeToPoint(path, time));
+        } else {
+            // Skip a couple of frames for visual servoing applications: otherwise the first
+            // position used would be too close to the current one and the robot would not move
+            computeTrajectory(time, (period * 2).toSec());
+        }
     }
+    
+    // Sample the already computed trajectory
+    int rml_result = sampleTrajectory((time - traj_start_time_).toSec());
+    readRMLOutput();
+
+    return rml_result;
+}
 
-    for (int i = 0; i < n_joints_; i++) {
-        rml_in_->SelectionVector->VecData[i] = true;
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::finalStateReached(const ros::Time &time) {
+    if (!path_active_) {
+        return;
     }
 
+    // Move on to the next waypoint, hold the last one as joint target
+    const reflexxes_controllers_common::FixedTrajectory &path = path_command_buffer_.trajectory();
+    cursor_.advance(path);
 
-    if (rml_in_->CheckForValidity()) {
-        ROS_INFO_STREAM("RML INPUT Configuration Valid.");
-        this->rml_debug(ros::console::levels::Debug);
-    } else {
-        ROS_ERROR_STREAM("RML INPUT Configuration Invalid!");
-        this->rml_debug(ros::console::levels::Warn);
-        return false;
+    if (cursor_.complete(path)) {
+        for (size_t i = 0; i < nJoints(); i++)
+            target_joint_position(i) = path.positions(path.size() - 1)[i];
+
+        path_active_ = false;
     }
-    
-    // Init Kinematic solvers
-    tracik_solver.reset(new TRAC_IK::TRAC_IK(root_name, tip_name));
-    KDL::Chain chain;
-    bool chain_parsed = tracik_solver->getKDLChain(chain);
-    if (!chain_parsed){
-        ROS_ERROR("trac_ik could not parse KDL chain from URDF!");
-        return false;
+
+    recompute_trajectory_ = true;
+}
+
+template <size_t DOF>
+size_t BasicCartesianPositionController<DOF>::upcomingWaypoints(const ros::Time &time, double *times,
+                                                                 size_t max_waypoints) {
+    if (!path_active_) {
+        return 0;
     }
-    fk_solver.reset(new KDL::ChainFkSolverPos_recursive(chain));
-    current_joint_position.resize(n_joints_);
-    target_joint_position.resize(n_joints_);
 
-    // Create state publisher
-    // TODO: create state publisher
-    //controller_state_publisher_.reset(
-    //new realtime_tools::RealtimePublisher<control_msgs::JointControllerState>(n, "state", 1));
+    return cursor_.upcomingWaypoints(path_command_buffer_.trajectory(), time, times, max_waypoints);
+}
 
-    // Create command subscriber
-    trajectory_command_sub_ = nh_.subscribe<geometry_msgs::PoseStamped>(
-                                  "cartesian_position_command", 1, &CartesianPositionController::trajectoryCommandCB, this);
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::trajectoryCommandCB(
+    const geometry_msgs::PoseStampedConstPtr &msg) {
+    this->setTrajectoryCommand(msg);
+}
 
-    return true;
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::setTrajectoryCommand(
+    const geometry_msgs::PoseStampedConstPtr &msg) {
+    ROS_DEBUG("Received new command");
+    // Hand the pose over to the IK worker, an unsolved older pose is replaced
+    {
+        boost::lock_guard<boost::mutex> lock(ik_mutex_);
+        ik_request_ = *msg;
+        ik_request_pending_ = true;
+        path_request_pending_ = false;
+    }
+
+    ik_condition_.notify_one();
 }
 
-void CartesianPositionController::starting(const ros::Time &time) {
-    // Define an initial command point from the current position
-    geometry_msgs::PoseStamped initial_point;
-   
-    KDL::JntArray initial_joint_position(n_joints_);
-    KDL::Frame initial_cart_position;
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::pathCommandCB(
+    const reflexxes_controllers_msgs::CartesianTrajectoryConstPtr &msg) {
+    ROS_DEBUG("Received new path command");
+    // Hand the path over to the IK worker, an unsolved older command is replaced
+    {
+        boost::lock_guard<boost::mutex> lock(ik_mutex_);
+        path_request_ = msg;
+        path_request_pending_ = true;
+        ik_request_pending_ = false;
+    }
 
-    for (int i = 0; i < n_joints_; i++) 
-        initial_joint_position(i) = joints_[i].getPosition();
-    
-    fk_solver->JntToCart(initial_joint_position, initial_cart_position);
-    tf::poseKDLToMsg(initial_cart_position, initial_point.pose);
-    
-    trajectory_command_buffer_.initRT(initial_point);
+    ik_condition_.notify_one();
+}
+
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::stopIkWorker() {
+    {
+        boost::lock_guard<boost::mutex> lock(ik_mutex_);
+        ik_shutdown_ = true;
+    }
 
-    // Reset commands
-    for (int i = 0; i < n_joints_; i++) 
-        commanded_positions_[i] = joints_[i].getPosition();
+    ik_condition_.notify_one();
 
-    // Set new reference flag for initial command point
-    new_reference_ = true;
+    if (ik_thread_.joinable())
+        ik_thread_.join();
 }
 
-void CartesianPositionController::update(const ros::Time &time, const ros::Duration &period) {
-    // Read the latest commanded cartesian pose message
-    const geometry_msgs::PoseStamped &commanded_trajectory = *(trajectory_command_buffer_.readFromRT());
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::ikWorker() {
+    geometry_msgs::PoseStamped request;
+    reflexxes_controllers_msgs::CartesianTrajectoryConstPtr path;
+    trajectory_msgs::JointTrajectory path_trajectory;
+    KDL::Frame target_cart_position;
+    KDL::JntArray seed(n_joints_);
+    KDL::JntArray cached_solution(n_joints_);
+    KDL::JntArray solution(n_joints_);
+
+    while (true) {
+        // Wait for a new cartesian command
+        {
+            boost::unique_lock<boost::mutex> lock(ik_mutex_);
 
-    // Check for a new reference
-    if (new_reference_) {
+            while (!ik_request_pending_ && !path_request_pending_ && !ik_shutdown_)
+                ik_condition_.wait(lock);
 
-        // Reset new reference flag
-        new_reference_ = false;
-        // Set flag to recompute trajectory
-        recompute_trajectory_ = true;
+            if (ik_shutdown_)
+                return;
 
-        ROS_DEBUG("Received new reference.");
-    }
-    
-    // Compute acceleration
-    for (int i = 0; i < n_joints_; i++) {
-        current_joint_acceleration(i) = joints_[i].getVelocity() - previous_joint_velocity(i);
-        previous_joint_velocity(i) = joints_[i].getVelocity();
-    }
+            if (path_request_pending_) {
+                path = path_request_;
+                path_request_pending_ = false;
+            } else {
+                path.reset();
+                request = ik_request_;
+                ik_request_pending_ = false;
+            }
+        }
 
-    // Initialize RML result
-    int rml_result = 0;
-
-    // Compute RML traj after the start time and if there are still points in the queue
-    if (recompute_trajectory_) {
-        // Solve inverse kinematics
-        for (int i = 0; i < n_joints_; i++)
-            current_joint_position(i) = joints_[i].getPosition();
-        tf::poseMsgToKDL(commanded_trajectory.pose, target_cart_position);
-        int rc = tracik_solver->CartToJnt(current_joint_position,target_cart_position,target_joint_position);
-        
-        // Compute the trajectory
-        ROS_DEBUG("RML Recomputing trajectory...");
-
-        // Update RML input parameters
-        for (int i = 0; i < n_joints_; i++) {
-            rml_in_->CurrentPositionVector->VecData[i] = joints_[i].getPosition();
-            rml_in_->CurrentVelocityVector->VecData[i] = joints_[i].getVelocity();
-            rml_in_->CurrentAccelerationVector->VecData[i] = current_joint_acceleration(i);
-
-            rml_in_->TargetPositionVector->VecData[i] = target_joint_position(i);
-            rml_in_->TargetVelocityVector->VecData[i] = 0;
-
-            rml_in_->SelectionVector->VecData[i] = true;
+        // Seed from the latest joint state published by the realtime loop
+        ik_seed_mailbox_.fetch();
+        seed.data = ik_seed_mailbox_.readBuffer().data;
+
+        if (path) {
+            solvePath(*path, seed, path_trajectory);
+            continue;
         }
-        
-        ROS_DEBUG_STREAM("Current position: " << std::endl << *(rml_in_->CurrentPositionVector));
-        ROS_DEBUG_STREAM("Target position: " << std::endl << *(rml_in_->TargetPositionVector));
 
-        // Store the traj start time 
-        // (skipping couple of frames for visual servoing applications: otherwise first position used 
-        // would be too close to current one and the robot would not move)
-        traj_start_time_ = time;
+        // Solve inverse kinematics, globally unless the target is close enough for a servo step
+        tf::poseMsgToKDL(request.pose, target_cart_position);
+        int64_t solve_start_ns = reflexxes_controllers_common::monotonicNanoseconds();
+        int rc = 0;
+        bool cached = ik_cache_size_ > 0 && ik_cache_.lookup(target_cart_position, seed, cached_solution);
 
-        // Set desired execution time for this trajectory (definitely > 0)
-        rml_in_->SetMinimumSynchronizationTime((period*2).toSec());
+        if (cached && ik_cache_reuse_solution_) {
+            solution.data = cached_solution.data;
+        } else {
+            // Start from the cached solution if there is one
+            const KDL::JntArray &solver_seed = cached ? cached_solution : seed;
 
-//         ROS_DEBUG_STREAM("RML IN: time: " << rml_in_->GetMinimumSynchronizationTime());
+            if (!servo_mode_ || !servoStep(solver_seed, target_cart_position, solution)) {
+                rc = tracik_solver->CartToJnt(solver_seed, target_cart_position, solution);
+            }
 
-        rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = RMLPositionFlags::KEEP_TARGET_VELOCITY;
-        rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
+            if (rc >= 0 && ik_cache_size_ > 0) {
+                ik_cache_.insert(target_cart_position, seed, solution);
+            }
+        }
 
-        // Compute trajectory
-        rml_result = rml_->RMLPosition(*rml_in_.get(),
-                                       rml_out_.get(),
-                                       rml_flags_);
+        ik_solve_ns_.store(reflexxes_controllers_common::monotonicNanoseconds() - solve_start_ns,
+                           boost::memory_order_relaxed);
 
-        // Disable recompute flag
-        recompute_trajectory_ = false;
+        if (rc < 0) {
+            ROS_WARN("trac_ik found no solution for the commanded pose (error %d), command ignored.", rc);
+            continue;
+        }
+
+        // Hand the joint target over to the realtime loop
+        ik_target_mailbox_.writeBuffer().data = solution.data;
+        ik_target_mailbox_.publish();
     }
-    
-    // Sample the already computed trajectory
-    rml_result = rml_->RMLPositionAtAGivenSampleTime(
-                        (time - traj_start_time_).toSec(),
-                        rml_out_.get());
+}
 
+template <size_t DOF>
+void BasicCartesianPositionController<DOF>::solvePath(
+    const reflexxes_controllers_msgs::CartesianTrajectory &path, const KDL::JntArray &seed,
+    trajectory_msgs::JointTrajectory &trajectory) {
+    // Solve all waypoints before any of them is followed
+    int64_t solve_start_ns = reflexxes_controllers_common::monotonicNanoseconds();
+    bool solved = path_solver_.solve(path, seed, trajectory);
+    ik_solve_ns_.store(reflexxes_controllers_common::monotonicNanoseconds() - solve_start_ns,
+                       boost::memory_order_relaxed);
+
+    if (!solved) {
+        ROS_ERROR("Rejected Cartesian path command (namespace: %s).", nh_.getNamespace().c_str());
+        return;
+    }
 
-    // Determine if any of the joint tolerances have been violated
-    for (int i = 0; i < n_joints_; i++) {
-        double tracking_error = std::abs(rml_out_->NewPositionVector->VecData[i] - joints_[i].getPosition());
+    // A pose commanded during the solve supersedes the path
+    {
+        boost::lock_guard<boost::mutex> lock(ik_mutex_);
 
-        if (tracking_error > position_tolerances_[i]) {
-            recompute_trajectory_ = true;
-            ROS_WARN_STREAM("Tracking for joint " << i << " outside of tolerance! (" << tracking_error 
-                << " > " << position_tolerances_[i] << ")");
-        }
+        if (ik_request_pending_)
+            return;
     }
 
-    // Compute command
-    for (int i = 0; i < n_joints_; i++) {
-        commanded_positions_[i] = rml_out_->NewPositionVector->VecData[i];
+    // Hand the joint waypoints over to the realtime loop
+    if (!path_command_buffer_.writeFromNonRT(trajectory)) {
+        ROS_ERROR("Rejected Cartesian path command (namespace: %s).", nh_.getNamespace().c_str());
     }
+}
 
-    // Only set a different position command if the
-    switch (rml_result) {
-    case ReflexxesAPI::RML_WORKING:
-        // S'all good.
-        break;
+template <size_t DOF>
+bool BasicCartesianPositionController<DOF>::servoStep(
+    const KDL::JntArray &seed, const KDL::Frame &target, KDL::JntArray &solution) {
+    KDL::Frame current;
+    solution.data = seed.data;
 
-    case ReflexxesAPI::RML_FINAL_STATE_REACHED:
-        ROS_DEBUG("final state reached");
-        recompute_trajectory_ = true;
-        break;
+    for (int iteration = 0; iteration < servo_iterations_; iteration++) {
+        if (fk_solver->JntToCart(solution, current) < 0)
+            return false;
 
-    default:
-        if (loop_count_ % decimation_ == 0) {
-            ROS_ERROR("Reflexxes error code: %d. Setting position commands to measured position.", rml_result);
-        }
+        KDL::Twist error = KDL::diff(current, target);
 
-        for (int i = 0; i < n_joints_; i++)
-            commanded_positions_[i] = joints_[i].getPosition();
-        
-        break;
-    };
+        // Leave large motions to the global solver
+        if (iteration == 0 && (error.vel.Norm() > servo_max_position_error_ ||
+                               error.rot.Norm() > servo_max_orientation_error_))
+            return false;
 
-    // Set the lower-level commands
-    ROS_DEBUG("setting command");
-    for (int i = 0; i < n_joints_; i++) {
-        joints_[i].setCommand(commanded_positions_[i]);
-    }
+        if (jac_solver_->JntToJac(solution, servo_jacobian_) < 0)
+            return false;
 
-    // Publish state
-    if (loop_count_ % decimation_ == 0) {
-        /*
-         *      boost::scoped_ptr<realtime_tools::RealtimePublisher<controllers_msgs::JointControllerState> >
-         *        &state_pub = controller_state_publisher_;
-         *
-         *      for(int i=0; i<n_joints_; i++) {
-         *        if(state_pub && state_pub->trylock()) {
-         *          state_pub->msg_.header.stamp = time;
-         *          state_pub->msg_.set_point = pos_target;
-         *          state_pub->msg_.process_value = pos_actual;
-         *          state_pub->msg_.process_value_dot = vel_actual;
-         *          state_pub->msg_.error = pos_error;
-         *          state_pub->msg_.time_step = period.toSec();
-         *          state_pub->msg_.command = commanded_effort;
-         *
-         *          double dummy;
-         *          pids_[i]->getGains(
-         *              state_pub->msg_.p,
-         *              state_pub->msg_.i,
-         *              state_pub->msg_.d,
-         *              state_pub->msg_.i_clamp,
-         *              dummy);
-         *          state_pub->unlockAndPublish();
-        }
-        }
-        */
+        // dq = J^T (J J^T + lambda^2 I)^-1 e
+        for (int i = 0; i < 6; i++)
+            servo_error_(i) = error(i);
+
+        servo_jjt_.noalias() = servo_jacobian_.data * servo_jacobian_.data.transpose();
+        servo_jjt_.diagonal().array() += servo_damping_ * servo_damping_;
+        servo_ldlt_.compute(servo_jjt_);
+        solution.data.noalias() += servo_jacobian_.data.transpose() * servo_ldlt_.solve(servo_error_);
+
+        // Stay within the joint limits known to trac_ik
+        solution.data = solution.data.cwiseMax(joint_lower_limits_.data).cwiseMin(joint_upper_limits_.data);
     }
-    
-    if (loop_count_ == 1000)
-        ROS_INFO("period: %f seconds", period.toSec());
 
-    // Increment the loop count
-    loop_count_++;
-}
+    // Leave poses the steps did not reach to the global solver, e.g. near singularities or joint limits
+    if (fk_solver->JntToCart(solution, current) < 0)
+        return false;
 
-void CartesianPositionController::trajectoryCommandCB(
-    const geometry_msgs::PoseStampedConstPtr &msg) {
-    this->setTrajectoryCommand(msg);
-}
+    KDL::Twist error = KDL::diff(current, target);
 
-void CartesianPositionController::setTrajectoryCommand(
-    const geometry_msgs::PoseStampedConstPtr &msg) {
-    ROS_DEBUG("Received new command");
-    // the writeFromNonRT can be used in RT, if you have the guarantee that
-    //  * no non-rt thread is calling the same function (we're not subscribing to ros callbacks)
-    //  * there is only one single rt thread
-    trajectory_command_buffer_.writeFromNonRT(*msg);
-    new_reference_ = true;
+    return error.vel.Norm() <= servo_position_tolerance_ && error.rot.Norm() <= servo_orientation_tolerance_;
 }
 
+template class BasicCartesianPositionController<reflexxes_controllers_common::DYNAMIC_DOF>;
+template class BasicCartesianPositionController<6>;
+template class BasicCartesianPositionController<7>;
 
 } // namespace
 
 PLUGINLIB_EXPORT_CLASS(
     reflexxes_position_controllers::CartesianPositionController,
     controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_position_controllers::CartesianPositionController6DOF,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_position_controllers::CartesianPositionController7DOF,
+    controller_interface::ControllerBase)
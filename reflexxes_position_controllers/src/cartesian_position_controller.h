@@ -49,118 +49,216 @@
  *
  *********************************************************************/
 
-#ifndef POSITION_CONTROLLERS_JOINT_POSITION_CONTROLLER_H
-#define POSITION_CONTROLLERS_JOINT_POSITION_CONTROLLER_H
+#ifndef POSITION_CONTROLLERS_CARTESIAN_POSITION_CONTROLLER_H
+#define POSITION_CONTROLLERS_CARTESIAN_POSITION_CONTROLLER_H
 
 /**
   @class reflexxes_position_controllers::CartesianPositionController
   @brief Cartesian Position Controller
 
-  This class controls cartesian position.
+  This class controls cartesian position. Inverse kinematics is solved by
+  trac_ik on a non-realtime worker thread, which hands the joint targets to
+  the realtime loop through a lock-free mailbox.
+
+  In servo mode, poses close to the current one are solved by a few damped
+  least-squares steps on the chain Jacobian instead, which is much cheaper
+  than a global trac_ik solve when streaming targets. trac_ik is used only
+  when the pose error exceeds the servo thresholds or the steps do not
+  reach the pose within the servo tolerances.
+
+  If ik_cache_size is positive, solutions are remembered in an
+  IkSolutionCache. A repeated pose is answered from the cache, or solved
+  seeded from the cached solution if ik_cache_reuse_solution is false.
+
+  A timed sequence of poses can be commanded as a whole. All waypoints are
+  solved in parallel by a CartesianPathSolver before the motion starts, and
+  the path is rejected if any of them has no solution. The joint waypoints
+  are then followed point by point like in JointTrajectoryController. A
+  single pose command aborts the path.
+
+  CartesianPositionController6DOF and CartesianPositionController7DOF only
+  accept 6 and 7 joints respectively and keep the joint state in fixed-size
+  storage.
 
   @section ROS ROS interface
 
   @param type Must be "reflexxes_position_controllers::CartesianPositionController"
+  (or the "6DOF" / "7DOF" variant)
   @param joint Name of the joint to control.
+  @param root_name Root link of the kinematic chain.
+  @param tip_name Tip link of the kinematic chain, which is positioned.
+  @param servo_mode Solve small pose changes by differential IK (default: false).
+  @param servo_max_position_error Largest position error solved differentially in meters (default: 0.05).
+  @param servo_max_orientation_error Largest orientation error solved differentially in radians (default: 0.2).
+  @param servo_damping Damping factor of the least-squares step (default: 0.05).
+  @param servo_iterations Number of least-squares steps per command (default: 3).
+  @param servo_position_tolerance Largest position error left by the steps in meters, trac_ik solves
+  poses which were not reached (default: 0.0001).
+  @param servo_orientation_tolerance Largest orientation error left by the steps in radians (default: 0.001).
+  @param ik_cache_size Number of cached IK solutions, 0 disables the cache (default: 0).
+  @param ik_cache_position_resolution Position quantization of the cache key in meters (default: 0.001).
+  @param ik_cache_orientation_resolution Orientation quantization of the cache key in radians (default: 0.002).
+  @param ik_cache_seed_resolution Joint quantization of the seed in the cache key in radians, 0 ignores the seed (default: 0.5).
+  @param ik_cache_reuse_solution Skip the solve on a cache hit instead of seeding it (default: true).
+  @param ik_threads Number of threads solving the waypoints of a path (default: 4).
+  @param ik_path_max_joint_step Largest joint jump between waypoints solved in parallel in radians (default: 0.5).
+  @param max_trajectory_points Largest number of waypoints accepted in a path (default: 2048).
+  @param decimation Number of control cycles batched into each state message (default: 10).
+  @param nominal_period Expected period of update() in seconds (default: sampling_resolution).
+  @param period_tolerance Period deviation counted as jitter in seconds (default: 10% of nominal_period).
+  @param rml_rate_divisor Number of servo cycles per sample of the trajectory generator (default: 1).
+  @param speed_scaling Initial speed scaling of the limits, changed by the set_limits service (default: 1).
+  @param preview/enabled Publish a preview after each replan, see PlanPreviewPublisher (default: false).
 
   Subscribes to:
 
-  - @b command (std_msgs::PoseStamped) : The cartesian position to achieve.
+  - @b cartesian_position_command (geometry_msgs::PoseStamped) : The cartesian position to achieve.
+  - @b cartesian_trajectory_command (reflexxes_controllers_msgs::CartesianTrajectory) : The cartesian path to follow.
+
+  Provides:
+
+  - @b get_ik_cache_statistics (reflexxes_controllers_msgs::GetIkCacheStatistics) :
+    Counters of the IK solution cache, if enabled.
 
 Publishes:
 
-- @b state (control_msgs::JointControllerState) :
-Current state of the controller, including pid error and gains.
+- @b state (reflexxes_controllers_msgs::ControllerStateBatch) :
+Setpoint, position and error of every joint in each of the last decimation
+control cycles.
+- @b plan_preview (reflexxes_controllers_msgs::PlanPreview) :
+Duration and waypoint times of each plan, if preview/enabled is set.
 
 */
 
 #include <ros/node_handle.h>
-#include <urdf/model.h>
-#include <boost/scoped_ptr.hpp>
 #include <boost/thread/condition.hpp>
-#include <realtime_tools/realtime_publisher.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
 #include <hardware_interface/joint_command_interface.h>
-#include <controller_interface/controller.h>
-#include <std_msgs/Float64.h>
-#include <control_msgs/JointControllerState.h>
-#include <realtime_tools/realtime_buffer.h>
 
 #include <geometry_msgs/PoseStamped.h>
 
-#include <ReflexxesAPI.h>
-#include <RMLPositionFlags.h>
-#include <RMLPositionInputParameters.h>
-#include <RMLPositionOutputParameters.h>
-
+#include <Eigen/Cholesky>
+#include <kdl/chainjnttojacsolver.hpp>
 #include <trac_ik/trac_ik.hpp>
 
+#include <reflexxes_controllers_common/reflexxes_controller_core.h>
+#include <reflexxes_controllers_common/position_command_output.h>
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+#include <reflexxes_controllers_common/trajectory_command_buffer.h>
+#include <reflexxes_controllers_common/trajectory_cursor.h>
+#include <reflexxes_controllers_msgs/CartesianTrajectory.h>
+
+#include "cartesian_path_solver.h"
+#include "ik_solution_cache.h"
+
 namespace reflexxes_position_controllers {
 
-class CartesianPositionController: public controller_interface::Controller<hardware_interface::PositionJointInterface> {
+template <size_t DOF>
+class BasicCartesianPositionController: public reflexxes_controllers_common::ReflexxesControllerCore<
+    hardware_interface::PositionJointInterface, reflexxes_controllers_common::PositionCommandOutput, DOF> {
 
-public:
-    CartesianPositionController();
-    ~CartesianPositionController();
+    typedef reflexxes_controllers_common::ReflexxesControllerCore<
+        hardware_interface::PositionJointInterface, reflexxes_controllers_common::PositionCommandOutput, DOF> Core;
 
 public:
-    bool init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n);
-    void starting(const ros::Time &time);
-    void stopping(const ros::Time &time) { };
-    void update(const ros::Time &time, const ros::Duration &period);
+    BasicCartesianPositionController();
+    ~BasicCartesianPositionController();
 
-public:
-    /**< Last commanded position. */
-    realtime_tools::RealtimeBuffer<geometry_msgs::PoseStamped> trajectory_command_buffer_;
-
-    size_t n_joints_;
-    std::vector<std::string> joint_names_;
-    std::vector<double> position_tolerances_;
-    std::vector<double> max_accelerations_;
-    std::vector<double> max_jerks_;
-    std::vector<double> commanded_positions_;
-    std::vector<hardware_interface::JointHandle> joints_;
-    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
+protected:
+    using Core::nh_;
+    using Core::n_joints_;
+    using Core::joints_;
+    using Core::logger_;
+    using Core::timing_;
+    using Core::rml_in_;
+    using Core::rml_flags_;
+    using Core::traj_start_time_;
+    using Core::recompute_trajectory_;
+    using Core::nJoints;
+    using Core::computeTrajectory;
+    using Core::sampleTrajectory;
+    using Core::readRMLOutput;
 
-private:
-    ros::NodeHandle nh_;
-    int loop_count_;
-    int decimation_;
+    bool initTarget();
+    void startTarget(const ros::Time &time);
+    int updateTarget(const ros::Time &time, const ros::Duration &period);
+    void finalStateReached(const ros::Time &time);
+    size_t upcomingWaypoints(const ros::Time &time, double *times, size_t max_waypoints);
 
-    void rml_debug(const ros::console::levels::Level level);
-    
+private:
     //! Kinematic solvers
+    reflexxes_controllers_common::KinematicChainConstPtr kinematic_chain_;
     std::unique_ptr<TRAC_IK::TRAC_IK> tracik_solver;
     std::unique_ptr<KDL::ChainFkSolverPos_recursive> fk_solver;
     KDL::JntArray current_joint_position;
-    KDL::Frame target_cart_position;
     KDL::JntArray target_joint_position;
     std::string root_name;
     std::string tip_name;
-    
-    //! Acceleration computation
-    KDL::JntArray previous_joint_velocity;
-    KDL::JntArray current_joint_acceleration;
 
-    //! Trajectory Generator
-    boost::shared_ptr<ReflexxesAPI> rml_;
-    boost::shared_ptr<RMLPositionInputParameters> rml_in_;
-    boost::shared_ptr<RMLPositionOutputParameters> rml_out_;
-    RMLPositionFlags rml_flags_;
-    ros::Time traj_start_time_;
+    //! Asynchronous inverse kinematics
+    boost::thread ik_thread_;
+    boost::mutex ik_mutex_;
+    boost::condition_variable ik_condition_;
+    geometry_msgs::PoseStamped ik_request_;  //* guarded by ik_mutex_
+    bool ik_request_pending_;                //* guarded by ik_mutex_
+    bool ik_shutdown_;                       //* guarded by ik_mutex_
+    reflexxes_controllers_msgs::CartesianTrajectoryConstPtr path_request_;  //* guarded by ik_mutex_
+    bool path_request_pending_;              //* guarded by ik_mutex_
+    reflexxes_controllers_common::RealtimeMailbox<KDL::JntArray> ik_seed_mailbox_;    //* RT -> IK worker
+    reflexxes_controllers_common::RealtimeMailbox<KDL::JntArray> ik_target_mailbox_;  //* IK worker -> RT
+    boost::atomic<int64_t> ik_solve_ns_;     //* duration of the solve behind the latest target
+
+    void ikWorker();
+    void stopIkWorker();
+    void solvePath(const reflexxes_controllers_msgs::CartesianTrajectory &path, const KDL::JntArray &seed,
+                   trajectory_msgs::JointTrajectory &trajectory);
 
-    //! Trajectory parameters
-    double sampling_resolution_;
-    bool new_reference_;
-    bool recompute_trajectory_;
+    //! Differential inverse kinematics, only used by the IK worker
+    bool servo_mode_;
+    double servo_max_position_error_;
+    double servo_max_orientation_error_;
+    double servo_damping_;
+    int servo_iterations_;
+    double servo_position_tolerance_;
+    double servo_orientation_tolerance_;
+    std::unique_ptr<KDL::ChainJntToJacSolver> jac_solver_;
+    KDL::JntArray joint_lower_limits_;
+    KDL::JntArray joint_upper_limits_;
+    KDL::Jacobian servo_jacobian_;
+    Eigen::Matrix<double, 6, 6> servo_jjt_;
+    Eigen::LDLT<Eigen::Matrix<double, 6, 6> > servo_ldlt_;
+    Eigen::Matrix<double, 6, 1> servo_error_;
 
-    boost::scoped_ptr<realtime_tools::RealtimePublisher<control_msgs::JointControllerState> > controller_state_publisher_ ;
+    bool servoStep(const KDL::JntArray &seed, const KDL::Frame &target, KDL::JntArray &solution);
+
+    //! Solutions of recently commanded poses, only used by the IK worker
+    int ik_cache_size_;
+    bool ik_cache_reuse_solution_;
+    IkSolutionCache ik_cache_;
+
+    //! Cartesian paths, solved by the IK worker and followed point by point
+    CartesianPathSolver path_solver_;
+    reflexxes_controllers_common::TrajectoryCommandBuffer path_command_buffer_;
+    int max_trajectory_points_;
+    bool path_active_;
+    reflexxes_controllers_common::TrajectoryCursor cursor_;  //* progress along the path
 
     // Command subscriber
     ros::Subscriber trajectory_command_sub_;
     void trajectoryCommandCB(const geometry_msgs::PoseStampedConstPtr &msg);
     void setTrajectoryCommand(const geometry_msgs::PoseStampedConstPtr &msg);
+
+    ros::Subscriber path_command_sub_;
+    void pathCommandCB(const reflexxes_controllers_msgs::CartesianTrajectoryConstPtr &msg);
 };
 
+typedef BasicCartesianPositionController<reflexxes_controllers_common::DYNAMIC_DOF> CartesianPositionController;
+typedef BasicCartesianPositionController<6> CartesianPositionController6DOF;
+typedef BasicCartesianPositionController<7> CartesianPositionController7DOF;
+
 } // namespace
 
 #endif
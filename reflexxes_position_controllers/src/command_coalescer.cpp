@@ -0,0 +1,138 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include "command_coalescer.h"
+
+#include <cmath>
+
+namespace reflexxes_position_controllers {
+
+CommandCoalescer::CommandCoalescer()
+    : min_replan_interval_(0.0),
+      pending_(false),
+      received_(0),
+      seen_(0),
+      merged_(0),
+      dropped_(0),
+      replans_(0),
+      reset_requested_(false)
+{}
+
+void CommandCoalescer::init(ros::NodeHandle &nh, const std::vector<double> &tolerances, double min_replan_interval) {
+    tolerances_ = tolerances;
+    min_replan_interval_ = min_replan_interval;
+    pending_ = false;
+    last_replan_time_ = ros::Time();
+
+    service_ = nh.advertiseService("get_command_statistics", &CommandCoalescer::getStatistics, this);
+}
+
+void CommandCoalescer::received() {
+    received_.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void CommandCoalescer::reset() {
+    pending_ = false;
+    last_replan_time_ = ros::Time();
+}
+
+void CommandCoalescer::setTolerance(double tolerance) {
+    for (size_t i = 0; i < tolerances_.size(); i++) {
+        tolerances_[i] = tolerance;
+    }
+}
+
+bool CommandCoalescer::command(const double *positions, const double *target) {
+    clearRequested();
+    count(seen_);
+
+    bool changed = false;
+
+    for (size_t i = 0; i < tolerances_.size(); i++) {
+        if (std::abs(positions[i] - target[i]) > tolerances_[i]) {
+            changed = true;
+            break;
+        }
+    }
+
+    if (!changed) {
+        // A pending replan goes towards this command anyway, which is within the deadband
+        count(dropped_);
+        return false;
+    }
+
+    if (pending_) {
+        count(merged_);
+    }
+
+    pending_ = true;
+    return true;
+}
+
+bool CommandCoalescer::replanDue(const ros::Time &time) const {
+    return pending_ && (last_replan_time_.isZero() || (time - last_replan_time_).toSec() >= min_replan_interval_);
+}
+
+void CommandCoalescer::replanned(const ros::Time &time) {
+    clearRequested();
+
+    if (pending_) {
+        count(replans_);
+        pending_ = false;
+    }
+
+    last_replan_time_ = time;
+}
+
+void CommandCoalescer::count(boost::atomic<boost::uint64_t> &counter) {
+    // Single writer, no read-modify-write needed
+    counter.store(counter.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+}
+
+void CommandCoalescer::clearRequested() {
+    if (reset_requested_.load(boost::memory_order_acquire)) {
+        seen_.store(0, boost::memory_order_relaxed);
+        merged_.store(0, boost::memory_order_relaxed);
+        dropped_.store(0, boost::memory_order_relaxed);
+        replans_.store(0, boost::memory_order_relaxed);
+        reset_requested_.store(false, boost::memory_order_release);
+    }
+}
+
+bool CommandCoalescer::getStatistics(reflexxes_controllers_msgs::GetCommandStatistics::Request &request,
+                                     reflexxes_controllers_msgs::GetCommandStatistics::Response &response) {
+    boost::uint64_t received = received_.load(boost::memory_order_relaxed);
+    boost::uint64_t seen = seen_.load(boost::memory_order_relaxed);
+
+    // Commands overwritten in the command buffer never reach the control loop
+    response.received = received;
+    response.merged = merged_.load(boost::memory_order_relaxed) + (received > seen ? received - seen : 0);
+    response.dropped = dropped_.load(boost::memory_order_relaxed);
+    response.replans = replans_.load(boost::memory_order_relaxed);
+    response.min_replan_interval = min_replan_interval_;
+
+    if (request.reset) {
+        received_.store(0, boost::memory_order_relaxed);
+        reset_requested_.store(true, boost::memory_order_release);
+    }
+
+    return true;
+}
+
+} // namespace
@@ -0,0 +1,110 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef POSITION_CONTROLLERS_COMMAND_COALESCER_H
+#define POSITION_CONTROLLERS_COMMAND_COALESCER_H
+
+/**
+  @class reflexxes_position_controllers::CommandCoalescer
+  @brief Rate limit of the replans towards streamed position commands
+
+  A command only requests a replan if some joint moved further than its
+  deadband from the current target. Requested replans are postponed until
+  min_replan_interval has passed since the previous one, the replan then
+  goes towards the latest command, so commands arriving in between are
+  merged. This bounds the Reflexxes work of the controller independently
+  of the rate of the command sender.
+
+  received() is called by the subscriber, the statistics service runs in
+  the service thread, all other methods are realtime safe and are called
+  by the control loop.
+
+  @section ROS ROS interface
+
+  Provides:
+
+  - @b get_command_statistics (reflexxes_controllers_msgs::GetCommandStatistics) :
+    Received, merged and dropped command counters.
+
+*/
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+#include <reflexxes_controllers_msgs/GetCommandStatistics.h>
+
+namespace reflexxes_position_controllers {
+
+class CommandCoalescer {
+
+public:
+    CommandCoalescer();
+
+    //! Advertise the statistics service in the namespace of nh, tolerances are the per-joint deadbands
+    void init(ros::NodeHandle &nh, const std::vector<double> &tolerances, double min_replan_interval);
+
+    //! Non-RT: a command was written to the command buffer
+    void received();
+
+    //! RT: forget the pending command, the next command may replan immediately
+    void reset();
+
+    //! RT: use the same deadband for all joints
+    void setTolerance(double tolerance);
+
+    //! RT: the latest command changed, returns true if it requests a replan from target
+    bool command(const double *positions, const double *target);
+
+    //! RT: whether a requested replan is allowed at time
+    bool replanDue(const ros::Time &time) const;
+
+    //! RT: the trajectory was recomputed towards the latest command at time
+    void replanned(const ros::Time &time);
+
+private:
+    std::vector<double> tolerances_;
+    double min_replan_interval_;
+
+    bool pending_;  //* a command requested a replan which did not happen yet
+    ros::Time last_replan_time_;
+
+    //! Counters, written by a single thread and read by the service
+    boost::atomic<boost::uint64_t> received_;  //* written by the subscriber
+    boost::atomic<boost::uint64_t> seen_;      //* commands read by the control loop
+    boost::atomic<boost::uint64_t> merged_;
+    boost::atomic<boost::uint64_t> dropped_;
+    boost::atomic<boost::uint64_t> replans_;
+    boost::atomic<bool> reset_requested_;      //* the control loop clears its counters
+
+    void count(boost::atomic<boost::uint64_t> &counter);
+    void clearRequested();
+
+    ros::ServiceServer service_;
+    bool getStatistics(reflexxes_controllers_msgs::GetCommandStatistics::Request &request,
+                       reflexxes_controllers_msgs::GetCommandStatistics::Response &response);
+};
+
+} // namespace
+
+#endif
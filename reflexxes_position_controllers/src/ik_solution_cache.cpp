@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#include "ik_solution_cache.h"
+
+#include <cmath>
+
+namespace reflexxes_position_controllers {
+
+IkSolutionCache::IkSolutionCache()
+    : capacity_(0),
+      position_resolution_(0.001),
+      orientation_resolution_(0.002),
+      seed_resolution_(0.5),
+      hits_(0),
+      misses_(0),
+      evictions_(0)
+{}
+
+void IkSolutionCache::init(ros::NodeHandle &nh, size_t capacity, double position_resolution,
+                           double orientation_resolution, double seed_resolution) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    capacity_ = capacity;
+    position_resolution_ = position_resolution;
+    orientation_resolution_ = orientation_resolution;
+    seed_resolution_ = seed_resolution;
+
+    entries_.clear();
+    index_.clear();
+    index_.rehash(capacity);
+    hits_ = misses_ = evictions_ = 0;
+
+    service_ = nh.advertiseService("get_ik_cache_statistics", &IkSolutionCache::getStatistics, this);
+}
+
+void IkSolutionCache::makeKey(const KDL::Frame &pose, const KDL::JntArray &seed, Key &key) const {
+    double qx, qy, qz, qw;
+    pose.M.GetQuaternion(qx, qy, qz, qw);
+
+    // q and -q are the same orientation
+    if (qw < 0) {
+        qx = -qx;
+        qy = -qy;
+        qz = -qz;
+        qw = -qw;
+    }
+
+    key.clear();
+
+    for (int i = 0; i < 3; i++)
+        key.push_back(std::lround(pose.p(i) / position_resolution_));
+
+    // A quaternion component changes by about half the rotation angle
+    double quaternion_resolution = 0.5 * orientation_resolution_;
+    key.push_back(std::lround(qx / quaternion_resolution));
+    key.push_back(std::lround(qy / quaternion_resolution));
+    key.push_back(std::lround(qz / quaternion_resolution));
+    key.push_back(std::lround(qw / quaternion_resolution));
+
+    if (seed_resolution_ > 0) {
+        for (unsigned int i = 0; i < seed.rows(); i++)
+            key.push_back(std::lround(seed(i) / seed_resolution_));
+    }
+}
+
+bool IkSolutionCache::lookup(const KDL::Frame &pose, const KDL::JntArray &seed, KDL::JntArray &solution) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    makeKey(pose, seed, key_);
+    boost::unordered_map<Key, Entries::iterator>::iterator found = index_.find(key_);
+
+    if (found == index_.end()) {
+        misses_++;
+        return false;
+    }
+
+    // Move the entry to the front
+    entries_.splice(entries_.begin(), entries_, found->second);
+    solution.data = found->second->solution.data;
+    hits_++;
+
+    return true;
+}
+
+void IkSolutionCache::insert(const KDL::Frame &pose, const KDL::JntArray &seed, const KDL::JntArray &solution) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (capacity_ == 0)
+        return;
+
+    makeKey(pose, seed, key_);
+    boost::unordered_map<Key, Entries::iterator>::iterator found = index_.find(key_);
+
+    if (found != index_.end()) {
+        found->second->solution.data = solution.data;
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return;
+    }
+
+    // Reuse the least recently used entry once full
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.splice(entries_.begin(), entries_, --entries_.end());
+        evictions_++;
+    } else {
+        entries_.push_front(Entry());
+    }
+
+    Entry &entry = entries_.front();
+    entry.key = key_;
+    entry.solution.data = solution.data;
+    index_[entry.key] = entries_.begin();
+}
+
+bool IkSolutionCache::getStatistics(reflexxes_controllers_msgs::GetIkCacheStatistics::Request &request,
+                                    reflexxes_controllers_msgs::GetIkCacheStatistics::Response &response) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    response.hits = hits_;
+    response.misses = misses_;
+    response.evictions = evictions_;
+    response.size = entries_.size();
+    response.capacity = capacity_;
+
+    if (request.reset) {
+        hits_ = misses_ = evictions_ = 0;
+    }
+
+    return true;
+}
+
+} // namespace
@@ -0,0 +1,108 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+#ifndef POSITION_CONTROLLERS_IK_SOLUTION_CACHE_H
+#define POSITION_CONTROLLERS_IK_SOLUTION_CACHE_H
+
+/**
+  @class reflexxes_position_controllers::IkSolutionCache
+  @brief Bounded cache of inverse kinematics solutions
+
+  Solutions are keyed on the commanded pose, quantized to a position and an
+  orientation resolution, and on the seed quantized to a coarse joint
+  resolution, so that a cached solution is only reused from a similar arm
+  configuration. Once the capacity is reached the least recently used
+  solution is evicted.
+
+  The cache is used by the IK worker and read by the service thread, it is
+  not realtime safe.
+
+  @section ROS ROS interface
+
+  Provides:
+
+  - @b get_ik_cache_statistics (reflexxes_controllers_msgs::GetIkCacheStatistics) :
+    Hit, miss and eviction counters.
+
+*/
+
+#include <list>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <ros/node_handle.h>
+#include <kdl/frames.hpp>
+#include <kdl/jntarray.hpp>
+
+#include <reflexxes_controllers_msgs/GetIkCacheStatistics.h>
+
+namespace reflexxes_position_controllers {
+
+class IkSolutionCache {
+
+public:
+    IkSolutionCache();
+
+    //! Advertise the statistics service in the namespace of nh, a seed_resolution of 0 ignores the seed
+    void init(ros::NodeHandle &nh, size_t capacity, double position_resolution,
+              double orientation_resolution, double seed_resolution);
+
+    //! Look up the solution of pose reached from seed, refreshes its use
+    bool lookup(const KDL::Frame &pose, const KDL::JntArray &seed, KDL::JntArray &solution);
+
+    //! Remember the solution of pose reached from seed
+    void insert(const KDL::Frame &pose, const KDL::JntArray &seed, const KDL::JntArray &solution);
+
+private:
+    typedef std::vector<long> Key;
+
+    struct Entry {
+        Key key;
+        KDL::JntArray solution;
+    };
+
+    typedef std::list<Entry> Entries;
+
+    size_t capacity_;
+    double position_resolution_;
+    double orientation_resolution_;
+    double seed_resolution_;
+
+    boost::mutex mutex_;
+    Entries entries_;  //* most recently used first, guarded by mutex_
+    boost::unordered_map<Key, Entries::iterator> index_;  //* guarded by mutex_
+    Key key_;          //* scratch key, guarded by mutex_
+
+    //! Counters, guarded by mutex_
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+
+    void makeKey(const KDL::Frame &pose, const KDL::JntArray &seed, Key &key) const;
+
+    ros::ServiceServer service_;
+    bool getStatistics(reflexxes_controllers_msgs::GetIkCacheStatistics::Request &request,
+                       reflexxes_controllers_msgs::GetIkCacheStatistics::Response &response);
+};
+
+} // namespace
+
+#endif
@@ -50,99 +50,43 @@
  *********************************************************************/
 
 #include "joint_position_controller.h"
-#include <angles/angles.h>
 #include <pluginlib/class_list_macros.h>
-#include <trajectory_msgs/JointTrajectory.h>
-#include <sstream>
+#include <algorithm>
 
 namespace reflexxes_position_controllers {
 
-const double DEFAULT_SAMPLING_RESOLUTION = 0.001;    
-const double DEFAULT_POSITION_TOLERANCE = 0.1;
 const double DEFAULT_COMMAND_UPDATE_TOLERANCE = 0.0001;
-const double DEFAULT_MAX_ACCELERATION = 1.0;
-const double DEFAULT_MAX_JERK = 1000.0;
 const double DEFAULT_MIN_SYNCHRONIZATION_TIME = 0;
-
-JointPositionController::JointPositionController()
-    : loop_count_(0),
-      decimation_(10),
-      sampling_resolution_(DEFAULT_SAMPLING_RESOLUTION),
-      reached_reference_(false),
-      must_recompute_trajectory_(false)
-{}
-
-JointPositionController::~JointPositionController() {
-    trajectory_command_sub_.shutdown();
-}
-
-
-template<class T>
-std::ostream &operator<< (std::ostream &stream, const RMLVector<T> &rml_vec) {
-    stream << "[ ";
-
-    for (int i = 0; i < rml_vec.VectorDimension; i++) {
-        stream << (rml_vec.VecData[i]) << ", ";
-    }
-
-    stream << "]";
-    return stream;
+const double DEFAULT_MIN_REPLAN_INTERVAL = 0;
+
+template <size_t DOF>
+BasicJointPositionController<DOF>::BasicJointPositionController()
+    : Core("JointPositionController"),
+      minimum_synchronization_time_(DEFAULT_MIN_SYNCHRONIZATION_TIME),
+      recompute_at_final_state_(false),
+      min_replan_interval_(DEFAULT_MIN_REPLAN_INTERVAL),
+      applied_command_update_tolerance_(DEFAULT_COMMAND_UPDATE_TOLERANCE)
+{
+    command_update_tolerance_ = DEFAULT_COMMAND_UPDATE_TOLERANCE;
+
+    // Differentiate the measured positions, as the controller always did
+    this->default_state_estimation_ = reflexxes_controllers_common::JointStateEstimator::FINITE_DIFFERENCE;
 }
 
-void JointPositionController::rml_debug(const ros::console::levels::Level level) {
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT NumberOfDOFs: " << rml_in_->NumberOfDOFs);
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MinimumSynchronizationTime: " << rml_in_->MinimumSynchronizationTime);
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT SelectionVector: " << (*rml_in_->SelectionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentPositionVector: " << (*rml_in_->CurrentPositionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentVelocityVector: " << (*rml_in_->CurrentVelocityVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT CurrentAccelerationVector: " << (*rml_in_->CurrentAccelerationVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxAccelerationVector: " << (*rml_in_->MaxAccelerationVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxJerkVector: " << (*rml_in_->MaxJerkVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT TargetVelocityVector: " << (*rml_in_->TargetVelocityVector));
-
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT MaxVelocityVector: " << (*rml_in_->MaxVelocityVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT TargetPositionVector: " << (*rml_in_->TargetPositionVector));
-    ROS_LOG_STREAM(level, ROSCONSOLE_DEFAULT_NAME, "RML INPUT AlternativeTargetVelocityVector: " 
-        << (*rml_in_->AlternativeTargetVelocityVector));
+template <size_t DOF>
+BasicJointPositionController<DOF>::~BasicJointPositionController() {
+    trajectory_command_sub_.shutdown();
 }
 
 
-bool JointPositionController::init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n) {
-    // Store nodehandle
-    nh_ = n;
-
-    // Get joint names
-    XmlRpc::XmlRpcValue xml_array;
-
-    if (!nh_.getParam("joint_names", xml_array)) {
-        ROS_ERROR("No 'joint_names' parameter in controller (namespace '%s')", nh_.getNamespace().c_str());
-        return false;
-    }
-
-    // Make sure it's an array type
-    if (xml_array.getType() != XmlRpc::XmlRpcValue::TypeArray) {
-        ROS_ERROR("The 'joint_names' parameter is not an array (namespace '%s')", nh_.getNamespace().c_str());
-        return false;
-    }
-
-    // Get number of joints
-    n_joints_ = xml_array.size();
-
-    ROS_INFO_STREAM("Initializing JointPositionController with " << n_joints_ << " joints.");
-
-    // Get trajectory sampling resolution
-    if (!nh_.hasParam("sampling_resolution")) {
-        ROS_INFO("No sampling_resolution specified (namespace: %s), using default.", nh_.getNamespace().c_str());
-    }
-
-    nh_.param("sampling_resolution", sampling_resolution_, DEFAULT_SAMPLING_RESOLUTION);
-    
+template <size_t DOF>
+bool BasicJointPositionController<DOF>::initTarget() {
     // Get behavior after reaching point
     if (!nh_.hasParam("recompute_trajectory")) {
         ROS_INFO("No behavior after reaching point specified (namespace: %s), using default (keep trajectory).", nh_.getNamespace().c_str());
     }
 
-    nh_.param("recompute_trajectory", recompute_trajectory_, false);
+    nh_.param("recompute_trajectory", recompute_at_final_state_, false);
     
     // Get minimum synchronization time
     if (!nh_.hasParam("minimum_synchronization_time")) {
@@ -161,344 +105,157 @@ bool JointPositionController::init(hardware_interface::PositionJointInterface *r
     nh_.param("command_update_tolerance", command_update_tolerance_, DEFAULT_COMMAND_UPDATE_TOLERANCE);
     ROS_INFO("Using command update tolerance %f", command_update_tolerance_);
 
-    // Create trajectory generator
-    rml_.reset(new ReflexxesAPI(n_joints_, sampling_resolution_));
-    rml_in_.reset(new RMLPositionInputParameters(n_joints_));
-    rml_out_.reset(new RMLPositionOutputParameters(n_joints_));
-
-    // Get urdf
-    urdf::Model urdf;
-    std::string urdf_str;
-    ros::NodeHandle nh;
-    nh.getParam("/robot_description", urdf_str);
+    // Get the per-joint deadbands, the global tolerance is the default
+    std::vector<double> command_update_tolerances(n_joints_, command_update_tolerance_);
 
-    if (!urdf.initString(urdf_str)) {
-        ROS_ERROR("Failed to parse urdf from '/robot_description' parameter (namespace: %s)", nh.getNamespace().c_str());
-        return false;
-    }
+    for (size_t i = 0; i < n_joints_; i++) {
+        ros::NodeHandle joint_nh(nh_, "joints/" + joints_[i].getName());
+        joint_nh.param("command_update_tolerance", command_update_tolerances[i], command_update_tolerance_);
 
-    // Get individual joint properties from urdf and parameter server
-    joint_names_.resize(n_joints_);
-    joints_.resize(n_joints_);
-    urdf_joints_.resize(n_joints_);
-    position_tolerances_.resize(n_joints_);
-    max_velocities_.resize(n_joints_);
-    max_accelerations_.resize(n_joints_);
-    previous_positions_.resize(n_joints_);
-    previous_velocities_.resize(n_joints_);
-    current_velocities_.resize(n_joints_);
-    current_accelerations_.resize(n_joints_);
-    max_jerks_.resize(n_joints_);
-    commanded_positions_.resize(n_joints_);
-
-    for (int i = 0; i < n_joints_; i++) {
-        // Get joint name
-        if (xml_array[i].getType() != XmlRpc::XmlRpcValue::TypeString) {
-            ROS_ERROR("The 'joint_names' parameter contains a non-string element (namespace '%s')", nh_.getNamespace().c_str());
+        if (command_update_tolerances[i] < 0) {
+            ROS_ERROR("The 'command_update_tolerance' parameter must not be negative (namespace '%s')",
+                      joint_nh.getNamespace().c_str());
             return false;
         }
+    }
 
-        joint_names_[i] = static_cast<std::string>(xml_array[i]);
-
-        // Get the joint-namespace nodehandle
-        {
-            ros::NodeHandle joint_nh(nh_, "joints/" + joint_names_[i]);
-            ROS_INFO("Loading joint information for joint '%s' (namespace: %s)", 
-                     joint_names_[i].c_str(), joint_nh.getNamespace().c_str());
-
-            // Get position tolerance
-            if (!joint_nh.hasParam("tracking_position_tolerance")) {
-                ROS_INFO("No tracking_position_tolerance specified (namespace: %s), using default (%f).",
-                         joint_nh.getNamespace().c_str(), DEFAULT_POSITION_TOLERANCE);
-            } 
-
-            joint_nh.param("tracking_position_tolerance", position_tolerances_[i], DEFAULT_POSITION_TOLERANCE);
-            ROS_INFO("Using tolerance %f for joint %d.",
-                         position_tolerances_[i], i);
-            
-            // Get maximum velocity
-            if (!joint_nh.hasParam("max_velocity")) {
-                ROS_INFO("No max_velocity specified (namespace: %s), using default from URDF.",
-                         joint_nh.getNamespace().c_str());
-            }
-
-            joint_nh.param("max_velocity", max_velocities_[i], 0.0);  // default will be replaced later
-
-            // Get maximum acceleration
-            if (!joint_nh.hasParam("max_acceleration")) {
-                ROS_INFO("No max_acceleration specified (namespace: %s), using default.",
-                         joint_nh.getNamespace().c_str());
-            }
-
-            joint_nh.param("max_acceleration", max_accelerations_[i], DEFAULT_MAX_ACCELERATION);
-
-            // Get maximum jerk
-            if (!joint_nh.hasParam("max_jerk")) {
-                ROS_INFO("No max_jerk specified (namespace: %s), using default.",
-                         joint_nh.getNamespace().c_str());
-            }
-
-            joint_nh.param("max_jerk", max_jerks_[i], DEFAULT_MAX_JERK);
-        }
-
-        // Get ros_control joint handle
-        joints_[i] = robot->getHandle(joint_names_[i]);
-
-        // Get urdf joint
-        urdf_joints_[i] = urdf.getJoint(joint_names_[i]);
+    applied_command_update_tolerance_ = command_update_tolerance_;
 
-        if (!urdf_joints_[i]) {
-            ROS_ERROR("Could not find joint '%s' in urdf", joint_names_[i].c_str());
-            return false;
-        }
+    // Get the shortest time between two replans towards new commands
+    nh_.param("min_replan_interval", min_replan_interval_, DEFAULT_MIN_REPLAN_INTERVAL);
 
-        // Get RML parameters from URDF
-        rml_in_->MaxVelocityVector->VecData[i] = max_velocities_[i] == 0 ? urdf_joints_[i]->limits->velocity : max_velocities_[i];
-        rml_in_->MaxAccelerationVector->VecData[i] = max_accelerations_[i];
-        rml_in_->MaxJerkVector->VecData[i] = max_jerks_[i];
+    if (min_replan_interval_ < 0) {
+        ROS_ERROR("The 'min_replan_interval' parameter must not be negative (namespace '%s')", nh_.getNamespace().c_str());
+        return false;
     }
 
-    for (int i = 0; i < n_joints_; i++) {
-        rml_in_->SelectionVector->VecData[i] = true;
-    }
+    command_coalescer_.init(nh_, command_update_tolerances, min_replan_interval_);
 
+    // Specify behavior after reaching point
+    rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = recompute_at_final_state_ ? RMLPositionFlags::RECOMPUTE_TRAJECTORY : RMLPositionFlags::KEEP_TARGET_VELOCITY;
+    rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
+    rml_flags_.KeepCurrentVelocityInCaseOfFallbackStrategy = true;
 
-    if (rml_in_->CheckForValidity()) {
-        ROS_INFO_STREAM("RML INPUT Configuration Valid.");
-        this->rml_debug(ros::console::levels::Debug);
-    } else {
-        ROS_ERROR_STREAM("RML INPUT Configuration Invalid!");
-        this->rml_debug(ros::console::levels::Warn);
-        return false;
-    }
+    initial_positions_.resize(n_joints_);
+    initial_velocities_.resize(n_joints_);
+    initial_accelerations_.resize(n_joints_);
+    last_commanded_positions_.resize(n_joints_);
 
-    // Create state publisher
-    // TODO: create state publisher
-    //controller_state_publisher_.reset(
-    //new realtime_tools::RealtimePublisher<control_msgs::JointControllerState>(n, "state", 1));
-    
-    // Reset commands
-    for (int i = 0; i < n_joints_; i++) {
-        commanded_positions_[i] = joints_[i].getPosition();
-    }
+    // Preallocate the command buffer, a command is a single point
+    trajectory_command_buffer_.init(n_joints_, 1);
 
     // Create command subscriber
-    trajectory_command_sub_ = nh_.subscribe<trajectory_msgs::JointTrajectoryPoint>(
-                                  "joint_position_command", 1, &JointPositionController::trajectoryCommandCB, this);
+    trajectory_command_sub_ = nh_.template subscribe<trajectory_msgs::JointTrajectoryPoint>(
+                                  "joint_position_command", 1, &BasicJointPositionController::trajectoryCommandCB, this);
 
     return true;
 }
 
 
 
-void JointPositionController::starting(const ros::Time &time) {
-    ROS_WARN_STREAM("starting");
+template <size_t DOF>
+void BasicJointPositionController<DOF>::startTarget(const ros::Time &time) {
     // Define an initial command point from the current position
-    for (int i = 0; i < n_joints_; i++) {
-        double current_position = joints_[i].getPosition();
-        double current_velocity = joints_[i].getVelocity();
-        
-        commanded_trajectory_.positions.push_back(current_position);
-        commanded_trajectory_.velocities.push_back(current_velocity);
-        commanded_trajectory_.accelerations.push_back(0.0);
-        
-        previous_positions_[i] = current_position;
-        previous_velocities_[i] = current_velocity;
+    for (size_t i = 0; i < nJoints(); i++) {
+        initial_positions_[i] = joints_[i].getPosition();
+        initial_velocities_[i] = joints_[i].getVelocity();
+        initial_accelerations_[i] = 0.0;
     }
 
-    commanded_trajectory_.time_from_start = ros::Duration(1.0);
-    trajectory_command_buffer_.initRT(commanded_trajectory_);
-    last_commanded_trajectory_ = commanded_trajectory_;
-
-    // Reset commands
-    for (int i = 0; i < n_joints_; i++) {
-        commanded_positions_[i] = joints_[i].getPosition();
-    }
-
-    // Set new reference flag for initial command point
-    must_recompute_trajectory_ = true;
-    ROS_WARN_STREAM("started");
+    reflexxes_controllers_common::FixedTrajectory &initial_command = trajectory_command_buffer_.initRT();
+    initial_command.clear();
+    initial_command.push_back(&initial_positions_[0], &initial_velocities_[0], &initial_accelerations_[0],
+                              ros::Duration(1.0));
+    std::copy(initial_positions_.begin(), initial_positions_.end(), last_commanded_positions_.begin());
+    command_coalescer_.reset();
 }
 
-void JointPositionController::update(const ros::Time &time, const ros::Duration &period) {
-    ROS_DEBUG_STREAM("updating");
-    
-    // compute velocities and accelerations by hand just to be sure
-    for (int i = 0; i < n_joints_; i++) {
-        double current_position = joints_[i].getPosition();
-        current_velocities_[i] = (current_position - previous_positions_[i]) / period.toSec();
-        current_accelerations_[i] = (current_velocities_[i] - previous_velocities_[i]) / period.toSec();
-        previous_positions_[i] = current_position;
-        previous_velocities_[i] = current_velocities_[i];
-    }
-    
-    if (new_reference_) {
-        // Read the latest commanded trajectory message
-        commanded_trajectory_ = *trajectory_command_buffer_.readFromRT();
-        new_reference_ = false;
-        
-        for (int i = 0; i < n_joints_; i ++) {
-            if (std::abs(commanded_trajectory_.positions[i] - last_commanded_trajectory_.positions[i]) > command_update_tolerance_) {
-                must_recompute_trajectory_ = true;
-                reached_reference_ = false;
-                last_commanded_trajectory_ = commanded_trajectory_;
-            }
-        }
+template <size_t DOF>
+int BasicJointPositionController<DOF>::updateTarget(const ros::Time &time, const ros::Duration &period) {
+    // The set_limits service replaces the per-joint deadbands
+    if (command_update_tolerance_ != applied_command_update_tolerance_) {
+        command_coalescer_.setTolerance(command_update_tolerance_);
+        applied_command_update_tolerance_ = command_update_tolerance_;
     }
 
-    // Initialize RML result
-    int rml_result = 0;
-    
-    ROS_DEBUG_STREAM("checking for having to recompute");
-
-
-    // Compute RML traj after the start time and if there are still points in the queue
-    if (must_recompute_trajectory_) {
-        // Compute the trajectory
-        ROS_WARN_STREAM("RML Recomputing trajectory...");
+    // Commands outside the deadband request a replan, which waits for min_replan_interval
+    bool new_command = trajectory_command_buffer_.readFromRT();
 
-        // Update RML input parameters
-        for (int i = 0; i < n_joints_; i++) {
-            
-            rml_in_->CurrentPositionVector->VecData[i] = joints_[i].getPosition();
-            rml_in_->CurrentVelocityVector->VecData[i] = current_velocities_[i];
-            rml_in_->CurrentAccelerationVector->VecData[i] = current_accelerations_[i];
+    // Get the latest commanded point, only after readFromRT() took it over
+    const reflexxes_controllers_common::FixedTrajectory &commanded_trajectory = trajectory_command_buffer_.trajectory();
 
-            rml_in_->TargetPositionVector->VecData[i] = commanded_trajectory_.positions[i];
-            rml_in_->TargetVelocityVector->VecData[i] = commanded_trajectory_.velocities[i];
-
-            rml_in_->SelectionVector->VecData[i] = true;
-        }
-        
-        
-        ROS_DEBUG_STREAM("Current position: " << std::endl << *(rml_in_->CurrentPositionVector));
-        ROS_DEBUG_STREAM("Target position: " << std::endl << *(rml_in_->TargetPositionVector));
-
-        // Store the traj start time
-        traj_start_time_ = time;
+    if (new_command) {
+        command_coalescer_.command(commanded_trajectory.positions(0), &last_commanded_positions_[0]);
+    }
 
-        // Set desired execution time for this trajectory (definitely > 0)
-        rml_in_->SetMinimumSynchronizationTime(minimum_synchronization_time_);
+    if (command_coalescer_.replanDue(time)) {
+        recompute_trajectory_ = true;
+    }
 
-//         ROS_DEBUG_STREAM("RML IN: time: " << rml_in_->GetMinimumSynchronizationTime());
+    // Compute RML traj towards the latest commanded point
+    if (recompute_trajectory_) {
+        const double *commanded_positions = commanded_trajectory.positions(0);
+        std::copy(commanded_positions, commanded_positions + nJoints(), last_commanded_positions_.begin());
+        command_coalescer_.replanned(time);
 
-        // Specify behavior after reaching point
-        rml_flags_.BehaviorAfterFinalStateOfMotionIsReached = recompute_trajectory_ ? RMLPositionFlags::RECOMPUTE_TRAJECTORY : RMLPositionFlags::KEEP_TARGET_VELOCITY;
-        rml_flags_.SynchronizationBehavior = RMLPositionFlags::ONLY_TIME_SYNCHRONIZATION;
-        rml_flags_.KeepCurrentVelocityInCaseOfFallbackStrategy = true;
+        // Update RML input parameters, starting from the estimated state
+        setCurrentState();
 
-        // Compute trajectory
-        rml_result = rml_->RMLPosition(*rml_in_.get(),
-                                       rml_out_.get(),
-                                       rml_flags_);
+        for (size_t i = 0; i < nJoints(); i++) {
+            rml_in_->TargetPositionVector->VecData[i] = commanded_trajectory.positions(0)[i];
+            rml_in_->TargetVelocityVector->VecData[i] = commanded_trajectory.velocities(0)[i];
+        }
 
-        // Disable recompute flag
-        must_recompute_trajectory_ = false;
+        computeTrajectory(time, minimum_synchronization_time_);
     } 
     
     // Sample the already computed trajectory
-    rml_result = rml_->RMLPositionAtAGivenSampleTime(
-                        (time - traj_start_time_ + period).toSec(),
-                        rml_out_.get());
-
-    // Determine if any of the joint tolerances have been violated
-    for (int i = 0; i < n_joints_; i++) {
-        double tracking_error = std::abs(rml_out_->NewPositionVector->VecData[i] - joints_[i].getPosition());
-
-        if (tracking_error > position_tolerances_[i]) {
-            must_recompute_trajectory_ = true;
-            ROS_WARN_STREAM("Tracking for joint " << i << " outside of tolerance! (" << tracking_error 
-                << " > " << position_tolerances_[i] << ")");
-        }
-    }
+    int rml_result = sampleTrajectory((time - traj_start_time_ + period).toSec());
+    readRMLOutput();
 
-    // Compute command
-    for (int i = 0; i < n_joints_; i++) {
-        commanded_positions_[i] = rml_out_->NewPositionVector->VecData[i];
-    }
-
-    // Only set a different position command if the
-    switch (rml_result) {
-    case ReflexxesAPI::RML_WORKING:
-        // S'all good.
-        break;
-
-    case ReflexxesAPI::RML_FINAL_STATE_REACHED:
-        ROS_DEBUG_STREAM("final state reached");
-        must_recompute_trajectory_ = recompute_trajectory_;
-        reached_reference_ = true;
-        break;
-
-    default:
-        if (loop_count_ % decimation_ == 0) {
-            ROS_ERROR("Reflexxes error code: %d. Setting position commands to measured position.", rml_result);
-        }
-
-        for (int i = 0; i < n_joints_; i++)
-            commanded_positions_[i] = joints_[i].getPosition();
-        
-        break;
-    };
-
-    // Set the lower-level commands
-    if (!reached_reference_) {
-        ROS_DEBUG_STREAM("setting command");
-        for (int i = 0; i < n_joints_; i++) {
-            joints_[i].setCommand(commanded_positions_[i]);
-        }
-    }
+    return rml_result;
+}
 
-    // Publish state
-    if (loop_count_ % decimation_ == 0) {
-        /*
-         *      boost::scoped_ptr<realtime_tools::RealtimePublisher<controllers_msgs::JointControllerState> >
-         *        &state_pub = controller_state_publisher_;
-         *
-         *      for(int i=0; i<n_joints_; i++) {
-         *        if(state_pub && state_pub->trylock()) {
-         *          state_pub->msg_.header.stamp = time;
-         *          state_pub->msg_.set_point = pos_target;
-         *          state_pub->msg_.process_value = pos_actual;
-         *          state_pub->msg_.process_value_dot = vel_actual;
-         *          state_pub->msg_.error = pos_error;
-         *          state_pub->msg_.time_step = period.toSec();
-         *          state_pub->msg_.command = commanded_effort;
-         *
-         *          double dummy;
-         *          pids_[i]->getGains(
-         *              state_pub->msg_.p,
-         *              state_pub->msg_.i,
-         *              state_pub->msg_.d,
-         *              state_pub->msg_.i_clamp,
-         *              dummy);
-         *          state_pub->unlockAndPublish();
-        }
-        }
-        */
+template <size_t DOF>
+void BasicJointPositionController<DOF>::finalStateReached(const ros::Time &time) {
+    if (recompute_at_final_state_) {
+        recompute_trajectory_ = true;
     }
-
-    // Increment the loop count
-    loop_count_++;
 }
 
-void JointPositionController::trajectoryCommandCB(
+template <size_t DOF>
+void BasicJointPositionController<DOF>::trajectoryCommandCB(
     const trajectory_msgs::JointTrajectoryPointConstPtr &msg) {
     this->setTrajectoryCommand(msg);
 }
 
-void JointPositionController::setTrajectoryCommand(
+template <size_t DOF>
+void BasicJointPositionController<DOF>::setTrajectoryCommand(
     const trajectory_msgs::JointTrajectoryPointConstPtr &msg) {
     ROS_DEBUG("Received new command");
-    // the writeFromNonRT can be used in RT, if you have the guarantee that
-    //  * no non-rt thread is calling the same function (we're not subscribing to ros callbacks)
-    //  * there is only one single rt thread
-    trajectory_command_buffer_.writeFromNonRT(*msg);
-    new_reference_ = true;
+
+    if (!trajectory_command_buffer_.writeFromNonRT(*msg)) {
+        ROS_ERROR("Rejected position command (namespace: %s).", nh_.getNamespace().c_str());
+        return;
+    }
+
+    command_coalescer_.received();
 }
 
+template class BasicJointPositionController<reflexxes_controllers_common::DYNAMIC_DOF>;
+template class BasicJointPositionController<6>;
+template class BasicJointPositionController<7>;
 
 } // namespace
 
 PLUGINLIB_EXPORT_CLASS(
     reflexxes_position_controllers::JointPositionController,
     controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_position_controllers::JointPositionController6DOF,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_position_controllers::JointPositionController7DOF,
+    controller_interface::ControllerBase)
@@ -56,111 +56,125 @@
   @class reflexxes_position_controllers::JointPositionController
   @brief Joint Position Controller
 
-  This class controls positon using a pid loop.
+  This class controls position using the Reflexxes interpolation towards
+  the latest commanded point.
+
+  JointPositionController6DOF and JointPositionController7DOF only accept
+  6 and 7 joints respectively and keep the joint state in fixed-size
+  storage.
 
   @section ROS ROS interface
 
   @param type Must be "reflexxes_position_controllers::JointPositionController"
+  (or the "6DOF" / "7DOF" variant)
   @param joint Name of the joint to control.
-  @param pid Contains the gains for the PID loop around position.  See: control_toolbox::Pid
+  @param recompute_trajectory Keep replanning after the point was reached (default: false).
+  @param minimum_synchronization_time Shortest time to reach a new point in seconds (default: 0).
+  @param command_update_tolerance Change of the commanded point triggering a replan (default: 0.0001).
+  @param joints/NAME/command_update_tolerance Deadband of the joint, replaced by the set_limits service (default: command_update_tolerance).
+  @param min_replan_interval Shortest time between two replans towards new commands in seconds,
+  the latest command is held until then (default: 0).
+  @param decimation Number of control cycles batched into each state message (default: 10).
+  @param nominal_period Expected period of update() in seconds (default: sampling_resolution).
+  @param period_tolerance Period deviation counted as jitter in seconds (default: 10% of nominal_period).
+  @param rml_rate_divisor Number of servo cycles per sample of the trajectory generator (default: 1).
+  @param speed_scaling Initial speed scaling of the limits, changed by the set_limits service (default: 1).
+  @param preview/enabled Publish a preview after each replan, see PlanPreviewPublisher (default: false).
+  @param state_estimation/type Estimate of the measured state replans start from, see
+  JointStateEstimator (default: "finite_difference").
 
   Subscribes to:
 
-  - @b command (std_msgs::Float64) : The joint position to achieve.
+  - @b joint_position_command (trajectory_msgs::JointTrajectoryPoint) : The joint positions to achieve.
+
+Provides:
+
+- @b get_command_statistics (reflexxes_controllers_msgs::GetCommandStatistics) :
+Received, merged and dropped command counters.
 
 Publishes:
 
-- @b state (control_msgs::JointControllerState) :
-Current state of the controller, including pid error and gains.
+- @b state (reflexxes_controllers_msgs::ControllerStateBatch) :
+Setpoint, position and error of every joint in each of the last decimation
+control cycles.
+- @b plan_preview (reflexxes_controllers_msgs::PlanPreview) :
+Duration and sampled positions of each plan, if preview/enabled is set.
 
 */
 
 #include <ros/node_handle.h>
-#include <urdf/model.h>
-#include <boost/scoped_ptr.hpp>
-#include <boost/thread/condition.hpp>
-#include <realtime_tools/realtime_publisher.h>
 #include <hardware_interface/joint_command_interface.h>
-#include <controller_interface/controller.h>
-#include <control_msgs/JointControllerState.h>
-#include <std_msgs/Float64.h>
-#include <control_msgs/JointControllerState.h>
-#include <realtime_tools/realtime_buffer.h>
 
 #include <trajectory_msgs/JointTrajectoryPoint.h>
 
-#include <ReflexxesAPI.h>
-#include <RMLPositionFlags.h>
-#include <RMLPositionInputParameters.h>
-#include <RMLPositionOutputParameters.h>
+#include <reflexxes_controllers_common/reflexxes_controller_core.h>
+#include <reflexxes_controllers_common/position_command_output.h>
+#include <reflexxes_controllers_common/trajectory_command_buffer.h>
+
+#include "command_coalescer.h"
 
 namespace reflexxes_position_controllers {
 
-class JointPositionController: public controller_interface::Controller<hardware_interface::PositionJointInterface> {
+template <size_t DOF>
+class BasicJointPositionController: public reflexxes_controllers_common::ReflexxesControllerCore<
+    hardware_interface::PositionJointInterface, reflexxes_controllers_common::PositionCommandOutput, DOF> {
 
-public:
-    JointPositionController();
-    ~JointPositionController();
+    typedef reflexxes_controllers_common::ReflexxesControllerCore<
+        hardware_interface::PositionJointInterface, reflexxes_controllers_common::PositionCommandOutput, DOF> Core;
 
 public:
-    bool init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n);
-    void starting(const ros::Time &time);
-    void stopping(const ros::Time &time) { };
-    void update(const ros::Time &time, const ros::Duration &period);
+    BasicJointPositionController();
+    ~BasicJointPositionController();
+
+protected:
+    using Core::nh_;
+    using Core::n_joints_;
+    using Core::joints_;
+    using Core::rml_in_;
+    using Core::rml_flags_;
+    using Core::traj_start_time_;
+    using Core::recompute_trajectory_;
+    using Core::command_update_tolerance_;
+    using Core::nJoints;
+    using Core::computeTrajectory;
+    using Core::sampleTrajectory;
+    using Core::readRMLOutput;
+    using Core::setCurrentState;
+
+    bool initTarget();
+    void startTarget(const ros::Time &time);
+    int updateTarget(const ros::Time &time, const ros::Duration &period);
+    void finalStateReached(const ros::Time &time);
 
 public:
     /**< Last commanded position. */
-    realtime_tools::RealtimeBuffer<trajectory_msgs::JointTrajectoryPoint> trajectory_command_buffer_;
-    trajectory_msgs::JointTrajectoryPoint commanded_trajectory_;
-    trajectory_msgs::JointTrajectoryPoint last_commanded_trajectory_;
+    reflexxes_controllers_common::TrajectoryCommandBuffer trajectory_command_buffer_;
+    typename Core::JointValues last_commanded_positions_;
 
     //! Trajectory parameters
     double minimum_synchronization_time_;
-    double sampling_resolution_;
-    bool recompute_trajectory_;
-    
-    size_t n_joints_;
-    std::vector<std::string> joint_names_;
-    std::vector<double> position_tolerances_;
-    std::vector<double> max_velocities_;
-    std::vector<double> max_accelerations_;
-    std::vector<double> max_jerks_;
-    std::vector<double> commanded_positions_;
-    std::vector<double> current_velocities_;
-    std::vector<double> current_accelerations_;  
-    std::vector<double> previous_positions_;  //* to compute velocities
-    std::vector<double> previous_velocities_;  //* to compute accelerations
-    std::vector<hardware_interface::JointHandle> joints_;
-    std::vector<boost::shared_ptr<const urdf::Joint> > urdf_joints_;
+    bool recompute_at_final_state_;
 
-private:
-    ros::NodeHandle nh_;
-    int loop_count_;
-    int decimation_;
-
-    void rml_debug(const ros::console::levels::Level level);
-
-    //! Trajectory Generator
-    boost::shared_ptr<ReflexxesAPI> rml_;
-    boost::shared_ptr<RMLPositionInputParameters> rml_in_;
-    boost::shared_ptr<RMLPositionOutputParameters> rml_out_;
-    RMLPositionFlags rml_flags_;
-    ros::Time traj_start_time_;   
-    
-    //! Helper variables
-    bool new_reference_;
-    bool reached_reference_;
-    bool must_recompute_trajectory_;
-    double command_update_tolerance_;
-
-    boost::scoped_ptr<realtime_tools::RealtimePublisher<control_msgs::JointControllerState> > controller_state_publisher_ ;
+    //! Command coalescing
+    CommandCoalescer command_coalescer_;
+    double min_replan_interval_;
+    double applied_command_update_tolerance_;  //* last tolerance given to the coalescer
+
+    typename Core::JointValues initial_positions_;  //* of the initial command point
+    typename Core::JointValues initial_velocities_;
+    typename Core::JointValues initial_accelerations_;
 
+private:
     // Command subscriber
     ros::Subscriber trajectory_command_sub_;
     void trajectoryCommandCB(const trajectory_msgs::JointTrajectoryPointConstPtr &msg);
     void setTrajectoryCommand(const trajectory_msgs::JointTrajectoryPointConstPtr &msg);
 };
 
+typedef BasicJointPositionController<reflexxes_controllers_common::DYNAMIC_DOF> JointPositionController;
+typedef BasicJointPositionController<6> JointPositionController6DOF;
+typedef BasicJointPositionController<7> JointPositionController7DOF;
+
 } // namespace
 
 #endif
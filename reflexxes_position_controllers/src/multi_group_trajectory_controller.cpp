@@ -0,0 +1,224 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include "multi_group_trajectory_controller.h"
+#include <pluginlib/class_list_macros.h>
+
+#include <algorithm>
+#include <set>
+
+namespace reflexxes_position_controllers {
+
+MultiGroupTrajectoryController::MultiGroupTrajectoryController()
+    : synchronize_groups_(false),
+      synchronization_time_(0.0)
+{}
+
+size_t MultiGroupTrajectoryController::readGroupJoints(const ros::NodeHandle &group_nh,
+                                                       std::vector<std::string> &joint_names) const {
+    XmlRpc::XmlRpcValue xml_array;
+
+    if (!group_nh.getParam("joint_names", xml_array) || xml_array.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+        ROS_ERROR("No 'joint_names' array in group (namespace '%s')", group_nh.getNamespace().c_str());
+        return 0;
+    }
+
+    joint_names.resize(xml_array.size());
+
+    for (int i = 0; i < xml_array.size(); i++) {
+        if (xml_array[i].getType() != XmlRpc::XmlRpcValue::TypeString) {
+            ROS_ERROR("The 'joint_names' parameter contains a non-string element (namespace '%s')",
+                      group_nh.getNamespace().c_str());
+            return 0;
+        }
+
+        joint_names[i] = static_cast<std::string>(xml_array[i]);
+    }
+
+    return joint_names.size();
+}
+
+bool MultiGroupTrajectoryController::init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n) {
+    nh_ = n;
+
+    // Get group names
+    if (!nh_.getParam("groups", group_names_) || group_names_.empty()) {
+        ROS_ERROR("No 'groups' parameter in controller (namespace '%s')", nh_.getNamespace().c_str());
+        return false;
+    }
+
+    nh_.param("synchronize_groups", synchronize_groups_, false);
+
+    // Size the arena, every joint may only belong to one group
+    std::vector<size_t> group_joints(group_names_.size());
+    std::set<std::string> all_joints;
+    size_t arena_size = 0;
+
+    for (size_t g = 0; g < group_names_.size(); g++) {
+        ros::NodeHandle group_nh(nh_, group_names_[g]);
+        std::vector<std::string> joint_names;
+        group_joints[g] = readGroupJoints(group_nh, joint_names);
+
+        if (group_joints[g] == 0) {
+            return false;
+        }
+
+        for (size_t i = 0; i < joint_names.size(); i++) {
+            if (!all_joints.insert(joint_names[i]).second) {
+                ROS_ERROR("Joint '%s' is in more than one group (namespace '%s')",
+                          joint_names[i].c_str(), nh_.getNamespace().c_str());
+                return false;
+            }
+        }
+
+        switch (group_joints[g]) {
+        case 6:
+            arena_size += reflexxes_controllers_common::AlignedArena::footprint<BasicTrajectoryGroup<6> >();
+            break;
+
+        case 7:
+            arena_size += reflexxes_controllers_common::AlignedArena::footprint<BasicTrajectoryGroup<7> >();
+            break;
+
+        default:
+            arena_size += reflexxes_controllers_common::AlignedArena::footprint<
+                              BasicTrajectoryGroup<reflexxes_controllers_common::DYNAMIC_DOF> >();
+            break;
+        }
+    }
+
+    groups_.clear();
+
+    if (!arena_.reserve(arena_size)) {
+        ROS_ERROR("Could not allocate %zu bytes for the groups (namespace '%s')", arena_size, nh_.getNamespace().c_str());
+        return false;
+    }
+
+    // Construct and initialize the groups one after the other in the arena
+    for (size_t g = 0; g < group_names_.size(); g++) {
+        TrajectoryGroup *group;
+
+        switch (group_joints[g]) {
+        case 6:
+            group = arena_.construct<BasicTrajectoryGroup<6> >();
+            break;
+
+        case 7:
+            group = arena_.construct<BasicTrajectoryGroup<7> >();
+            break;
+
+        default:
+            group = arena_.construct<BasicTrajectoryGroup<reflexxes_controllers_common::DYNAMIC_DOF> >();
+            break;
+        }
+
+        ros::NodeHandle group_nh(nh_, group_names_[g]);
+        ROS_INFO("Initializing group '%s' with %zu joints (namespace: %s)",
+                 group_names_[g].c_str(), group_joints[g], group_nh.getNamespace().c_str());
+
+        if (!group->init(robot, group_nh)) {
+            ROS_ERROR("Failed to initialize group '%s' (namespace '%s')", group_names_[g].c_str(), nh_.getNamespace().c_str());
+            return false;
+        }
+
+        groups_.push_back(group);
+    }
+
+    rml_results_.resize(groups_.size());
+
+    // Start the workers planning the groups in parallel
+    std::vector<int> worker_cores;
+    int worker_priority;
+    nh_.getParam("worker_cores", worker_cores);
+    nh_.param("worker_priority", worker_priority, 80);
+
+    if (!worker_cores.empty()) {
+        ROS_INFO("Planning %zu groups on %zu worker threads (namespace: %s)",
+                 groups_.size(), worker_cores.size(), nh_.getNamespace().c_str());
+    }
+
+    if (!executor_.init(worker_cores, worker_priority)) {
+        ROS_ERROR("Failed to start the worker threads (namespace '%s')", nh_.getNamespace().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void MultiGroupTrajectoryController::starting(const ros::Time &time) {
+    for (size_t g = 0; g < groups_.size(); g++) {
+        groups_[g]->starting(time);
+    }
+
+    executor_.resume();
+}
+
+void MultiGroupTrajectoryController::stopping(const ros::Time &time) {
+    // Free the worker cores while stopped
+    executor_.pause();
+
+    for (size_t g = 0; g < groups_.size(); g++) {
+        groups_[g]->stopping(time);
+    }
+}
+
+void MultiGroupTrajectoryController::update(const ros::Time &time, const ros::Duration &period) {
+    // Plan or sample all groups, in parallel if there are workers
+    cycle_time_ = time;
+    cycle_period_ = period;
+    executor_.run(&MultiGroupTrajectoryController::planGroup, this, groups_.size());
+
+    // Stretch the plans started in this cycle to the longest of them
+    if (synchronize_groups_) {
+        double synchronization_time = 0.0;
+
+        for (size_t g = 0; g < groups_.size(); g++) {
+            synchronization_time = std::max(synchronization_time,
+                                            groups_[g]->plannedSynchronizationTime(time, rml_results_[g]));
+        }
+
+        if (synchronization_time > 0.0) {
+            synchronization_time_ = synchronization_time;
+            executor_.run(&MultiGroupTrajectoryController::synchronizeGroup, this, groups_.size());
+        }
+    }
+
+    // Command all groups once all plans are joined
+    for (size_t g = 0; g < groups_.size(); g++) {
+        groups_[g]->commandCycle(time, period, rml_results_[g]);
+    }
+}
+
+void MultiGroupTrajectoryController::planGroup(void *context, size_t index) {
+    MultiGroupTrajectoryController *controller = static_cast<MultiGroupTrajectoryController *>(context);
+    controller->rml_results_[index] = controller->groups_[index]->planCycle(controller->cycle_time_,
+                                                                            controller->cycle_period_);
+}
+
+void MultiGroupTrajectoryController::synchronizeGroup(void *context, size_t index) {
+    MultiGroupTrajectoryController *controller = static_cast<MultiGroupTrajectoryController *>(context);
+    controller->groups_[index]->synchronizeTrajectory(controller->cycle_time_, controller->synchronization_time_,
+                                                      controller->rml_results_[index]);
+}
+
+} // namespace
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_position_controllers::MultiGroupTrajectoryController,
+    controller_interface::ControllerBase)
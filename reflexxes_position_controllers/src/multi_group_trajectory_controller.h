@@ -0,0 +1,168 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef POSITION_CONTROLLERS_MULTI_GROUP_TRAJECTORY_CONTROLLER_H
+#define POSITION_CONTROLLERS_MULTI_GROUP_TRAJECTORY_CONTROLLER_H
+
+/**
+  @class reflexxes_position_controllers::MultiGroupTrajectoryController
+  @brief Several joint trajectory controllers run in one update()
+
+  Each group is a JointTrajectoryController with its own joints, commands
+  and Reflexxes state, configured in the group namespace. Groups of 6 or 7
+  joints use the fixed-size variants. All groups are kept next to each
+  other in one AlignedArena and are updated in a single pass, so a dual-arm
+  or arm-plus-torso robot needs one controller instead of one per chain.
+
+  If synchronize_groups is set, the plans started by several groups in the
+  same cycle are stretched to the longest of their synchronization times,
+  so that the groups reach their points together. The stretched plans are
+  computed in parallel as well. Precomputed trajectories
+  are not synchronized.
+
+  If worker_cores is set, the groups are planned in parallel by a
+  ForkJoinExecutor with one worker pinned to each of the listed cores, and
+  joined before any group commands its joints. The worst-case cycle time
+  then depends on the slowest group rather than on the sum of all groups.
+  The workers spin between cycles, so the cores should be isolated, and
+  sleep while the controller is stopped. If a worker can not be pinned or
+  made realtime (e.g. without realtime permissions), the groups are planned
+  one after the other.
+
+  The timing statistics of each group span the whole update(), which
+  includes the other groups.
+
+  @section ROS ROS interface
+
+  @param type Must be "reflexxes_position_controllers::MultiGroupTrajectoryController"
+  @param groups Names of the groups, each a namespace with the parameters of a JointTrajectoryController.
+  @param synchronize_groups Give plans started together the same duration (default: false).
+  @param worker_cores Cores of the worker threads planning the groups in parallel (default: none).
+  @param worker_priority SCHED_FIFO priority of the worker threads (default: 80).
+
+  Each group provides the topics and services of a JointTrajectoryController
+  in its namespace, e.g. left_arm/follow_joint_trajectory.
+
+*/
+
+#include <string>
+#include <vector>
+
+#include <ros/node_handle.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <controller_interface/controller.h>
+
+#include <reflexxes_controllers_common/aligned_arena.h>
+#include <reflexxes_controllers_common/fork_join_executor.h>
+
+#include "joint_trajectory_controller.h"
+
+namespace reflexxes_position_controllers {
+
+//! Group of a MultiGroupTrajectoryController, hides the number of joints
+class TrajectoryGroup {
+
+public:
+    virtual ~TrajectoryGroup() {}
+
+    virtual bool init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &nh) = 0;
+    virtual void starting(const ros::Time &time) = 0;
+    virtual void stopping(const ros::Time &time) = 0;
+
+    //! RT: see ReflexxesControllerCore
+    virtual int planCycle(const ros::Time &time, const ros::Duration &period) = 0;
+    virtual double plannedSynchronizationTime(const ros::Time &time, int rml_result) const = 0;
+    virtual void synchronizeTrajectory(const ros::Time &time, double synchronization_time, int &rml_result) = 0;
+    virtual void commandCycle(const ros::Time &time, const ros::Duration &period, int rml_result) = 0;
+};
+
+template <size_t DOF>
+class BasicTrajectoryGroup: public TrajectoryGroup {
+
+public:
+    bool init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &nh) {
+        return controller_.init(robot, nh);
+    }
+
+    void starting(const ros::Time &time) {
+        controller_.starting(time);
+    }
+
+    void stopping(const ros::Time &time) {
+        controller_.stopping(time);
+    }
+
+    int planCycle(const ros::Time &time, const ros::Duration &period) {
+        return controller_.planCycle(time, period);
+    }
+
+    double plannedSynchronizationTime(const ros::Time &time, int rml_result) const {
+        return controller_.plannedSynchronizationTime(time, rml_result);
+    }
+
+    void synchronizeTrajectory(const ros::Time &time, double synchronization_time, int &rml_result) {
+        controller_.synchronizeTrajectory(time, synchronization_time, rml_result);
+    }
+
+    void commandCycle(const ros::Time &time, const ros::Duration &period, int rml_result) {
+        controller_.commandCycle(time, period, rml_result);
+    }
+
+private:
+    BasicJointTrajectoryController<DOF> controller_;
+};
+
+class MultiGroupTrajectoryController: public controller_interface::Controller<hardware_interface::PositionJointInterface> {
+
+public:
+    MultiGroupTrajectoryController();
+
+    bool init(hardware_interface::PositionJointInterface *robot, ros::NodeHandle &n);
+    void starting(const ros::Time &time);
+    void stopping(const ros::Time &time);
+    void update(const ros::Time &time, const ros::Duration &period);
+
+private:
+    ros::NodeHandle nh_;
+    bool synchronize_groups_;
+
+    std::vector<std::string> group_names_;
+    std::vector<TrajectoryGroup *> groups_;  //* constructed in arena_
+    std::vector<int> rml_results_;           //* Reflexxes result of each group in the current cycle
+    reflexxes_controllers_common::AlignedArena arena_;
+
+    //! Parallel planning of the groups
+    reflexxes_controllers_common::ForkJoinExecutor executor_;
+    ros::Time cycle_time_;      //* arguments of the current update() for planGroup()
+    ros::Duration cycle_period_;
+    double synchronization_time_;  //* common duration of the plans of the current cycle
+
+    //! RT: job of the executor, plans group index
+    static void planGroup(void *context, size_t index);
+
+    //! RT: job of the executor, stretches the plan of group index to synchronization_time_
+    static void synchronizeGroup(void *context, size_t index);
+
+    //! Number of joints of the group, 0 if its joint_names parameter is invalid
+    size_t readGroupJoints(const ros::NodeHandle &group_nh, std::vector<std::string> &joint_names) const;
+};
+
+} // namespace
+
+#endif
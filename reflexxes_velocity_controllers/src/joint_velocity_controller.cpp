@@ -0,0 +1,202 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#include "joint_velocity_controller.h"
+#include <pluginlib/class_list_macros.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace reflexxes_velocity_controllers {
+
+template <size_t DOF>
+BasicJointVelocityController<DOF>::BasicJointVelocityController()
+    : Core("JointVelocityController"),
+      command_timeout_(0.0),
+      timed_out_(false),
+      target_reached_(false)
+{}
+
+template <size_t DOF>
+BasicJointVelocityController<DOF>::~BasicJointVelocityController() {
+    velocity_command_sub_.shutdown();
+}
+
+template <size_t DOF>
+bool BasicJointVelocityController<DOF>::initTarget() {
+    // Get the command timeout
+    nh_.param("command_timeout", command_timeout_, 0.0);
+
+    if (command_timeout_ < 0) {
+        ROS_ERROR("The 'command_timeout' parameter must not be negative (namespace '%s')", nh_.getNamespace().c_str());
+        return false;
+    }
+
+    // Get the synchronization behavior
+    bool synchronize_joints;
+    nh_.param("synchronize_joints", synchronize_joints, false);
+    rml_velocity_flags_.SynchronizationBehavior = synchronize_joints ? RMLVelocityFlags::ONLY_TIME_SYNCHRONIZATION :
+                                                                       RMLVelocityFlags::NO_SYNCHRONIZATION;
+
+    // Preallocate the velocity-based trajectory generator
+    rml_velocity_in_.reset(new RMLVelocityInputParameters(n_joints_));
+    rml_velocity_out_.reset(new RMLVelocityOutputParameters(n_joints_));
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        rml_velocity_in_->SelectionVector->VecData[i] = true;
+    }
+
+    target_velocities_.resize(n_joints_);
+
+    // Preallocate the command buffers
+    VelocityCommand command;
+    command.velocities.resize(n_joints_, 0.0);
+    command_mailbox_.init(command);
+
+    // Create command subscriber
+    velocity_command_sub_ = nh_.template subscribe<trajectory_msgs::JointTrajectoryPoint>(
+                                "joint_velocity_command", 1, &BasicJointVelocityController::velocityCommandCB, this);
+
+    return true;
+}
+
+template <size_t DOF>
+void BasicJointVelocityController<DOF>::startTarget(const ros::Time &time) {
+    // Stop until the first command, starting from the measured state
+    for (size_t i = 0; i < nJoints(); i++) {
+        target_velocities_[i] = 0.0;
+    }
+
+    command_stamp_ = time;
+    timed_out_ = false;
+    target_reached_ = false;
+}
+
+template <size_t DOF>
+int BasicJointVelocityController<DOF>::updateTarget(const ros::Time &time, const ros::Duration &period) {
+    // Get the latest commanded velocities
+    if (command_mailbox_.fetch()) {
+        const VelocityCommand &command = command_mailbox_.readBuffer();
+        std::copy(command.velocities.begin(), command.velocities.end(), target_velocities_.begin());
+        command_stamp_ = command.stamp;
+        timed_out_ = false;
+        target_reached_ = false;
+
+        logger_.log(reflexxes_controllers_common::EVENT_NEW_REFERENCE, time);
+    }
+
+    // Stop if the sender went silent
+    if (command_timeout_ > 0.0 && !timed_out_ && (time - command_stamp_).toSec() > command_timeout_) {
+        for (size_t i = 0; i < nJoints(); i++) {
+            target_velocities_[i] = 0.0;
+        }
+
+        timed_out_ = true;
+        target_reached_ = false;
+    }
+
+    // Continue from the setpoint, or restart from the estimated state
+    const reflexxes_controllers_common::JointStateEstimator &estimate = this->state_estimator_;
+
+    for (size_t i = 0; i < nJoints(); i++) {
+        if (recompute_trajectory_) {
+            rml_velocity_in_->CurrentPositionVector->VecData[i] = estimate.position(i);
+            rml_velocity_in_->CurrentVelocityVector->VecData[i] = estimate.velocity(i);
+            rml_velocity_in_->CurrentAccelerationVector->VecData[i] = estimate.acceleration(i);
+        } else {
+            rml_velocity_in_->CurrentPositionVector->VecData[i] = desired_positions_[i];
+            rml_velocity_in_->CurrentVelocityVector->VecData[i] = desired_velocities_[i];
+            rml_velocity_in_->CurrentAccelerationVector->VecData[i] = desired_accelerations_[i];
+        }
+
+        // The limits of rml_in_ include the speed scaling and changes through set_limits
+        double max_velocity = rml_in_->MaxVelocityVector->VecData[i];
+        rml_velocity_in_->TargetVelocityVector->VecData[i] = std::max(-max_velocity,
+                                                                      std::min(max_velocity, target_velocities_[i]));
+        rml_velocity_in_->MaxAccelerationVector->VecData[i] = rml_in_->MaxAccelerationVector->VecData[i];
+        rml_velocity_in_->MaxJerkVector->VecData[i] = rml_in_->MaxJerkVector->VecData[i];
+    }
+
+    recompute_trajectory_ = false;
+
+    timing_.start(reflexxes_controllers_common::PHASE_RML_VELOCITY);
+    int rml_result = rml_->RMLVelocity(*rml_velocity_in_, rml_velocity_out_.get(), rml_velocity_flags_);
+    timing_.stop(reflexxes_controllers_common::PHASE_RML_VELOCITY);
+
+    if (rml_result >= 0) {
+        for (size_t i = 0; i < nJoints(); i++) {
+            desired_positions_[i] = rml_velocity_out_->NewPositionVector->VecData[i];
+            desired_velocities_[i] = rml_velocity_out_->NewVelocityVector->VecData[i];
+            desired_accelerations_[i] = rml_velocity_out_->NewAccelerationVector->VecData[i];
+        }
+    }
+
+    // Only report reaching the commanded velocities once
+    if (rml_result == ReflexxesAPI::RML_FINAL_STATE_REACHED) {
+        if (target_reached_) {
+            rml_result = ReflexxesAPI::RML_WORKING;
+        }
+
+        target_reached_ = true;
+    }
+
+    return rml_result;
+}
+
+template <size_t DOF>
+void BasicJointVelocityController<DOF>::velocityCommandCB(
+    const trajectory_msgs::JointTrajectoryPointConstPtr &msg) {
+    ROS_DEBUG("Received new command");
+
+    if (msg->velocities.size() != n_joints_) {
+        ROS_ERROR("Rejected velocity command with %zu velocities for %zu joints (namespace: %s).",
+                  msg->velocities.size(), n_joints_, nh_.getNamespace().c_str());
+        return;
+    }
+
+    for (size_t i = 0; i < n_joints_; i++) {
+        if (!std::isfinite(msg->velocities[i])) {
+            ROS_ERROR("Rejected velocity command with a non-finite velocity (namespace: %s).", nh_.getNamespace().c_str());
+            return;
+        }
+    }
+
+    VelocityCommand &command = command_mailbox_.writeBuffer();
+    std::copy(msg->velocities.begin(), msg->velocities.end(), command.velocities.begin());
+    command.stamp = ros::Time::now();
+    command_mailbox_.publish();
+}
+
+template class BasicJointVelocityController<reflexxes_controllers_common::DYNAMIC_DOF>;
+template class BasicJointVelocityController<6>;
+template class BasicJointVelocityController<7>;
+
+} // namespace
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_velocity_controllers::JointVelocityController,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_velocity_controllers::JointVelocityController6DOF,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_EXPORT_CLASS(
+    reflexxes_velocity_controllers::JointVelocityController7DOF,
+    controller_interface::ControllerBase)
@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Software License Agreement (LGPL License)
+ *
+ *  Copyright (c) 2013, The Johns Hopkins University
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3.0 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *********************************************************************/
+
+
+#ifndef VELOCITY_CONTROLLERS_JOINT_VELOCITY_CONTROLLER_H
+#define VELOCITY_CONTROLLERS_JOINT_VELOCITY_CONTROLLER_H
+
+/**
+  @class reflexxes_velocity_controllers::JointVelocityController
+  @brief Joint Velocity Controller
+
+  This class controls velocity using the Reflexxes velocity-based
+  interpolation towards the latest commanded velocities. RMLVelocity() runs
+  every cycle from the last setpoint, so a new command changes the motion
+  in the next cycle, within the acceleration and jerk limits. Commanded
+  velocities are clipped to the velocity limits.
+
+  The setpoint is restarted from the measured state when the controller
+  starts and whenever the integrated setpoint position leaves the position
+  tolerance of a joint. If command_timeout is positive, the joints are
+  brought to a stop when no command was received for that long.
+
+  JointVelocityController6DOF and JointVelocityController7DOF only accept
+  6 and 7 joints respectively and keep the joint state in fixed-size
+  storage.
+
+  @section ROS ROS interface
+
+  @param type Must be "reflexxes_velocity_controllers::JointVelocityController"
+  (or the "6DOF" / "7DOF" variant)
+  @param joint_names Names of the joints to control.
+  @param command_timeout Time without commands after which the joints stop in seconds, 0 never stops (default: 0).
+  @param synchronize_joints Let all joints reach the commanded velocities at the same time (default: false).
+  @param decimation Number of control cycles batched into each state message (default: 10).
+  @param nominal_period Expected period of update() in seconds (default: sampling_resolution).
+  @param period_tolerance Period deviation counted as jitter in seconds (default: 10% of nominal_period).
+  @param speed_scaling Initial speed scaling of the limits, changed by the set_limits service (default: 1).
+
+  Subscribes to:
+
+  - @b joint_velocity_command (trajectory_msgs::JointTrajectoryPoint) : The joint velocities to achieve.
+
+  Publishes:
+
+  - @b state (reflexxes_controllers_msgs::ControllerStateBatch) :
+    Setpoint, position and error of every joint in each of the last
+    decimation control cycles.
+
+*/
+
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <ros/node_handle.h>
+#include <hardware_interface/joint_command_interface.h>
+
+#include <trajectory_msgs/JointTrajectoryPoint.h>
+
+#include <RMLVelocityFlags.h>
+#include <RMLVelocityInputParameters.h>
+#include <RMLVelocityOutputParameters.h>
+
+#include <reflexxes_controllers_common/reflexxes_controller_core.h>
+#include <reflexxes_controllers_common/realtime_mailbox.h>
+
+#include "velocity_command_output.h"
+
+namespace reflexxes_velocity_controllers {
+
+//! Velocity command handed to the realtime loop
+struct VelocityCommand {
+    std::vector<double> velocities;
+    ros::Time stamp;  //* time of reception
+};
+
+template <size_t DOF>
+class BasicJointVelocityController: public reflexxes_controllers_common::ReflexxesControllerCore<
+    hardware_interface::VelocityJointInterface, VelocityCommandOutput, DOF> {
+
+    typedef reflexxes_controllers_common::ReflexxesControllerCore<
+        hardware_interface::VelocityJointInterface, VelocityCommandOutput, DOF> Core;
+
+public:
+    BasicJointVelocityController();
+    ~BasicJointVelocityController();
+
+protected:
+    using Core::nh_;
+    using Core::n_joints_;
+    using Core::joints_;
+    using Core::rml_;
+    using Core::rml_in_;
+    using Core::recompute_trajectory_;
+    using Core::desired_positions_;
+    using Core::desired_velocities_;
+    using Core::desired_accelerations_;
+    using Core::logger_;
+    using Core::timing_;
+    using Core::nJoints;
+
+    bool initTarget();
+    void startTarget(const ros::Time &time);
+    int updateTarget(const ros::Time &time, const ros::Duration &period);
+
+private:
+    //! Latest command, written by the subscriber
+    reflexxes_controllers_common::RealtimeMailbox<VelocityCommand> command_mailbox_;
+    typename Core::JointValues target_velocities_;
+    ros::Time command_stamp_;
+
+    //! Trajectory parameters
+    double command_timeout_;
+    bool timed_out_;       //* the target was set to zero after command_timeout_
+    bool target_reached_;  //* the final state was reported for the current target
+
+    //! Velocity-based trajectory generator, sharing the limits of rml_in_
+    boost::scoped_ptr<RMLVelocityInputParameters> rml_velocity_in_;
+    boost::scoped_ptr<RMLVelocityOutputParameters> rml_velocity_out_;
+    RMLVelocityFlags rml_velocity_flags_;
+
+    // Command subscriber
+    ros::Subscriber velocity_command_sub_;
+    void velocityCommandCB(const trajectory_msgs::JointTrajectoryPointConstPtr &msg);
+};
+
+typedef BasicJointVelocityController<reflexxes_controllers_common::DYNAMIC_DOF> JointVelocityController;
+typedef BasicJointVelocityController<6> JointVelocityController6DOF;
+typedef BasicJointVelocityController<7> JointVelocityController7DOF;
+
+} // namespace
+
+#endif